@@ -4,8 +4,24 @@ set(LITESCENE_SOURCES
     ${CMAKE_CURRENT_LIST_DIR}/3rd_party/tinyexr/miniz.c
     ${CMAKE_CURRENT_LIST_DIR}/hydraxml.cpp
     ${CMAKE_CURRENT_LIST_DIR}/cmesh4.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/cmesh4_storage.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mapped_file.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/vsgf_v2.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_weld.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_optimize.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_meshlets.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_simplify.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_tangents.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_indices.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_compact.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_bvh.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_dedup.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/mesh_cache.cpp
     ${CMAKE_CURRENT_LIST_DIR}/mesh_load_obj.cpp
     ${CMAKE_CURRENT_LIST_DIR}/scene.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/scene_load_async.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/scene_flatten.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/scene_ray_query.cpp
     ${CMAKE_CURRENT_LIST_DIR}/scene_mat.cpp
     ${CMAKE_CURRENT_LIST_DIR}/scene_tex.cpp
     ${CMAKE_CURRENT_LIST_DIR}/scene_convert.cpp
@@ -13,4 +29,32 @@ set(LITESCENE_SOURCES
 
 set(LITESCENE_VK_SOURCES
     ${CMAKE_CURRENT_LIST_DIR}/scene_mgr.cpp
-)
\ No newline at end of file
+)
+# benchmarks (OBJ vertex dedup, SimpleMesh::ApplyMatrix), not built by default
+option(LITESCENE_BUILD_BENCHMARKS "Build LiteScene benchmark tools" OFF)
+if(LITESCENE_BUILD_BENCHMARKS)
+  find_package(OpenMP)
+  set(LITESCENE_BENCH_MESH_SOURCES
+      ${CMAKE_CURRENT_LIST_DIR}/cmesh4.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/mesh_tangents.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/mapped_file.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/vsgf_v2.cpp
+      ${CMAKE_CURRENT_LIST_DIR}/3rd_party/tinyexr/miniz.c)
+
+  # DedupIndexTriples vs std::unordered_map on a synthetic grid or the corners of an .obj, which is also loaded end to end
+  add_executable(litescene_dedup_bench ${CMAKE_CURRENT_LIST_DIR}/tools/dedup_bench.cpp ${CMAKE_CURRENT_LIST_DIR}/mesh_dedup.cpp
+                 ${CMAKE_CURRENT_LIST_DIR}/mesh_load_obj.cpp ${CMAKE_CURRENT_LIST_DIR}/mesh_cache.cpp ${LITESCENE_BENCH_MESH_SOURCES})
+  target_include_directories(litescene_dedup_bench PRIVATE ${CMAKE_CURRENT_LIST_DIR})
+  target_compile_features(litescene_dedup_bench PRIVATE cxx_std_17)
+  if(OpenMP_CXX_FOUND)
+    target_link_libraries(litescene_dedup_bench PRIVATE OpenMP::OpenMP_CXX)
+  endif()
+
+  # SimpleMesh::ApplyMatrix throughput in GB/s against a plain streaming pass, 1..N threads
+  add_executable(litescene_apply_matrix_bench ${CMAKE_CURRENT_LIST_DIR}/tools/apply_matrix_bench.cpp ${LITESCENE_BENCH_MESH_SOURCES})
+  target_include_directories(litescene_apply_matrix_bench PRIVATE ${CMAKE_CURRENT_LIST_DIR})
+  target_compile_features(litescene_apply_matrix_bench PRIVATE cxx_std_17)
+  if(OpenMP_CXX_FOUND)
+    target_link_libraries(litescene_apply_matrix_bench PRIVATE OpenMP::OpenMP_CXX)
+  endif()
+endif()
@@ -1,11 +1,23 @@
 #include "cmesh4.h"
+#include "mapped_file.h"
+#include "mesh_tangents.h"
 
 #include <cmath>
+#include <cstdio>
 #include <cfloat>
 #include <cstring>
 #include <fstream>
+#include <algorithm>
 #include <type_traits>
 
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(_MSC_VER))
+#define CMESH4_AVX_KERNELS // see SimpleMesh::ApplyMatrix
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
 namespace cmesh4 {
 
   std::vector<unsigned int> CreateQuadTriIndices(const int a_sizeX, const int a_sizeY)
@@ -29,6 +41,25 @@ namespace cmesh4 {
     return indicesData;
   }
 
+  std::vector<unsigned int> CreateQuadIndices(const int a_sizeX, const int a_sizeY)
+  {
+    std::vector<unsigned int> indicesData(a_sizeY*a_sizeX * 4);
+    unsigned int* indexBuf = indicesData.data();
+
+    for (int i = 0; i < a_sizeY; i++)
+    {
+      for (int j = 0; j < a_sizeX; j++)
+      {
+        *indexBuf++ = (unsigned int)( (i + 0) * (a_sizeX + 1) + (j + 0) );
+        *indexBuf++ = (unsigned int)( (i + 1) * (a_sizeX + 1) + (j + 0) );
+        *indexBuf++ = (unsigned int)( (i + 1) * (a_sizeX + 1) + (j + 1) );
+        *indexBuf++ = (unsigned int)( (i + 0) * (a_sizeX + 1) + (j + 1) );
+      }
+    }
+
+    return indicesData;
+  }
+
   Header LoadHeader(std::istream &str)
   {
     static_assert(std::is_trivial<Header>() && std::is_standard_layout<Header>(), "Requires being trivial standard layout object for loading");
@@ -36,10 +67,12 @@ namespace cmesh4 {
     str.read((char*)&header, sizeof(Header)); // FIXME: ENDIANNES NOT CHECKED !!!
     return header;
   }
+
+  SimpleMesh DecodeVSGFv2(const Header& a_header, const uint8_t* a_data, size_t a_size, const char* a_fileName); // vsgf_v2.cpp
   
 }
 
-cmesh4::SimpleMesh cmesh4::CreateQuad(const int a_sizeX, const int a_sizeY, const float a_size)
+cmesh4::SimpleMesh cmesh4::CreateQuad(const int a_sizeX, const int a_sizeY, const float a_size, SimpleMesh::SIMPLE_MESH_TOPOLOGY a_topology)
 {
   const int vertNumX = a_sizeX + 1;
   const int vertNumY = a_sizeY + 1;
@@ -47,7 +80,8 @@ cmesh4::SimpleMesh cmesh4::CreateQuad(const int a_sizeX, const int a_sizeY, cons
   const int quadsNum = a_sizeX*a_sizeY;
   const int vertNum  = vertNumX*vertNumY;
 
-  cmesh4::SimpleMesh res(vertNum, quadsNum*2*3);
+  const bool quads = (a_topology == SimpleMesh::SIMPLE_MESH_QUADS);
+  cmesh4::SimpleMesh res(vertNum, quads ? quadsNum*4 : quadsNum*2*3, SimpleMesh::ATTR_DEFAULT, a_topology);
 
   const float edgeLength  = a_size / float(a_sizeX);
   //const float edgeLength2 = sqrtf(2.0f)*edgeLength;
@@ -85,13 +119,49 @@ cmesh4::SimpleMesh cmesh4::CreateQuad(const int a_sizeX, const int a_sizeY, cons
     }
   }
  
-  res.indices = CreateQuadTriIndices(a_sizeX, a_sizeY);
+  res.indices = quads ? CreateQuadIndices(a_sizeX, a_sizeY) : CreateQuadTriIndices(a_sizeX, a_sizeY);
 
   return res;
 }
 
 
 
+namespace cmesh4
+{
+  // size of v1 data after the header, counts come from the file and must be checked against its size before allocating
+  //
+  static size_t VSGFv1DataSize(const Header& a_header)
+  {
+    const size_t   vertNum  = a_header.verticesNum;
+    const size_t   indNum   = a_header.indicesNum;
+    const size_t   primNum  = indNum/((a_header.flags & Header::QUADS) ? SimpleMesh::POINTS_IN_QUAD : SimpleMesh::POINTS_IN_TRIANGLE);
+    const uint32_t attribs  = AttributesFromVSGFFlags(a_header.flags);
+    const size_t   normNum  = (attribs & SimpleMesh::ATTR_NORMAL)    ? vertNum : 0;
+    const size_t   tangNum  = (attribs & SimpleMesh::ATTR_TANGENT)   ? vertNum : 0;
+    const size_t   uvNum    = (attribs & SimpleMesh::ATTR_TEXCOORD)  ? vertNum : 0;
+    const size_t   uv1Num   = (attribs & SimpleMesh::ATTR_TEXCOORD1) ? vertNum : 0;
+    const size_t   colorNum = (attribs & SimpleMesh::ATTR_COLOR)     ? vertNum : 0;
+    return (vertNum + normNum + tangNum + colorNum)*sizeof(float)*4 + (uvNum + uv1Num)*sizeof(float)*2 + (indNum + primNum)*sizeof(unsigned int);
+  }
+
+  static bool VSGFv1SizeIsValid(const Header& a_header, size_t a_fileSize, const char* a_fileName, const char* a_funcName)
+  {
+    const size_t pointsNum = (a_header.flags & Header::QUADS) ? SimpleMesh::POINTS_IN_QUAD : SimpleMesh::POINTS_IN_TRIANGLE;
+    if(a_header.indicesNum % pointsNum != 0)
+    {
+      printf("[%s::ERROR] File %s has %u indices, not a whole number of primitives\n", a_funcName, a_fileName, a_header.indicesNum);
+      return false;
+    }
+    const size_t expected = sizeof(Header) + VSGFv1DataSize(a_header);
+    if(a_fileSize < expected)
+    {
+      printf("[%s::ERROR] File %s is truncated: %zu bytes instead of %zu\n", a_funcName, a_fileName, a_fileSize, expected);
+      return false;
+    }
+    return true;
+  }
+};
+
 #if defined(__ANDROID__)
 cmesh4::SimpleMesh cmesh4::LoadMeshFromVSGF(AAssetManager* mgr, const char* a_fileName)
 {
@@ -111,25 +181,35 @@ cmesh4::SimpleMesh cmesh4::LoadMeshFromVSGF(AAssetManager* mgr, const char* a_fi
 
   AAsset_read(asset, &vsgf_header, sizeof(Header));
 
-  SimpleMesh res(vsgf_header.verticesNum, vsgf_header.indicesNum);
+  if(vsgf_header.flags & Header::CONTAINER_V2)
+  {
+    std::vector<uint8_t> data(size - sizeof(Header));
+    AAsset_read(asset, data.data(), data.size());
+    AAsset_close(asset);
+    return DecodeVSGFv2(vsgf_header, data.data(), data.size(), a_fileName);
+  }
+
+  if(!VSGFv1SizeIsValid(vsgf_header, size, a_fileName, "LoadMeshFromVSGF"))
+  {
+    AAsset_close(asset);
+    return SimpleMesh();
+  }
+
+  SimpleMesh res(vsgf_header.verticesNum, vsgf_header.indicesNum, AttributesFromVSGFFlags(vsgf_header.flags), TopologyFromVSGFFlags(vsgf_header.flags));
 
   auto bytesRead = AAsset_read(asset, (char*)res.vPos4f.data(), res.vPos4f.size() * sizeof(float) * 4);
-  
-  if(!(vsgf_header.flags & Header::HAS_NO_NORMALS))
-    bytesRead = AAsset_read(asset, (char*)res.vNorm4f.data(), res.vNorm4f.size() * sizeof(float) * 4);
-  else
-    memset(res.vNorm4f.data(), 0, res.vNorm4f.size()*sizeof(float)*4);
-  
-  if(vsgf_header.flags & Header::HAS_TANGENT)
-    bytesRead = AAsset_read(asset, (char*)res.vTang4f.data(), res.vTang4f.size() * sizeof(float) * 4);
-  else
-    memset(res.vTang4f.data(), 0, res.vTang4f.size()*sizeof(float)*4);
-  
-  bytesRead = AAsset_read(asset, (char*)res.vTexCoord2f.data(), res.vTexCoord2f.size() * sizeof(float) * 2);
+  bytesRead = AAsset_read(asset, (char*)res.vNorm4f.data(),       res.vNorm4f.size() * sizeof(float) * 4);
+  bytesRead = AAsset_read(asset, (char*)res.vTang4f.data(),       res.vTang4f.size() * sizeof(float) * 4);
+  bytesRead = AAsset_read(asset, (char*)res.vTexCoord2f.data(),   res.vTexCoord2f.size() * sizeof(float) * 2);
+  bytesRead = AAsset_read(asset, (char*)res.vTexCoord2f_1.data(), res.vTexCoord2f_1.size() * sizeof(float) * 2);
+  bytesRead = AAsset_read(asset, (char*)res.vColor4f.data(),      res.vColor4f.size() * sizeof(float) * 4);
   bytesRead = AAsset_read(asset, (char*)res.indices.data(), res.indices.size() * sizeof(uint32_t));
   bytesRead = AAsset_read(asset, (char*)res.matIndices.data(), res.matIndices.size() * sizeof(uint32_t));
   AAsset_close(asset);
 
+  if(vsgf_header.flags & Header::HAS_NO_NORMALS)
+    ComputeNormals(res, NORMALS_ANGLE_WEIGHTED);
+
   return res;
 }
 
@@ -144,116 +224,646 @@ cmesh4::SimpleMesh cmesh4::LoadMeshFromVSGF(const char* a_fileName)
     return SimpleMesh();
 
   Header header = LoadHeader(input); 
-  SimpleMesh res(header.verticesNum, header.indicesNum);
 
-  input.read((char*)res.vPos4f.data(),  res.vPos4f.size()*sizeof(float)*4);
-  
-  if(!(header.flags & Header::HAS_NO_NORMALS))
-    input.read((char*)res.vNorm4f.data(), res.vNorm4f.size()*sizeof(float)*4);
-  else
-    std::fill(res.vNorm4f.begin(), res.vNorm4f.end(), LiteMath::float4{});   // #TODO: calc at flat normals in this case        
+  if(header.flags & Header::CONTAINER_V2)
+  {
+    input.seekg(0, std::ios::end);
+    const size_t fileSize = size_t(input.tellg());
+    if(fileSize < sizeof(Header))
+      return SimpleMesh();
+    std::vector<uint8_t> data(fileSize - sizeof(Header));
+    input.seekg(sizeof(Header), std::ios::beg);
+    input.read((char*)data.data(), data.size());
+    return DecodeVSGFv2(header, data.data(), data.size(), a_fileName);
+  }
 
-  if(header.flags & Header::HAS_TANGENT)
-    input.read((char*)res.vTang4f.data(), res.vTang4f.size()*sizeof(float)*4);
-  else
-    std::fill(res.vTang4f.begin(), res.vTang4f.end(), LiteMath::float4{});
+  input.seekg(0, std::ios::end);
+  const size_t fileSize = size_t(input.tellg());
+  input.seekg(sizeof(Header), std::ios::beg);
+  if(!input.good() || !VSGFv1SizeIsValid(header, fileSize, a_fileName, "LoadMeshFromVSGF"))
+    return SimpleMesh();
 
-  input.read((char*)res.vTexCoord2f.data(), res.vTexCoord2f.size()*sizeof(float)*2);
+  SimpleMesh res(header.verticesNum, header.indicesNum, AttributesFromVSGFFlags(header.flags), TopologyFromVSGFFlags(header.flags)); // absent channels are not allocated and take no space in file
+
+  input.read((char*)res.vPos4f.data(),        res.vPos4f.size()*sizeof(float)*4);
+  input.read((char*)res.vNorm4f.data(),       res.vNorm4f.size()*sizeof(float)*4);
+  input.read((char*)res.vTang4f.data(),       res.vTang4f.size()*sizeof(float)*4);
+  input.read((char*)res.vTexCoord2f.data(),   res.vTexCoord2f.size()*sizeof(float)*2);
+  input.read((char*)res.vTexCoord2f_1.data(), res.vTexCoord2f_1.size()*sizeof(float)*2);
+  input.read((char*)res.vColor4f.data(),      res.vColor4f.size()*sizeof(float)*4);
   input.read((char*)res.indices.data(),    res.indices.size()*sizeof(unsigned int));
   input.read((char*)res.matIndices.data(), res.matIndices.size()*sizeof(unsigned int));
+  if(!input.good())
+  {
+    printf("[LoadMeshFromVSGF::ERROR] Can't read %s\n", a_fileName);
+    return SimpleMesh();
+  }
   input.close();
 
+  if(header.flags & Header::HAS_NO_NORMALS)
+    ComputeNormals(res, NORMALS_ANGLE_WEIGHTED); // smooth, as flat normals would change vertex count
+
   return res; 
 }
 
+cmesh4::SimpleMeshView cmesh4::LoadMeshViewFromVSGF(const char* a_fileName)
+{
+  auto pFile = std::make_shared<MappedFile>();
+  if(!pFile->Open(a_fileName) || pFile->Size() < sizeof(Header))
+    return SimpleMeshView();
+
+  Header header;
+  memcpy(&header, pFile->Data(), sizeof(Header)); // FIXME: ENDIANNES NOT CHECKED !!!
+
+  if(header.flags & Header::CONTAINER_V2) // streams of v2 files are encoded, they can't be used in place
+    return SimpleMeshView();
+
+  if(!VSGFv1SizeIsValid(header, pFile->Size(), a_fileName, "LoadMeshViewFromVSGF"))
+    return SimpleMeshView();
+
+  const size_t vertNum  = header.verticesNum;
+  const size_t indNum   = header.indicesNum;
+  const size_t primNum  = indNum/((header.flags & Header::QUADS) ? SimpleMesh::POINTS_IN_QUAD : SimpleMesh::POINTS_IN_TRIANGLE);
+  const uint32_t attribs = AttributesFromVSGFFlags(header.flags);
+  const size_t normNum  = (attribs & SimpleMesh::ATTR_NORMAL)    ? vertNum : 0;
+  const size_t tangNum  = (attribs & SimpleMesh::ATTR_TANGENT)   ? vertNum : 0;
+  const size_t uvNum    = (attribs & SimpleMesh::ATTR_TEXCOORD)  ? vertNum : 0;
+  const size_t uv1Num   = (attribs & SimpleMesh::ATTR_TEXCOORD1) ? vertNum : 0;
+  const size_t colorNum = (attribs & SimpleMesh::ATTR_COLOR)     ? vertNum : 0;
+
+  const uint8_t* ptr = pFile->Data() + sizeof(Header);
+
+  SimpleMeshView res;
+  res.vPos4f        = ConstSpan<float>((const float*)ptr, vertNum*4);         ptr += vertNum*sizeof(float)*4;
+  res.vNorm4f       = ConstSpan<float>((const float*)ptr, normNum*4);         ptr += normNum*sizeof(float)*4;
+  res.vTang4f       = ConstSpan<float>((const float*)ptr, tangNum*4);         ptr += tangNum*sizeof(float)*4;
+  res.vTexCoord2f   = ConstSpan<float>((const float*)ptr, uvNum*2);           ptr += uvNum*sizeof(float)*2;
+  res.vTexCoord2f_1 = ConstSpan<float>((const float*)ptr, uv1Num*2);          ptr += uv1Num*sizeof(float)*2;
+  res.vColor4f      = ConstSpan<float>((const float*)ptr, colorNum*4);        ptr += colorNum*sizeof(float)*4;
+  res.indices       = ConstSpan<unsigned int>((const unsigned int*)ptr, indNum); ptr += indNum*sizeof(unsigned int);
+  res.matIndices    = ConstSpan<unsigned int>((const unsigned int*)ptr, primNum);
+  res.flags         = header.flags;
+  res.file          = pFile;
+  return res;
+}
+
 #endif
 
-void cmesh4::SaveMeshToVSGF(const char* a_fileName, const SimpleMesh& a_mesh)
+cmesh4::float4 cmesh4::SimpleMeshView::GetPos(size_t a_vertId) const
+{
+  const float* p = vPos4f.data() + a_vertId*4;
+  return float4(p[0], p[1], p[2], p[3]);
+}
+
+cmesh4::float4 cmesh4::SimpleMeshView::GetNorm(size_t a_vertId) const
+{
+  if(vNorm4f.empty())
+    return float4(0,0,0,0);
+  const float* p = vNorm4f.data() + a_vertId*4;
+  return float4(p[0], p[1], p[2], p[3]);
+}
+
+cmesh4::float4 cmesh4::SimpleMeshView::GetTang(size_t a_vertId) const
+{
+  if(vTang4f.empty())
+    return float4(0,0,0,0);
+  const float* p = vTang4f.data() + a_vertId*4;
+  return float4(p[0], p[1], p[2], p[3]);
+}
+
+cmesh4::float2 cmesh4::SimpleMeshView::GetTexCoord(size_t a_vertId) const
+{
+  if(vTexCoord2f.empty())
+    return float2(0,0);
+  const float* p = vTexCoord2f.data() + a_vertId*2;
+  return float2(p[0], p[1]);
+}
+
+cmesh4::SimpleMesh cmesh4::SimpleMeshView::ToSimpleMesh() const
+{
+  SimpleMesh res(VerticesNum(), IndicesNum(), AttributesFromVSGFFlags(flags), TopologyFromVSGFFlags(flags));
+
+  memcpy((void*)res.vPos4f.data(),        vPos4f.data(),        vPos4f.size()*sizeof(float));
+  memcpy((void*)res.vNorm4f.data(),       vNorm4f.data(),       vNorm4f.size()*sizeof(float));
+  memcpy((void*)res.vTang4f.data(),       vTang4f.data(),       vTang4f.size()*sizeof(float));
+  memcpy((void*)res.vTexCoord2f.data(),   vTexCoord2f.data(),   vTexCoord2f.size()*sizeof(float));
+  memcpy((void*)res.vTexCoord2f_1.data(), vTexCoord2f_1.data(), vTexCoord2f_1.size()*sizeof(float));
+  memcpy((void*)res.vColor4f.data(),      vColor4f.data(),      vColor4f.size()*sizeof(float));
+  memcpy((void*)res.indices.data(),     indices.data(),     indices.size()*sizeof(unsigned int));
+  memcpy((void*)res.matIndices.data(),  matIndices.data(),  matIndices.size()*sizeof(unsigned int));
+  return res;
+}
+
+bool cmesh4::SaveMeshToVSGF(const char* a_fileName, const SimpleMesh& a_mesh)
 {
   std::ofstream output(a_fileName, std::ios::binary);
+  if(!output.is_open())
+  {
+    printf("[SaveMeshToVSGF::ERROR] Can't open file %s for writing\n", a_fileName);
+    return false;
+  }
+
+  // channels with wrong size can't be described by the header, so they are skipped
+  const uint32_t attribs = a_mesh.Attributes();
+  const size_t   vertNum = a_mesh.VerticesNum();
+  size_t dataSize = vertNum*sizeof(float)*4 + (a_mesh.indices.size() + a_mesh.matIndices.size())*sizeof(unsigned int);
+  if(attribs & SimpleMesh::ATTR_NORMAL)    dataSize += vertNum*sizeof(float)*4;
+  if(attribs & SimpleMesh::ATTR_TANGENT)   dataSize += vertNum*sizeof(float)*4;
+  if(attribs & SimpleMesh::ATTR_TEXCOORD)  dataSize += vertNum*sizeof(float)*2;
+  if(attribs & SimpleMesh::ATTR_TEXCOORD1) dataSize += vertNum*sizeof(float)*2;
+  if(attribs & SimpleMesh::ATTR_COLOR)     dataSize += vertNum*sizeof(float)*4;
 
   Header header;
-  header.fileSizeInBytes = sizeof(header) + a_mesh.SizeInBytes();
+  header.fileSizeInBytes = sizeof(header) + dataSize;
   header.verticesNum     = static_cast<uint32_t>(a_mesh.VerticesNum());
   header.indicesNum      = static_cast<uint32_t>(a_mesh.IndicesNum());
   header.materialsNum    = static_cast<uint32_t>(a_mesh.matIndices.size());
-  header.flags           = 0;
-
-  if(a_mesh.vNorm4f.size() == 0)
-    header.flags |= Header::HAS_NO_NORMALS;
-
-  if(a_mesh.vTang4f.size() != 0)
-    header.flags |= Header::HAS_TANGENT;
+  header.flags           = VSGFFlagsFromAttributes(attribs) | VSGFFlagsFromTopology(a_mesh.topology);
 
   output.write((char*)&header, sizeof(Header));
   output.write((char*)a_mesh.vPos4f.data(), a_mesh.vPos4f.size() * sizeof(float) * 4);
 
-  if(a_mesh.vNorm4f.size() != 0)
+  if(attribs & SimpleMesh::ATTR_NORMAL)
     output.write((char*)a_mesh.vNorm4f.data(), a_mesh.vNorm4f.size() * sizeof(float) * 4);
 
-  if (a_mesh.vTang4f.size() != 0)
+  if(attribs & SimpleMesh::ATTR_TANGENT)
     output.write((char*)a_mesh.vTang4f.data(), a_mesh.vTang4f.size() * sizeof(float) * 4);
 
-  output.write((char*)a_mesh.vTexCoord2f.data(), a_mesh.vTexCoord2f.size() * sizeof(float) * 2);
+  if(attribs & SimpleMesh::ATTR_TEXCOORD)
+    output.write((char*)a_mesh.vTexCoord2f.data(), a_mesh.vTexCoord2f.size() * sizeof(float) * 2);
+
+  if(attribs & SimpleMesh::ATTR_TEXCOORD1)
+    output.write((char*)a_mesh.vTexCoord2f_1.data(), a_mesh.vTexCoord2f_1.size() * sizeof(float) * 2);
+
+  if(attribs & SimpleMesh::ATTR_COLOR)
+    output.write((char*)a_mesh.vColor4f.data(), a_mesh.vColor4f.size() * sizeof(float) * 4);
+
   output.write((char*)a_mesh.indices.data(),     a_mesh.indices.size() * sizeof(unsigned int));
   output.write((char*)a_mesh.matIndices.data(),  a_mesh.matIndices.size() * sizeof(unsigned int));
 
   output.close();
+  return bool(output);
 }
 
-float cmesh4::SimpleMesh::GetAvgTriArea() const
+uint32_t cmesh4::AttributesFromVSGFFlags(uint32_t a_flags)
+{
+  uint32_t res = 0;
+  if(!(a_flags & Header::HAS_NO_NORMALS))  res |= SimpleMesh::ATTR_NORMAL;
+  if(a_flags & Header::HAS_TANGENT)        res |= SimpleMesh::ATTR_TANGENT;
+  if(!(a_flags & Header::HAS_NO_TEXCOORD)) res |= SimpleMesh::ATTR_TEXCOORD;
+  if(a_flags & Header::HAS_TEXCOORD1)      res |= SimpleMesh::ATTR_TEXCOORD1;
+  if(a_flags & Header::HAS_COLOR)          res |= SimpleMesh::ATTR_COLOR;
+  return res;
+}
+
+uint32_t cmesh4::VSGFFlagsFromAttributes(uint32_t a_attribs)
+{
+  uint32_t res = 0;
+  if(!(a_attribs & SimpleMesh::ATTR_NORMAL))   res |= Header::HAS_NO_NORMALS;
+  if(a_attribs & SimpleMesh::ATTR_TANGENT)     res |= Header::HAS_TANGENT;
+  if(!(a_attribs & SimpleMesh::ATTR_TEXCOORD)) res |= Header::HAS_NO_TEXCOORD;
+  if(a_attribs & SimpleMesh::ATTR_TEXCOORD1)   res |= Header::HAS_TEXCOORD1;
+  if(a_attribs & SimpleMesh::ATTR_COLOR)       res |= Header::HAS_COLOR;
+  return res;
+}
+
+cmesh4::SimpleMesh::SIMPLE_MESH_TOPOLOGY cmesh4::TopologyFromVSGFFlags(uint32_t a_flags)
+{
+  return (a_flags & Header::QUADS) ? SimpleMesh::SIMPLE_MESH_QUADS : SimpleMesh::SIMPLE_MESH_TRIANGLES;
+}
+
+uint32_t cmesh4::VSGFFlagsFromTopology(SimpleMesh::SIMPLE_MESH_TOPOLOGY a_topology)
 {
-  float res = 0.0;
-  for(size_t i = 0; i < TrianglesNum(); i++)
+  return (a_topology == SimpleMesh::SIMPLE_MESH_QUADS) ? uint32_t(Header::QUADS) : 0u;
+}
+
+namespace cmesh4
+{
+  // every quad gives 2 triangles split by the shorter diagonal, the same split as LoadMeshFromObj makes; a_pos has 4 floats per vertex
+  //
+  static void TriangulateQuads(const float* a_pos, size_t a_vertNum, const unsigned int* a_quads, const unsigned int* a_quadMat, size_t a_quadsNum,
+                               std::vector<unsigned int>& a_indices, std::vector<unsigned int>& a_matIndices)
   {
-    uint32_t indA = indices[i * 3 + 0];
-    uint32_t indB = indices[i * 3 + 1];
-    uint32_t indC = indices[i * 3 + 2];
+    const int64_t quadsNum = int64_t(a_quadsNum);
+    a_indices.resize(a_quadsNum*6);
+    a_matIndices.resize(a_quadMat != nullptr ? a_quadsNum*2 : 0);
 
-    LiteMath::float3 A = LiteMath::float3(vPos4f[indA].x, vPos4f[indA].y, vPos4f[indA].z);
-    LiteMath::float3 B = LiteMath::float3(vPos4f[indB].x, vPos4f[indB].y, vPos4f[indB].z);
-    LiteMath::float3 C = LiteMath::float3(vPos4f[indC].x, vPos4f[indC].y, vPos4f[indC].z);
+    #pragma omp parallel for if(quadsNum >= 16384)
+    for(int64_t q = 0; q < quadsNum; q++)
+    {
+      const unsigned int* quad = a_quads + q*4;
+      bool at02 = true; // (0,1,2),(0,2,3) or (0,1,3),(1,2,3)
+      if(quad[0] < a_vertNum && quad[1] < a_vertNum && quad[2] < a_vertNum && quad[3] < a_vertNum)
+      {
+        float d02 = 0.0f, d13 = 0.0f;
+        for(int k = 0; k < 3; k++)
+        {
+          const float a = a_pos[size_t(quad[2])*4 + k] - a_pos[size_t(quad[0])*4 + k];
+          const float b = a_pos[size_t(quad[3])*4 + k] - a_pos[size_t(quad[1])*4 + k];
+          d02 += a*a;
+          d13 += b*b;
+        }
+        at02 = (d02 < d13);
+      }
 
-    LiteMath::float3 edge1A = normalize(B - A);
-    LiteMath::float3 edge2A = normalize(C - A);
+      unsigned int* tri = a_indices.data() + q*6;
+      tri[0] = quad[0];
+      tri[1] = quad[1];
+      tri[2] = quad[at02 ? 2 : 3];
+      tri[3] = quad[at02 ? 0 : 1];
+      tri[4] = quad[2];
+      tri[5] = quad[3];
+      if(a_quadMat != nullptr)
+        a_matIndices[q*2 + 0] = a_matIndices[q*2 + 1] = a_quadMat[q];
+    }
+  }
+};
 
-    float area = 0.5f * sqrtf(powf(edge1A.y * edge2A.z - edge1A.z * edge2A.y, 2) +
-                              powf(edge1A.z * edge2A.x - edge1A.x * edge2A.z, 2) +
-                              powf(edge1A.x * edge2A.y - edge1A.y * edge2A.x, 2));
+void cmesh4::TriangulatedIndices(const SimpleMesh& a_mesh, std::vector<unsigned int>& a_indices, std::vector<unsigned int>& a_matIndices)
+{
+  if(a_mesh.topology == SimpleMesh::SIMPLE_MESH_TRIANGLES)
+  {
+    a_indices    = a_mesh.indices;
+    a_matIndices = a_mesh.matIndices;
+    return;
+  }
+  const size_t quadsNum = a_mesh.PrimitivesNum();
+  TriangulateQuads((const float*)a_mesh.vPos4f.data(), a_mesh.VerticesNum(), a_mesh.indices.data(),
+                   (a_mesh.matIndices.size() == quadsNum) ? a_mesh.matIndices.data() : nullptr, quadsNum, a_indices, a_matIndices);
+}
 
-    res += area;
+void cmesh4::TriangulatedIndices(const SimpleMeshView& a_mesh, std::vector<unsigned int>& a_indices, std::vector<unsigned int>& a_matIndices)
+{
+  if(!(a_mesh.flags & Header::QUADS))
+  {
+    a_indices.assign(a_mesh.indices.begin(), a_mesh.indices.end());
+    a_matIndices.assign(a_mesh.matIndices.begin(), a_mesh.matIndices.end());
+    return;
   }
+  const size_t quadsNum = a_mesh.IndicesNum()/SimpleMesh::POINTS_IN_QUAD;
+  TriangulateQuads(a_mesh.vPos4f.data(), a_mesh.VerticesNum(), a_mesh.indices.data(),
+                   (a_mesh.matIndices.size() == quadsNum) ? a_mesh.matIndices.data() : nullptr, quadsNum, a_indices, a_matIndices);
+}
+
+cmesh4::TriangleIndices::TriangleIndices(const SimpleMesh& a_mesh) :
+  indices   ((a_mesh.topology == SimpleMesh::SIMPLE_MESH_TRIANGLES) ? a_mesh.indices    : m_indices),
+  matIndices((a_mesh.topology == SimpleMesh::SIMPLE_MESH_TRIANGLES) ? a_mesh.matIndices : m_matIndices)
+{
+  if(a_mesh.topology != SimpleMesh::SIMPLE_MESH_TRIANGLES)
+    TriangulatedIndices(a_mesh, m_indices, m_matIndices);
+}
+
+void cmesh4::SimpleMesh::Triangulate()
+{
+  if(topology == SIMPLE_MESH_TRIANGLES)
+    return;
 
-  res /= static_cast<float>(TrianglesNum());
+  std::vector<unsigned int> triIndices, triMaterials;
+  TriangulatedIndices(*this, triIndices, triMaterials);
 
-  return float(res);
+  for(MaterialRange& range : matRanges)
+  {
+    range.firstIndex = range.firstIndex/4*6;
+    range.indexCount = range.indexCount/4*6;
+  }
+
+  indices    = std::move(triIndices);
+  matIndices = std::move(triMaterials);
+  topology   = SIMPLE_MESH_TRIANGLES;
 }
 
-float cmesh4::SimpleMesh::GetAvgTriPerimeter() const
+const cmesh4::SimpleMesh& cmesh4::AsTriangles(const SimpleMesh& a_mesh, SimpleMesh& a_temp)
 {
-  float res = 0.0;
-  for(size_t i = 0; i < TrianglesNum(); i++)
+  if(a_mesh.topology == SimpleMesh::SIMPLE_MESH_TRIANGLES)
+    return a_mesh;
+  a_temp = a_mesh;
+  a_temp.Triangulate();
+  return a_temp;
+}
+
+uint32_t cmesh4::SimpleMesh::Attributes() const
+{
+  const size_t vertNum = VerticesNum();
+  if(vertNum == 0)
+    return 0;
+  uint32_t res = 0;
+  if(vNorm4f.size()       == vertNum) res |= ATTR_NORMAL;
+  if(vTang4f.size()       == vertNum) res |= ATTR_TANGENT;
+  if(vTexCoord2f.size()   == vertNum) res |= ATTR_TEXCOORD;
+  if(vTexCoord2f_1.size() == vertNum) res |= ATTR_TEXCOORD1;
+  if(vColor4f.size()      == vertNum) res |= ATTR_COLOR;
+  return res;
+}
+
+LiteMath::Box4f cmesh4::SimpleMesh::GetAABB() const
+{
+  LiteMath::Box4f res;
+  const int64_t vertNum = int64_t(VerticesNum());
+  const float4* vPos    = vPos4f.data();
+
+  #pragma omp parallel if(vertNum >= 16384)
   {
-    uint32_t indA = indices[i * 3 + 0];
-    uint32_t indB = indices[i * 3 + 1];
-    uint32_t indC = indices[i * 3 + 2];
+    float4 boxMin(+FLT_MAX), boxMax(-FLT_MAX);
+
+    #pragma omp for nowait
+    for(int64_t i = 0; i < vertNum; i++)
+    {
+      boxMin = LiteMath::min(boxMin, vPos[i]);
+      boxMax = LiteMath::max(boxMax, vPos[i]);
+    }
+
+    #pragma omp critical
+    res.include(LiteMath::Box4f(boxMin, boxMax));
+  }
+
+  return res;
+}
+
+cmesh4::MeshStats cmesh4::SimpleMesh::ComputeStats() const
+{
+  MeshStats res;
+  res.aabb = GetAABB();
+
+  const TriangleIndices tris(*this);
+  const int64_t trisNum  = int64_t(tris.TrianglesNum());
+  const int64_t vertNum  = int64_t(VerticesNum());
+  const float4* vPos     = vPos4f.data();
+  const uint32_t* ind    = tris.indices.data();
+  const uint32_t* matIds = (tris.matIndices.size() >= size_t(trisNum)) ? tris.matIndices.data() : nullptr;
+
+  uint64_t validTris = 0; // with all indices in range, averages are taken over them as in GetAvgTriArea() of cmesh4_storage.h
+  #pragma omp parallel if(trisNum >= 16384)
+  {
+    double   area = 0.0, perimeter = 0.0;
+    uint64_t degenerate = 0, noMaterial = 0, badMaterial = 0, valid = 0;
+    std::vector<uint32_t> perMaterial;
+
+    #pragma omp for nowait
+    for(int64_t i = 0; i < trisNum; i++)
+    {
+      if(matIds != nullptr)
+      {
+        const uint32_t matId = matIds[i];
+        if(matId == uint32_t(-1))
+          noMaterial++;
+        else if(matId >= MeshStats::MAX_MATERIALS)
+          badMaterial++;
+        else
+        {
+          if(matId >= perMaterial.size())
+            perMaterial.resize(size_t(matId) + 1, 0);
+          perMaterial[matId]++;
+        }
+      }
+
+      const uint32_t indA = ind[i * 3 + 0];
+      const uint32_t indB = ind[i * 3 + 1];
+      const uint32_t indC = ind[i * 3 + 2];
+      if(int64_t(indA) >= vertNum || int64_t(indB) >= vertNum || int64_t(indC) >= vertNum)
+      {
+        degenerate++;
+        continue;
+      }
+      valid++; // repeated indices give zero area below and are counted as degenerate there
+
+      const LiteMath::float3 A = LiteMath::to_float3(vPos[indA]);
+      const LiteMath::float3 B = LiteMath::to_float3(vPos[indB]);
+      const LiteMath::float3 C = LiteMath::to_float3(vPos[indC]);
+
+      const LiteMath::float3 edgeAB = B - A;
+      const LiteMath::float3 edgeAC = C - A;
+      const LiteMath::float3 edgeBC = C - B;
+      const float lenAB = LiteMath::length(edgeAB);
+      const float lenAC = LiteMath::length(edgeAC);
+      const float lenBC = LiteMath::length(edgeBC);
+      const float crossLen = LiteMath::length(LiteMath::cross(edgeAB, edgeAC));
+      const float maxEdge  = std::max(lenAB, std::max(lenAC, lenBC));
+
+      if(crossLen <= 1e-7f*maxEdge*maxEdge) // relative test, so small but well shaped triangles are not counted
+        degenerate++;
+
+      area      += 0.5*double(crossLen);
+      perimeter += double(lenAB + lenAC + lenBC);
+    }
 
-    LiteMath::float3 A = LiteMath::float3(vPos4f[indA].x, vPos4f[indA].y, vPos4f[indA].z);
-    LiteMath::float3 B = LiteMath::float3(vPos4f[indB].x, vPos4f[indB].y, vPos4f[indB].z);
-    LiteMath::float3 C = LiteMath::float3(vPos4f[indC].x, vPos4f[indC].y, vPos4f[indC].z);
+    #pragma omp critical
+    {
+      res.totalArea           += area;
+      res.totalPerimeter      += perimeter;
+      res.degenerateTriangles += degenerate;
+      res.noMaterialTriangles += noMaterial;
+      res.badMaterialTriangles += badMaterial;
+      validTris               += valid;
+      if(perMaterial.size() > res.trianglesPerMaterial.size())
+        res.trianglesPerMaterial.resize(perMaterial.size(), 0);
+      for(size_t m = 0; m < perMaterial.size(); m++)
+        res.trianglesPerMaterial[m] += perMaterial[m];
+    }
+  }
 
-    float edge1len = LiteMath::length(B - A);
-    float edge2len = LiteMath::length(C - A);
-    float edge3len = LiteMath::length(C - B);
+  if(validTris > 0)
+  {
+    res.avgTriArea      = float(res.totalArea/double(validTris));
+    res.avgTriPerimeter = float(res.totalPerimeter/double(validTris));
+  }
 
-    res += edge1len + edge2len + edge3len;
+  return res;
+}
+
+namespace cmesh4
+{
+  // average of a_func(A, B, C) over triangles with all indices in range, as in ComputeStats() and the SoA GetAvgTriArea()
+  //
+  template<typename Func>
+  static float AverageOverTriangles(const SimpleMesh& a_mesh, Func a_func)
+  {
+    const TriangleIndices tris(a_mesh);
+    const int64_t   trisNum = int64_t(tris.TrianglesNum());
+    const size_t    vertNum = a_mesh.VerticesNum();
+    const float4*   vPos    = a_mesh.vPos4f.data();
+    const uint32_t* ind     = tris.indices.data();
+
+    double  sum   = 0.0;
+    int64_t valid = 0;
+    #pragma omp parallel for reduction(+:sum,valid) if(trisNum >= 16384)
+    for(int64_t i = 0; i < trisNum; i++)
+    {
+      const uint32_t* tri = ind + i*3;
+      if(tri[0] >= vertNum || tri[1] >= vertNum || tri[2] >= vertNum)
+        continue;
+      sum += double(a_func(LiteMath::to_float3(vPos[tri[0]]), LiteMath::to_float3(vPos[tri[1]]), LiteMath::to_float3(vPos[tri[2]])));
+      valid++;
+    }
+    return (valid > 0) ? float(sum/double(valid)) : 0.0f;
   }
+};
 
-  res /= static_cast<float>(TrianglesNum());
+float cmesh4::SimpleMesh::GetAvgTriArea() const
+{
+  return AverageOverTriangles(*this, [](const LiteMath::float3& A, const LiteMath::float3& B, const LiteMath::float3& C) {
+    return 0.5f*LiteMath::length(LiteMath::cross(B - A, C - A));
+  });
+}
 
-  return float(res);
+float cmesh4::SimpleMesh::GetAvgTriPerimeter() const
+{
+  return AverageOverTriangles(*this, [](const LiteMath::float3& A, const LiteMath::float3& B, const LiteMath::float3& C) {
+    return LiteMath::length(B - A) + LiteMath::length(C - A) + LiteMath::length(C - B);
+  });
 }
 
+namespace cmesh4
+{
+  // transforms xyz as a direction and normalizes it; w (e.g. tangent handedness) is kept, zero vectors stay zero
+  //
+  static inline float4 TransformDirection(const LiteMath::float4x4& m, float4 v)
+  {
+    const float4 res = LiteMath::mul(m, float4(v.x, v.y, v.z, 0.0f));
+    const float  len = std::sqrt(res.x*res.x + res.y*res.y + res.z*res.z);
+    const float  inv = (len > 0.0f) ? 1.0f/len : 0.0f;
+    return float4(res.x*inv, res.y*inv, res.z*inv, v.w);
+  }
+
+  // ApplyMatrix kernels for a range of vertices; a_keepZero leaves the old vector where the transformed one is zero
+  //
+  static void TransformPoints(const LiteMath::float4x4& m, float4* a_data, size_t a_size)
+  {
+    for(size_t i = 0; i < a_size; i++)
+      a_data[i] = LiteMath::mul(m, a_data[i]);
+  }
+
+  static void TransformDirections(const LiteMath::float4x4& m, float4* a_data, size_t a_size, bool a_keepZero)
+  {
+    for(size_t i = 0; i < a_size; i++)
+    {
+      const float4 n = TransformDirection(m, a_data[i]);
+      if(!a_keepZero || n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
+        a_data[i] = n;
+    }
+  }
+};
+
+// 8 vertices at a time with AVX on x86-64, selected at runtime; the same operations in the same order as above, so results
+// do not depend on the CPU. Only AVX instructions are used, so there is no need to require AVX2
+//
+#ifdef CMESH4_AVX_KERNELS
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CMESH4_TARGET_AVX
+#else
+#define CMESH4_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace cmesh4
+{
+  static bool CPUHasAVX()
+  {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 1);
+    const bool osxsave = (regs[2] & (1 << 27)) != 0, avx = (regs[2] & (1 << 28)) != 0;
+    return osxsave && avx && (_xgetbv(0) & 6) == 6; // OS saves ymm registers
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+  }
+
+  static const bool g_useAVX = CPUHasAVX();
+
+  // 8 AoS float4 (4 registers of 2 vertices) <-> 4 registers of x, y, z, w; lane order is permuted, but back and forth the same way
+  //
+  CMESH4_TARGET_AVX static inline void LoadSoA8(const float4* a_src, __m256& x, __m256& y, __m256& z, __m256& w)
+  {
+    const __m256 r0 = _mm256_loadu_ps((const float*)(a_src + 0)), r1 = _mm256_loadu_ps((const float*)(a_src + 2));
+    const __m256 r2 = _mm256_loadu_ps((const float*)(a_src + 4)), r3 = _mm256_loadu_ps((const float*)(a_src + 6));
+    const __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1);
+    const __m256 t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3);
+    x = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0));
+    y = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+    z = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0));
+    w = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+  }
+
+  CMESH4_TARGET_AVX static inline void StoreSoA8(float4* a_dst, __m256 x, __m256 y, __m256 z, __m256 w)
+  {
+    const __m256 t0 = _mm256_unpacklo_ps(x, y), t1 = _mm256_unpackhi_ps(x, y);
+    const __m256 t2 = _mm256_unpacklo_ps(z, w), t3 = _mm256_unpackhi_ps(z, w);
+    _mm256_storeu_ps((float*)(a_dst + 0), _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0)));
+    _mm256_storeu_ps((float*)(a_dst + 2), _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2)));
+    _mm256_storeu_ps((float*)(a_dst + 4), _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0)));
+    _mm256_storeu_ps((float*)(a_dst + 6), _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2)));
+  }
+
+  struct MatrixAVX { __m256 e[4][4]; }; ///< e[col][row] broadcast to all lanes
+
+  CMESH4_TARGET_AVX static inline MatrixAVX BroadcastMatrix(const LiteMath::float4x4& m)
+  {
+    MatrixAVX res;
+    for(int col = 0; col < 4; col++)
+    {
+      const float4 c = m.get_col(col);
+      res.e[col][0] = _mm256_set1_ps(c.x);
+      res.e[col][1] = _mm256_set1_ps(c.y);
+      res.e[col][2] = _mm256_set1_ps(c.z);
+      res.e[col][3] = _mm256_set1_ps(c.w);
+    }
+    return res;
+  }
+
+  CMESH4_TARGET_AVX static void TransformPointsAVX(const LiteMath::float4x4& m, float4* a_data, size_t a_size)
+  {
+    const MatrixAVX M = BroadcastMatrix(m);
+    size_t i = 0;
+    for(; i + 8 <= a_size; i += 8)
+    {
+      __m256 x, y, z, w;
+      LoadSoA8(a_data + i, x, y, z, w);
+      __m256 res[4];
+      for(int row = 0; row < 4; row++)
+      {
+        res[row] = _mm256_add_ps(_mm256_mul_ps(M.e[0][row], x), _mm256_mul_ps(M.e[1][row], y));
+        res[row] = _mm256_add_ps(res[row], _mm256_mul_ps(M.e[2][row], z));
+        res[row] = _mm256_add_ps(res[row], _mm256_mul_ps(M.e[3][row], w));
+      }
+      StoreSoA8(a_data + i, res[0], res[1], res[2], res[3]);
+    }
+    TransformPoints(m, a_data + i, a_size - i);
+  }
+
+  CMESH4_TARGET_AVX static void TransformDirectionsAVX(const LiteMath::float4x4& m, float4* a_data, size_t a_size, bool a_keepZero)
+  {
+    const MatrixAVX M    = BroadcastMatrix(m);
+    const __m256    zero = _mm256_setzero_ps();
+    const __m256    one  = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i + 8 <= a_size; i += 8)
+    {
+      __m256 x, y, z, w;
+      LoadSoA8(a_data + i, x, y, z, w);
+      __m256 res[3];
+      for(int row = 0; row < 3; row++)
+      {
+        res[row] = _mm256_add_ps(_mm256_mul_ps(M.e[0][row], x), _mm256_mul_ps(M.e[1][row], y));
+        res[row] = _mm256_add_ps(res[row], _mm256_mul_ps(M.e[2][row], z));
+        res[row] = _mm256_add_ps(res[row], _mm256_mul_ps(M.e[3][row], zero));
+      }
+      __m256 len2 = _mm256_add_ps(_mm256_mul_ps(res[0], res[0]), _mm256_mul_ps(res[1], res[1]));
+      len2 = _mm256_add_ps(len2, _mm256_mul_ps(res[2], res[2]));
+      const __m256 len = _mm256_sqrt_ps(len2);
+      const __m256 inv = _mm256_and_ps(_mm256_div_ps(one, len), _mm256_cmp_ps(len, zero, _CMP_GT_OQ));
+      const __m256 nx  = _mm256_mul_ps(res[0], inv), ny = _mm256_mul_ps(res[1], inv), nz = _mm256_mul_ps(res[2], inv);
+      if(a_keepZero)
+      {
+        const __m256 nonZero = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(nx, zero, _CMP_NEQ_UQ), _mm256_cmp_ps(ny, zero, _CMP_NEQ_UQ)),
+                                            _mm256_cmp_ps(nz, zero, _CMP_NEQ_UQ));
+        StoreSoA8(a_data + i, _mm256_blendv_ps(x, nx, nonZero), _mm256_blendv_ps(y, ny, nonZero), _mm256_blendv_ps(z, nz, nonZero), w);
+      }
+      else
+        StoreSoA8(a_data + i, nx, ny, nz, w);
+    }
+    TransformDirections(m, a_data + i, a_size - i, a_keepZero);
+  }
+};
+#endif
 
 void cmesh4::SimpleMesh::ApplyMatrix(const LiteMath::float4x4& m)
 {
@@ -262,15 +872,72 @@ void cmesh4::SimpleMesh::ApplyMatrix(const LiteMath::float4x4& m)
   mRot = m;
   mRot.set_col(3, float4(0,0,0,1));
 
+  // normals must be transformed with inverse transpose to stay orthogonal to surface under non-uniform scale.
+  // Cofactor matrix is the inverse transpose scaled by determinant, but unlike the inverse it exists for singular
+  // matrices too: zero scale on one axis projects normals onto the flattened plane instead of making them NaN
+  //
+  const LiteMath::float3 c0 = LiteMath::to_float3(mRot.get_col(0));
+  const LiteMath::float3 c1 = LiteMath::to_float3(mRot.get_col(1));
+  const LiteMath::float3 c2 = LiteMath::to_float3(mRot.get_col(2));
+  const LiteMath::float3 n0 = LiteMath::cross(c1, c2);
+  const LiteMath::float3 n1 = LiteMath::cross(c2, c0);
+  const LiteMath::float3 n2 = LiteMath::cross(c0, c1);
+  const float            sgn = (LiteMath::dot(c0, n0) < 0.0f) ? -1.0f : 1.0f; // keeps normals outward under mirroring
+
+  LiteMath::float4x4 mNorm;
+  mNorm.set_col(0, float4(n0.x, n0.y, n0.z, 0.0f)*sgn);
+  mNorm.set_col(1, float4(n1.x, n1.y, n1.z, 0.0f)*sgn);
+  mNorm.set_col(2, float4(n2.x, n2.y, n2.z, 0.0f)*sgn);
+  mNorm.set_col(3, float4(0,0,0,1));
+
   LiteMath::float4* vPos  = vPos4f.data();
   LiteMath::float4* vNorm = vNorm4f.data();
   LiteMath::float4* vTang = vTang4f.data();
 
-  for(size_t i=0; i<VerticesNum(); i++)
+  const int64_t vertNum = int64_t(VerticesNum());
+  const bool    hasNorm = vNorm4f.size() >= vPos4f.size();
+  const bool    hasTang = vTang4f.size() >= vPos4f.size();
+
+  // every channel is processed in chunks, each chunk by the fastest kernel the CPU supports
+  //
+  auto points = [&](float4* a_data, size_t a_size) {
+#ifdef CMESH4_AVX_KERNELS
+    if(g_useAVX)
+      return TransformPointsAVX(m, a_data, a_size);
+#endif
+    TransformPoints(m, a_data, a_size);
+  };
+  auto directions = [&](const LiteMath::float4x4& a_m, float4* a_data, size_t a_size, bool a_keepZero) {
+#ifdef CMESH4_AVX_KERNELS
+    if(g_useAVX)
+      return TransformDirectionsAVX(a_m, a_data, a_size, a_keepZero);
+#endif
+    TransformDirections(a_m, a_data, a_size, a_keepZero);
+  };
+
+  const int64_t CHUNK     = 4096;
+  const int64_t chunksNum = (vertNum + CHUNK - 1)/CHUNK;
+  auto chunkSize = [&](int64_t c) { return size_t(std::min(CHUNK, vertNum - c*CHUNK)); };
+
+  #pragma omp parallel if(vertNum >= 16384)
   {
-    vPos [i] = mul(m,vPos[i]);
-    vNorm[i] = LiteMath::normalize(mul(mRot, vNorm[i]));
-    vTang[i] = LiteMath::normalize(mul(mRot, vTang[i]));
+    #pragma omp for nowait
+    for(int64_t c = 0; c < chunksNum; c++)
+      points(vPos + c*CHUNK, chunkSize(c));
+
+    if(hasNorm)
+    {
+      #pragma omp for nowait
+      for(int64_t c = 0; c < chunksNum; c++)
+        directions(mNorm, vNorm + c*CHUNK, chunkSize(c), true); // zero if the matrix collapses the face to a line or a point, old normal is kept
+    }
+
+    if(hasTang)
+    {
+      #pragma omp for nowait
+      for(int64_t c = 0; c < chunksNum; c++)
+        directions(mRot, vTang + c*CHUNK, chunkSize(c), false);
+    }
   }
 }
 
@@ -18,10 +18,13 @@ namespace cmesh4
   struct Header
   {
     enum GEOM_FLAGS {
-      HAS_TANGENT    = 1,
-      UNUSED2        = 2,
-      UNUSED4        = 4,
-      HAS_NO_NORMALS = 8
+      HAS_TANGENT     = 1,
+      CONTAINER_V2    = 2,  // data after the header is a VSGF v2 container of (possibly compressed) streams, see vsgf_v2.cpp
+      QUADS           = 4,  // SimpleMesh::SIMPLE_MESH_QUADS, 4 indices and one material index per primitive
+      HAS_NO_NORMALS  = 8,
+      HAS_TEXCOORD1   = 16, // second uv set, stored after the first one
+      HAS_COLOR       = 32, // float4 per vertex colors, stored after texture coordinates
+      HAS_NO_TEXCOORD = 64
     };
 
     uint64_t fileSizeInBytes;
@@ -33,13 +36,61 @@ namespace cmesh4
 
   Header LoadHeader(std::istream &str);
 
+  struct MappedFile;
+
+  // geometric statistics of a triangle mesh gathered by SimpleMesh::ComputeStats() in a single parallel pass
+  //
+  struct MeshStats
+  {
+    LiteMath::Box4f aabb;                     ///< of all vertices, not only referenced ones
+    double   totalArea           = 0.0;
+    double   totalPerimeter      = 0.0;
+    float    avgTriArea          = 0.0f;        ///< averages are over triangles with all indices in range
+    float    avgTriPerimeter     = 0.0f;
+    uint64_t degenerateTriangles = 0;         ///< zero area triangles, including ones with repeated indices
+    uint64_t noMaterialTriangles = 0;         ///< triangles with material id equal to uint32_t(-1)
+    uint64_t badMaterialTriangles = 0;        ///< triangles with other material id >= MAX_MATERIALS, most likely garbage
+    std::vector<uint32_t> trianglesPerMaterial; ///< index is material id
+
+    static constexpr uint32_t MAX_MATERIALS = 1u << 20; ///< limits trianglesPerMaterial, so a garbage id can't allocate gigabytes
+  };
+
+  // contiguous range of triangles with the same material, allows one draw call per material instead of per primitive material lookup
+  //
+  struct MaterialRange
+  {
+    uint32_t matId;
+    uint32_t firstIndex; ///< offset in SimpleMesh::indices, multiple of SimpleMesh::PointsInPrimitive()
+    uint32_t indexCount;
+  };
+
   // very simple utility mesh representation for working with geometry on the CPU in C++
   //
   struct SimpleMesh
   {
     static const uint64_t POINTS_IN_TRIANGLE = 3;
+    static const uint64_t POINTS_IN_QUAD     = 4;
+
+    // quads keep topology for tessellation and take 4 indices instead of 6; functions that work on triangles only
+    // triangulate them when needed (see Triangulate() and AsTriangles())
+    //
+    enum SIMPLE_MESH_TOPOLOGY {SIMPLE_MESH_TRIANGLES = 0, SIMPLE_MESH_QUADS = 1};
+
+    // optional vertex channels; positions are always present. Absent channel has empty vector and costs no memory
+    //
+    enum ATTRIBUTES
+    {
+      ATTR_NORMAL    = 1,
+      ATTR_TANGENT   = 2,
+      ATTR_TEXCOORD  = 4,
+      ATTR_TEXCOORD1 = 8,
+      ATTR_COLOR     = 16,
+      ATTR_DEFAULT   = ATTR_NORMAL | ATTR_TANGENT | ATTR_TEXCOORD,
+      ATTR_ALL       = ATTR_DEFAULT | ATTR_TEXCOORD1 | ATTR_COLOR,
+    };
+
     SimpleMesh(){}
-    SimpleMesh(size_t a_vertNum, size_t a_indNum) { Resize(a_vertNum, a_indNum); }
+    SimpleMesh(size_t a_vertNum, size_t a_indNum, uint32_t a_attribs = ATTR_DEFAULT, SIMPLE_MESH_TOPOLOGY a_topology = SIMPLE_MESH_TRIANGLES) : topology(a_topology) { Resize(a_vertNum, a_indNum, a_attribs); }
     SimpleMesh(const SimpleMesh &other) = default;
     SimpleMesh(SimpleMesh &&other) = default;
     SimpleMesh &operator=(const SimpleMesh &other) = default;
@@ -47,16 +98,21 @@ namespace cmesh4
 
     inline size_t VerticesNum()  const { return vPos4f.size(); }
     inline size_t IndicesNum()   const { return indices.size();  }
-    inline size_t TrianglesNum() const { return IndicesNum() / POINTS_IN_TRIANGLE;  }
-    inline void   Resize(size_t a_vertNum, size_t a_indNum)
+    inline size_t PointsInPrimitive() const { return (topology == SIMPLE_MESH_QUADS) ? POINTS_IN_QUAD : POINTS_IN_TRIANGLE; }
+    inline size_t PrimitivesNum()     const { return IndicesNum() / PointsInPrimitive(); }
+    inline size_t TrianglesNum()      const { return (topology == SIMPLE_MESH_QUADS) ? 2*PrimitivesNum() : PrimitivesNum(); } ///< after triangulation
+    inline void   Resize(size_t a_vertNum, size_t a_indNum, uint32_t a_attribs = ATTR_DEFAULT) ///< for current topology; channels not in a_attribs are released
     {
+      auto resizeOrFree = [](auto& a_arr, size_t a_size) { if(a_size == 0) { a_arr.clear(); a_arr.shrink_to_fit(); } else a_arr.resize(a_size); };
       vPos4f.resize(a_vertNum);
-      vNorm4f.resize(a_vertNum);
-      vTang4f.resize(a_vertNum);
-      vTexCoord2f.resize(a_vertNum);
+      resizeOrFree(vNorm4f,       (a_attribs & ATTR_NORMAL)    ? a_vertNum : 0);
+      resizeOrFree(vTang4f,       (a_attribs & ATTR_TANGENT)   ? a_vertNum : 0);
+      resizeOrFree(vTexCoord2f,   (a_attribs & ATTR_TEXCOORD)  ? a_vertNum : 0);
+      resizeOrFree(vTexCoord2f_1, (a_attribs & ATTR_TEXCOORD1) ? a_vertNum : 0);
+      resizeOrFree(vColor4f,      (a_attribs & ATTR_COLOR)     ? a_vertNum : 0);
       indices.resize(a_indNum);
-      matIndices.resize(a_indNum/3); 
-      assert(a_indNum%3 == 0); // PLEASE NOTE THAT CURRENT IMPLEMENTATION ASSUMES ONLY TRIANGLE MESHES!
+      matIndices.resize(a_indNum/PointsInPrimitive());
+      assert(a_indNum%PointsInPrimitive() == 0);
     };
 
     inline size_t SizeInBytes() const
@@ -65,38 +121,161 @@ namespace cmesh4
              vNorm4f.size()*sizeof(float)*4 +
              vTang4f.size()*sizeof(float)*4 +
              vTexCoord2f.size()*sizeof(float)*2 +
+             vTexCoord2f_1.size()*sizeof(float)*2 +
+             vColor4f.size()*sizeof(float)*4 +
              indices.size()*sizeof(int) +
              matIndices.size()*sizeof(int);
     }
 
-    //enum SIMPLE_MESH_TOPOLOGY {SIMPLE_MESH_TRIANGLES = 0, SIMPLE_MESH_QUADS = 1};
-    //SIMPLE_MESH_TOPOLOGY topology = SIMPLE_MESH_TRIANGLES;
-//    LiteMath::Box4f GetAABB() const;
+    void            Triangulate();      ///< in parallel, every quad is split along its shorter diagonal; nothing to do for triangles
+    uint32_t        Attributes() const; ///< ATTRIBUTES mask of channels that have exactly VerticesNum() elements
+    LiteMath::Box4f GetAABB() const;
+    MeshStats       ComputeStats() const;
 
-    float GetAvgTriArea() const;
+    float GetAvgTriArea() const;      ///< use ComputeStats() if you need several values, each of these walks all triangles
     float GetAvgTriPerimeter() const;
 
-    void ApplyMatrix(const LiteMath::float4x4& m);
+    void ApplyMatrix(const LiteMath::float4x4& m); ///< in parallel, with AVX when the CPU has it; normals by the cofactor (inverse transpose) matrix
 
-    std::vector<LiteMath::float4> vPos4f;      // #TODO: put aligned allocator here
-    std::vector<LiteMath::float4> vNorm4f;     // #TODO: put aligned allocator here
-    std::vector<LiteMath::float4> vTang4f;     // #TODO: put aligned allocator here
+    std::vector<LiteMath::float4> vPos4f;      // plain AoS, see cmesh4_storage.h for aligned and SoA layouts
+    std::vector<LiteMath::float4> vNorm4f;     //
+    std::vector<LiteMath::float4> vTang4f;     //
     std::vector<float2>           vTexCoord2f; // 
-    std::vector<unsigned int>     indices;     // size = 3*TrianglesNum() for triangle mesh, 4*TrianglesNum() for quad mesh
-    std::vector<unsigned int>     matIndices;  // size = 1*TrianglesNum()
+    std::vector<float2>           vTexCoord2f_1; // second uv set (lightmaps, detail textures), usually empty
+    std::vector<LiteMath::float4> vColor4f;      // per vertex color, usually empty
+    std::vector<unsigned int>     indices;     // size = PointsInPrimitive()*PrimitivesNum()
+    std::vector<unsigned int>     matIndices;  // size = PrimitivesNum()
+    std::vector<MaterialRange>    matRanges;   // filled by SortTrianglesByMaterial(), empty if triangles are not grouped by material
+    SIMPLE_MESH_TOPOLOGY          topology = SIMPLE_MESH_TRIANGLES;
   };
 
+  // for functions that work on triangles only: a triangle mesh is returned as is, otherwise a_temp gets its triangulated copy
+  //
+  const SimpleMesh& AsTriangles(const SimpleMesh& a_mesh, SimpleMesh& a_temp);
+
+  // triangle indices and material ids of a_mesh, quads are split the same way as Triangulate() does; vertices are not copied
+  //
+  void TriangulatedIndices(const SimpleMesh& a_mesh, std::vector<unsigned int>& a_indices, std::vector<unsigned int>& a_matIndices);
+
+  // same for read-only use: arrays of a triangle mesh are referenced, quads are triangulated into own arrays
+  //
+  struct TriangleIndices
+  {
+  private:
+    std::vector<unsigned int> m_indices, m_matIndices; // constructed before the references below
+  public:
+    explicit TriangleIndices(const SimpleMesh& a_mesh);
+    TriangleIndices(const TriangleIndices&) = delete;
+    TriangleIndices& operator=(const TriangleIndices&) = delete;
+
+    inline size_t TrianglesNum() const { return indices.size()/3; }
+
+    const std::vector<unsigned int>& indices;    ///< 3 per triangle
+    const std::vector<unsigned int>& matIndices; ///< 1 per triangle, may be empty as SimpleMesh::matIndices
+  };
+
+  // read-only non-owning range of elements, used to expose mapped data without a copy
+  //
+  template<typename T>
+  struct ConstSpan
+  {
+    ConstSpan(){}
+    ConstSpan(const T* a_data, size_t a_size) : m_data(a_data), m_size(a_size) {}
+
+    inline const T* data()  const { return m_data; }
+    inline size_t   size()  const { return m_size; }
+    inline bool     empty() const { return m_size == 0; }
+    inline const T* begin() const { return m_data; }
+    inline const T* end()   const { return m_data + m_size; }
+    inline const T& operator[](size_t i) const { return m_data[i]; }
+
+  private:
+    const T* m_data = nullptr;
+    size_t   m_size = 0;
+  };
+
+  // zero-copy view of a .vsgf file mapped into memory; the mapping lives as long as any copy of the view.
+  // Float attributes are exposed as plain float arrays (4 floats per vertex for positions, normals and tangents, 2 for texture coordinates), 
+  // because inside the file they start right after the 24 byte header and thus are not aligned enough to be read as LiteMath::float4.
+  //
+  struct SimpleMeshView
+  {
+    inline size_t VerticesNum()  const { return vPos4f.size() / 4; }
+    inline size_t IndicesNum()   const { return indices.size(); }
+    inline size_t PointsInPrimitive() const { return (flags & Header::QUADS) ? SimpleMesh::POINTS_IN_QUAD : SimpleMesh::POINTS_IN_TRIANGLE; }
+    inline size_t TrianglesNum() const { return IndicesNum()/PointsInPrimitive()*((flags & Header::QUADS) ? 2 : 1); } ///< after triangulation
+    inline size_t SizeInBytes()  const 
+    { 
+      return (vPos4f.size() + vNorm4f.size() + vTang4f.size() + vTexCoord2f.size() + vTexCoord2f_1.size() + vColor4f.size())*sizeof(float) + 
+             (indices.size() + matIndices.size())*sizeof(unsigned int); 
+    }
+
+    float4 GetPos (size_t a_vertId) const;
+    float4 GetNorm(size_t a_vertId) const; ///< zero if the file has no normals
+    float4 GetTang(size_t a_vertId) const; ///< zero if the file has no tangents
+    float2 GetTexCoord(size_t a_vertId) const; ///< zero if the file has no texture coordinates
+
+    SimpleMesh ToSimpleMesh() const;   ///< makes a regular (owning) copy of the mesh
+
+    ConstSpan<float>        vPos4f;
+    ConstSpan<float>        vNorm4f;     // empty if file has no normals
+    ConstSpan<float>        vTang4f;     // empty if file has no tangents
+    ConstSpan<float>        vTexCoord2f;   // empty if file has no texture coordinates
+    ConstSpan<float>        vTexCoord2f_1; // empty if file has no second uv set
+    ConstSpan<float>        vColor4f;      // empty if file has no colors
+    ConstSpan<unsigned int> indices;
+    ConstSpan<unsigned int> matIndices;
+    uint32_t                flags = 0;   // Header::GEOM_FLAGS of the file
+
+    std::shared_ptr<const MappedFile> file; // keeps the mapping alive
+  };
+
+  void TriangulatedIndices(const SimpleMeshView& a_mesh, std::vector<unsigned int>& a_indices, std::vector<unsigned int>& a_matIndices); ///< same for mapped files
+
 #if defined(__ANDROID__)
   SimpleMesh LoadMeshFromVSGF(AAssetManager* mgr, const char* a_fileName);
 #else
   SimpleMesh LoadMeshFromVSGF(const char* a_fileName);
+  SimpleMeshView LoadMeshViewFromVSGF(const char* a_fileName); ///< maps file to memory instead of reading it; returns empty view on error
 #endif
-  void       SaveMeshToVSGF  (const char* a_fileName, const SimpleMesh& a_mesh);
+  bool       SaveMeshToVSGF  (const char* a_fileName, const SimpleMesh& a_mesh); ///< only channels present in a_mesh.Attributes() are written; false if writing failed
+
+  uint32_t   AttributesFromVSGFFlags(uint32_t a_flags);   ///< Header::GEOM_FLAGS -> SimpleMesh::ATTRIBUTES of channels stored in file
+  uint32_t   VSGFFlagsFromAttributes(uint32_t a_attribs); ///< SimpleMesh::ATTRIBUTES -> Header::GEOM_FLAGS
+  SimpleMesh::SIMPLE_MESH_TOPOLOGY TopologyFromVSGFFlags(uint32_t a_flags);
+  uint32_t   VSGFFlagsFromTopology(SimpleMesh::SIMPLE_MESH_TOPOLOGY a_topology);
+
+  // settings for VSGF v2 files; defaults give several times smaller files at the cost of 16 bit precision for positions and normals
+  //
+  struct VSGFSaveOptions
+  {
+    bool quantizePositions = true; ///< 16 bit per component relative to the mesh bounding box (lossy)
+    bool octNormals        = true; ///< normals and tangents as octahedral 2 x snorm16 (lossy)
+    bool useDeflate        = true; ///< compress every stream with miniz; ignored if built with DISABLE_VSGF_DEFLATE
+    int  deflateLevel      = 6;
+  };
+
+  bool       SaveMeshToVSGF  (const char* a_fileName, const SimpleMesh& a_mesh, const VSGFSaveOptions& a_options); ///< writes VSGF v2 container, LoadMeshFromVSGF reads both versions
+  bool       LoadVSGFSaveOptions(const char* a_fileName, VSGFSaveOptions* a_pOptions); ///< encodings used by an existing v2 file; false for v1 or unreadable files
   SimpleMesh LoadMeshViaAssimp(const char* a_fileName);
 
-  SimpleMesh CreateQuad(const int a_sizeX, const int a_sizeY, const float a_size);
+  SimpleMesh CreateQuad(const int a_sizeX, const int a_sizeY, const float a_size, SimpleMesh::SIMPLE_MESH_TOPOLOGY a_topology = SimpleMesh::SIMPLE_MESH_TRIANGLES);
+
+  // vertices are merged if their positions are closer than posEps and normals and texture coordinates differ by 
+  // no more than normEps and uvEps per component; posEps = 0 merges only bitwise equal positions; colors and tangent handedness
+  // (vTang4f.w) must match exactly; vertices with NaN or infinite coordinates are never merged
+  //
+  struct WeldOptions
+  {
+    float posEps           = 1e-6f;
+    float normEps          = 1e-3f;
+    float uvEps            = 1e-5f;
+    bool  compareNormals   = true;
+    bool  compareTexCoords = true;
+  };
 
-  void WeldVertices(SimpleMesh& mesh, int indexNum);
+  size_t WeldVertices(SimpleMesh& mesh, const WeldOptions& a_options); ///< merges duplicate vertices in parallel, remaps indices; returns new vertex count
+  void   WeldVertices(SimpleMesh& mesh, int indexNum);                 ///< same with default options; indexNum is ignored, all indices are remapped
 };
 
 
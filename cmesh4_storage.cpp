@@ -0,0 +1,195 @@
+#include "cmesh4_storage.h"
+
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(_WIN32)
+  #include <malloc.h>
+#elif defined(__linux__)
+  #include <sys/mman.h>
+#endif
+
+namespace cmesh4
+{
+  static constexpr size_t HUGE_PAGE_SIZE = size_t(2)*1024*1024;
+};
+
+void* cmesh4::AlignedAlloc(size_t a_size, size_t a_align, bool a_hugePages)
+{
+  const bool useHugePages = a_hugePages && a_size >= HUGE_PAGE_SIZE;
+  if(useHugePages)
+  {
+    a_align = std::max(a_align, HUGE_PAGE_SIZE);
+    a_size  = (a_size + HUGE_PAGE_SIZE - 1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE;
+  }
+  a_size = std::max(a_size, a_align);
+
+#if defined(_WIN32)
+  void* ptr = _aligned_malloc(a_size, a_align);
+#else
+  void* ptr = nullptr;
+  if(posix_memalign(&ptr, a_align, a_size) != 0)
+    ptr = nullptr;
+#endif
+
+  if(ptr == nullptr)
+    throw std::bad_alloc();
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if(useHugePages)
+    madvise(ptr, a_size, MADV_HUGEPAGE); // just a hint, regular pages are fine if it fails
+#endif
+
+  return ptr;
+}
+
+void cmesh4::AlignedFree(void* a_ptr)
+{
+#if defined(_WIN32)
+  _aligned_free(a_ptr);
+#else
+  free(a_ptr);
+#endif
+}
+
+template<template<typename> class Vector>
+void cmesh4::ToSoA(const SimpleMesh& a_mesh, PositionsSoAT<Vector>& a_pos)
+{
+  a_pos.resize(a_mesh.VerticesNum());
+
+  const float4* pos = a_mesh.vPos4f.data();
+  float* x = a_pos.x.data();
+  float* y = a_pos.y.data();
+  float* z = a_pos.z.data();
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < int64_t(a_pos.size()); i++)
+  {
+    x[i] = pos[i].x;
+    y[i] = pos[i].y;
+    z[i] = pos[i].z;
+  }
+}
+
+template<template<typename> class Vector>
+void cmesh4::MoveToSoA(SimpleMesh& a_mesh, PositionsSoAT<Vector>& a_pos)
+{
+  ToSoA(a_mesh, a_pos);
+  std::vector<float4>().swap(a_mesh.vPos4f);
+}
+
+template<template<typename> class Vector>
+void cmesh4::FromSoA(const PositionsSoAT<Vector>& a_pos, SimpleMesh& a_mesh)
+{
+  if(a_mesh.vPos4f.size() != a_pos.size())
+    a_mesh.vPos4f.resize(a_pos.size());
+
+  float4* pos = a_mesh.vPos4f.data();
+  const float* x = a_pos.x.data();
+  const float* y = a_pos.y.data();
+  const float* z = a_pos.z.data();
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < int64_t(a_pos.size()); i++)
+    pos[i] = float4(x[i], y[i], z[i], 1.0f);
+}
+
+template<template<typename> class Vector>
+LiteMath::Box4f cmesh4::GetAABB(const PositionsSoAT<Vector>& a_pos)
+{
+  LiteMath::Box4f res;
+  const float* x = a_pos.x.data();
+  const float* y = a_pos.y.data();
+  const float* z = a_pos.z.data();
+  const int64_t count = int64_t(a_pos.size());
+
+  #pragma omp parallel
+  {
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+
+    #pragma omp for nowait
+    for(int64_t i = 0; i < count; i++)
+    {
+      minX = std::min(minX, x[i]); maxX = std::max(maxX, x[i]);
+      minY = std::min(minY, y[i]); maxY = std::max(maxY, y[i]);
+      minZ = std::min(minZ, z[i]); maxZ = std::max(maxZ, z[i]);
+    }
+
+    #pragma omp critical
+    res.include(LiteMath::Box4f(float4(minX, minY, minZ, 1.0f), float4(maxX, maxY, maxZ, 1.0f)));
+  }
+
+  return res;
+}
+
+template<template<typename> class Vector>
+void cmesh4::ApplyMatrix(PositionsSoAT<Vector>& a_pos, const LiteMath::float4x4& m)
+{
+  const float4 r0 = m.get_row(0);
+  const float4 r1 = m.get_row(1);
+  const float4 r2 = m.get_row(2);
+
+  float* x = a_pos.x.data();
+  float* y = a_pos.y.data();
+  float* z = a_pos.z.data();
+  const int64_t paddedCount = int64_t(a_pos.x.size()); // padding is transformed too, so the loop has no scalar tail
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < paddedCount; i++)
+  {
+    const float px = x[i], py = y[i], pz = z[i];
+    x[i] = r0.x*px + r0.y*py + r0.z*pz + r0.w;
+    y[i] = r1.x*px + r1.y*py + r1.z*pz + r1.w;
+    z[i] = r2.x*px + r2.y*py + r2.z*pz + r2.w;
+  }
+}
+
+template<template<typename> class Vector>
+float cmesh4::GetAvgTriArea(const PositionsSoAT<Vector>& a_pos, const std::vector<unsigned int>& a_indices)
+{
+  const int64_t trianglesNum = int64_t(a_indices.size()/3);
+  const size_t  vertNum      = a_pos.size();
+
+  const float* x = a_pos.x.data();
+  const float* y = a_pos.y.data();
+  const float* z = a_pos.z.data();
+  const unsigned int* ind = a_indices.data();
+
+  double  sum   = 0.0;
+  int64_t valid = 0;
+  #pragma omp parallel for reduction(+:sum,valid)
+  for(int64_t i = 0; i < trianglesNum; i++)
+  {
+    const unsigned int a = ind[i*3+0], b = ind[i*3+1], c = ind[i*3+2];
+    if(a >= vertNum || b >= vertNum || c >= vertNum)
+      continue;
+    const float e1x = x[b] - x[a], e1y = y[b] - y[a], e1z = z[b] - z[a];
+    const float e2x = x[c] - x[a], e2y = y[c] - y[a], e2z = z[c] - z[a];
+    const float cx = e1y*e2z - e1z*e2y;
+    const float cy = e1z*e2x - e1x*e2z;
+    const float cz = e1x*e2y - e1y*e2x;
+    sum += 0.5*std::sqrt(double(cx*cx + cy*cy + cz*cz));
+    valid++;
+  }
+
+  return (valid > 0) ? float(sum/double(valid)) : 0.0f;
+}
+
+namespace cmesh4
+{
+  template void            ToSoA        <AlignedVector> (const SimpleMesh&, PositionsSoAT<AlignedVector>&);
+  template void            ToSoA        <HugePageVector>(const SimpleMesh&, PositionsSoAT<HugePageVector>&);
+  template void            MoveToSoA    <AlignedVector> (SimpleMesh&, PositionsSoAT<AlignedVector>&);
+  template void            MoveToSoA    <HugePageVector>(SimpleMesh&, PositionsSoAT<HugePageVector>&);
+  template void            FromSoA      <AlignedVector> (const PositionsSoAT<AlignedVector>&, SimpleMesh&);
+  template void            FromSoA      <HugePageVector>(const PositionsSoAT<HugePageVector>&, SimpleMesh&);
+  template LiteMath::Box4f GetAABB      <AlignedVector> (const PositionsSoAT<AlignedVector>&);
+  template LiteMath::Box4f GetAABB      <HugePageVector>(const PositionsSoAT<HugePageVector>&);
+  template void            ApplyMatrix  <AlignedVector> (PositionsSoAT<AlignedVector>&, const LiteMath::float4x4&);
+  template void            ApplyMatrix  <HugePageVector>(PositionsSoAT<HugePageVector>&, const LiteMath::float4x4&);
+  template float           GetAvgTriArea<AlignedVector> (const PositionsSoAT<AlignedVector>&, const std::vector<unsigned int>&);
+  template float           GetAvgTriArea<HugePageVector>(const PositionsSoAT<HugePageVector>&, const std::vector<unsigned int>&);
+};
@@ -0,0 +1,91 @@
+#ifndef LITESCENE_CMESH4_STORAGE_H_
+#define LITESCENE_CMESH4_STORAGE_H_
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "cmesh4.h"
+
+// aligned storage for heavy geometry processing on the CPU;
+// SimpleMesh itself keeps plain std::vector AoS arrays, convert to these layouts for the hot loops
+// (MoveToSoA releases the AoS positions, so a mesh processed in SoA form does not hold two copies).
+//
+namespace cmesh4
+{
+  static constexpr size_t CACHE_LINE_SIZE = 64;
+
+  void* AlignedAlloc(size_t a_size, size_t a_align, bool a_hugePages); ///< throws std::bad_alloc on failure
+  void  AlignedFree (void* a_ptr);
+
+  // STL allocator returning a_align aligned memory (a full cache line and AVX-512 register by default).
+  // If HugePages is set, large blocks (>= 2 MB) are 2 MB aligned and advised to be backed by transparent huge pages (Linux only).
+  //
+  template<typename T, size_t Align = CACHE_LINE_SIZE, bool HugePages = false>
+  struct AlignedAllocator
+  {
+    static_assert(Align >= alignof(T) && (Align & (Align - 1)) == 0, "Align must be a power of 2 not less than alignof(T)");
+
+    using value_type = T;
+    template<typename U> struct rebind { using other = AlignedAllocator<U, Align, HugePages>; };
+
+    AlignedAllocator() noexcept {}
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Align, HugePages>&) noexcept {}
+
+    T*   allocate  (size_t n)    { return static_cast<T*>(AlignedAlloc(n*sizeof(T), Align, HugePages)); }
+    void deallocate(T* p, size_t) noexcept { AlignedFree(p); }
+
+    template<typename U> bool operator==(const AlignedAllocator<U, Align, HugePages>&) const noexcept { return true; }
+    template<typename U> bool operator!=(const AlignedAllocator<U, Align, HugePages>&) const noexcept { return false; }
+  };
+
+  template<typename T> using AlignedVector  = std::vector<T, AlignedAllocator<T> >;
+  template<typename T> using HugePageVector = std::vector<T, AlignedAllocator<T, CACHE_LINE_SIZE, true> >;
+
+  // SoA position layout: each coordinate is a separate aligned array, so kernels load 8 or 16 vertices with a single aligned load.
+  // Vector is the storage policy (AlignedVector or HugePageVector). Arrays are padded to a whole cache line, 
+  // so per-vertex kernels may process the tail with full-width operations; only first size() elements are valid.
+  //
+  template<template<typename> class Vector>
+  struct PositionsSoAT
+  {
+    static constexpr size_t SOA_PADDING = CACHE_LINE_SIZE/sizeof(float);
+
+    inline size_t size() const { return count; }
+    inline void   resize(size_t a_size)
+    {
+      const size_t padded = (a_size + SOA_PADDING - 1)/SOA_PADDING*SOA_PADDING;
+      x.resize(padded);
+      y.resize(padded);
+      z.resize(padded);
+      count = a_size;
+    }
+
+    inline float4 get(size_t i) const { return float4(x[i], y[i], z[i], 1.0f); }
+
+    Vector<float> x;
+    Vector<float> y;
+    Vector<float> z;
+    size_t count = 0;
+  };
+
+  using PositionsSoA         = PositionsSoAT<AlignedVector>;
+  using PositionsSoAHugePage = PositionsSoAT<HugePageVector>;
+
+  // conversions and kernels are instantiated for both storage policies in cmesh4_storage.cpp
+  //
+  template<template<typename> class Vector> void ToSoA    (const SimpleMesh& a_mesh, PositionsSoAT<Vector>& a_pos);
+  template<template<typename> class Vector> void MoveToSoA(SimpleMesh& a_mesh, PositionsSoAT<Vector>& a_pos); ///< as ToSoA, then releases a_mesh.vPos4f, so positions are not kept twice
+  template<template<typename> class Vector> void FromSoA  (const PositionsSoAT<Vector>& a_pos, SimpleMesh& a_mesh); ///< writes positions back to a_mesh.vPos4f (w = 1), resizes it if needed
+
+  inline PositionsSoA ToSoA(const SimpleMesh& a_mesh) { PositionsSoA res; ToSoA(a_mesh, res); return res; }
+
+  // kernels for SoA positions, written to be vectorized by compiler with aligned loads and split between OpenMP threads
+  //
+  template<template<typename> class Vector> LiteMath::Box4f GetAABB    (const PositionsSoAT<Vector>& a_pos);
+  template<template<typename> class Vector> void            ApplyMatrix(PositionsSoAT<Vector>& a_pos, const LiteMath::float4x4& m);
+  template<template<typename> class Vector> float           GetAvgTriArea(const PositionsSoAT<Vector>& a_pos, const std::vector<unsigned int>& a_indices); ///< triangles with out of range indices are skipped
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+  #ifndef NOMINMAX
+  #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+cmesh4::MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+  *this = std::move(other);
+}
+
+cmesh4::MappedFile& cmesh4::MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if(this == &other)
+    return *this;
+
+  Close();
+  std::swap(m_data, other.m_data);
+  std::swap(m_size, other.m_size);
+#if defined(_WIN32)
+  std::swap(m_file,    other.m_file);
+  std::swap(m_mapping, other.m_mapping);
+#endif
+  return *this;
+}
+
+#if defined(_WIN32)
+
+bool cmesh4::MappedFile::Open(const char* a_fileName)
+{
+  Close();
+
+  HANDLE file = CreateFileA(a_fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(mapping == nullptr)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(data == nullptr)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  m_file    = file;
+  m_mapping = mapping;
+  m_data    = (const uint8_t*)data;
+  m_size    = size_t(size.QuadPart);
+  return true;
+}
+
+void cmesh4::MappedFile::Close()
+{
+  if(m_data != nullptr)
+    UnmapViewOfFile(m_data);
+  if(m_mapping != nullptr)
+    CloseHandle((HANDLE)m_mapping);
+  if(m_file != nullptr)
+    CloseHandle((HANDLE)m_file);
+  m_data    = nullptr;
+  m_size    = 0;
+  m_mapping = nullptr;
+  m_file    = nullptr;
+}
+
+#else
+
+bool cmesh4::MappedFile::Open(const char* a_fileName)
+{
+  Close();
+
+  int fd = open(a_fileName, O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps its own reference to the file
+  if(data == MAP_FAILED)
+    return false;
+
+  m_data = (const uint8_t*)data;
+  m_size = size_t(st.st_size);
+  return true;
+}
+
+void cmesh4::MappedFile::Close()
+{
+  if(m_data != nullptr)
+    munmap((void*)m_data, m_size);
+  m_data = nullptr;
+  m_size = 0;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef LITESCENE_MAPPED_FILE_H_
+#define LITESCENE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cmesh4
+{
+  // read-only memory mapping of the whole file; pages are shared with the OS page cache,
+  // so several processes mapping the same file do not duplicate it in memory
+  //
+  struct MappedFile
+  {
+    MappedFile() = default;
+    explicit MappedFile(const char* a_fileName) { Open(a_fileName); }
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool Open(const char* a_fileName);
+    void Close();
+
+    inline bool           IsOpen() const { return m_data != nullptr; }
+    inline const uint8_t* Data()   const { return m_data; }
+    inline size_t         Size()   const { return m_size; }
+
+  private:
+    const uint8_t* m_data = nullptr;
+    size_t         m_size = 0;
+#if defined(_WIN32)
+    void* m_file    = nullptr;
+    void* m_mapping = nullptr;
+#endif
+  };
+};
+
+#endif
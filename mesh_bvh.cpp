@@ -0,0 +1,507 @@
+#include "mesh_bvh.h"
+
+#include <cstdio>
+#include <cfloat>
+#include <fstream>
+#include <algorithm>
+
+namespace cmesh4
+{
+  using LiteMath::float3;
+
+  static constexpr uint32_t BVH_FILE_MAGIC     = 0x32485642; // "BVH2"
+  static constexpr uint32_t BVH_FILE_VERSION   = 1;
+  static constexpr uint32_t BVH_MAX_BINS       = 64;
+  static constexpr size_t   BVH_PARALLEL_PRIMS = 16384;      // nodes with more primitives are binned by all threads
+
+  struct BVHFileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t nodesNum;
+    uint64_t primIndicesNum;
+  };
+
+  struct BuildBox
+  {
+    float3 boxMin = float3(+FLT_MAX);
+    float3 boxMax = float3(-FLT_MAX);
+
+    inline void  Include(const float3& p)    { boxMin = LiteMath::min(boxMin, p); boxMax = LiteMath::max(boxMax, p); }
+    inline void  Include(const BuildBox& b)  { boxMin = LiteMath::min(boxMin, b.boxMin); boxMax = LiteMath::max(boxMax, b.boxMax); }
+    inline float HalfArea() const
+    {
+      const float3 d = boxMax - boxMin;
+      return (d.x < 0.0f) ? 0.0f : d.x*d.y + d.y*d.z + d.z*d.x;
+    }
+  };
+
+  struct BuildContext
+  {
+    std::vector<BuildBox> boxes;     // per primitive
+    std::vector<float3>   centroids; // per primitive
+    std::vector<uint32_t> refs;      // becomes BVHTree::primIndices
+    BVHBuildOptions       options;
+  };
+
+  struct BuildTask
+  {
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  struct RangeBounds
+  {
+    BuildBox box;
+    BuildBox centroids;
+
+    inline void Merge(const RangeBounds& other) { box.Include(other.box); centroids.Include(other.centroids); }
+  };
+
+  struct Bins
+  {
+    BuildBox box[3][BVH_MAX_BINS];
+    uint32_t count[3][BVH_MAX_BINS] = {};
+
+    inline void Merge(const Bins& other)
+    {
+      for(int axis = 0; axis < 3; axis++)
+      {
+        for(uint32_t b = 0; b < BVH_MAX_BINS; b++)
+        {
+          box[axis][b].Include(other.box[axis][b]);
+          count[axis][b] += other.count[axis][b];
+        }
+      }
+    }
+  };
+
+  static inline uint32_t BinOf(float a_centroid, float a_min, float a_scale, uint32_t a_binsNum)
+  {
+    const int64_t bin = int64_t((a_centroid - a_min)*a_scale);
+    return uint32_t(std::min<int64_t>(std::max<int64_t>(bin, 0), a_binsNum - 1));
+  }
+
+  static RangeBounds ComputeBounds(const BuildContext& a_ctx, uint32_t a_begin, uint32_t a_end)
+  {
+    RangeBounds res;
+    for(uint32_t i = a_begin; i < a_end; i++)
+    {
+      const uint32_t prim = a_ctx.refs[i];
+      res.box.Include(a_ctx.boxes[prim]);
+      res.centroids.Include(a_ctx.centroids[prim]);
+    }
+    return res;
+  }
+
+  static void FillBins(const BuildContext& a_ctx, uint32_t a_begin, uint32_t a_end, const BuildBox& a_centroids, const float3& a_scale, uint32_t a_binsNum, Bins& a_bins)
+  {
+    for(uint32_t i = a_begin; i < a_end; i++)
+    {
+      const uint32_t prim = a_ctx.refs[i];
+      const float3&  c    = a_ctx.centroids[prim];
+      for(int axis = 0; axis < 3; axis++)
+      {
+        const uint32_t bin = BinOf(c[axis], a_centroids.boxMin[axis], a_scale[axis], a_binsNum);
+        a_bins.box[axis][bin].Include(a_ctx.boxes[prim]);
+        a_bins.count[axis][bin]++;
+      }
+    }
+  }
+
+  // processes one node: computes its box and either makes it a leaf (returns 0) or partitions refs and returns split position
+  //
+  static uint32_t ProcessTask(BuildContext& a_ctx, const BuildTask& a_task, BVHNode& a_node, bool a_parallel)
+  {
+    const uint32_t begin = a_task.begin, end = a_task.end, count = end - begin;
+
+    RangeBounds bounds;
+    if(a_parallel)
+    {
+      #pragma omp parallel
+      {
+        RangeBounds local;
+        #pragma omp for nowait
+        for(int64_t i = begin; i < int64_t(end); i += 4096)
+          local.Merge(ComputeBounds(a_ctx, uint32_t(i), uint32_t(std::min<int64_t>(i + 4096, end))));
+        #pragma omp critical
+        bounds.Merge(local);
+      }
+    }
+    else
+      bounds = ComputeBounds(a_ctx, begin, end);
+
+    for(int k = 0; k < 3; k++)
+    {
+      a_node.boxMin[k] = bounds.box.boxMin[k];
+      a_node.boxMax[k] = bounds.box.boxMax[k];
+    }
+    a_node.leftOrFirst = begin;
+    a_node.primCount   = count;
+
+    if(count <= 1)
+      return 0;
+
+    // (1) SAH over bins of all three axes
+    //
+    const uint32_t binsNum = std::min(std::max(a_ctx.options.binsNum, 2u), BVH_MAX_BINS);
+    const float3   extent  = bounds.centroids.boxMax - bounds.centroids.boxMin;
+    float3 scale;
+    for(int axis = 0; axis < 3; axis++)
+      scale[axis] = (extent[axis] > 0.0f) ? float(binsNum)/extent[axis] : 0.0f;
+
+    Bins bins;
+    if(a_parallel)
+    {
+      #pragma omp parallel
+      {
+        Bins local;
+        #pragma omp for nowait
+        for(int64_t i = begin; i < int64_t(end); i += 4096)
+          FillBins(a_ctx, uint32_t(i), uint32_t(std::min<int64_t>(i + 4096, end)), bounds.centroids, scale, binsNum, local);
+        #pragma omp critical
+        bins.Merge(local);
+      }
+    }
+    else
+      FillBins(a_ctx, begin, end, bounds.centroids, scale, binsNum, bins);
+
+    const float parentArea = std::max(bounds.box.HalfArea(), FLT_MIN);
+    float    bestCost = FLT_MAX;
+    int      bestAxis = -1;
+    uint32_t bestBin  = 0;
+
+    for(int axis = 0; axis < 3; axis++)
+    {
+      if(!(extent[axis] > 0.0f))
+        continue;
+
+      float    rightArea[BVH_MAX_BINS];
+      uint32_t rightCount[BVH_MAX_BINS];
+      BuildBox right;
+      uint32_t rightNum = 0;
+      for(uint32_t b = binsNum - 1; b > 0; b--)
+      {
+        right.Include(bins.box[axis][b]);
+        rightNum += bins.count[axis][b];
+        rightArea[b]  = right.HalfArea();
+        rightCount[b] = rightNum;
+      }
+
+      BuildBox left;
+      uint32_t leftNum = 0;
+      for(uint32_t b = 1; b < binsNum; b++) // split between bins b-1 and b
+      {
+        left.Include(bins.box[axis][b - 1]);
+        leftNum += bins.count[axis][b - 1];
+        if(leftNum == 0 || rightCount[b] == 0)
+          continue;
+        const float cost = a_ctx.options.traversalCost + (left.HalfArea()*float(leftNum) + rightArea[b]*float(rightCount[b]))/parentArea;
+        if(cost < bestCost)
+        {
+          bestCost = cost;
+          bestAxis = axis;
+          bestBin  = b;
+        }
+      }
+    }
+
+    const uint32_t maxLeafSize = std::max(a_ctx.options.maxLeafSize, 1u);
+    if(count <= maxLeafSize && float(count) <= bestCost)
+      return 0;
+
+    // (2) partition; coincident centroids or float round-off can leave one side empty, then median is used
+    //
+    uint32_t* refs = a_ctx.refs.data();
+    uint32_t  mid  = begin;
+    if(bestAxis >= 0)
+    {
+      const float minC = bounds.centroids.boxMin[bestAxis], scaleC = scale[bestAxis];
+      mid = uint32_t(std::partition(refs + begin, refs + end, [&](uint32_t prim) {
+        return BinOf(a_ctx.centroids[prim][bestAxis], minC, scaleC, binsNum) < bestBin;
+      }) - refs);
+    }
+
+    if(mid == begin || mid == end)
+    {
+      int axis = 0;
+      if(extent.y > extent[axis]) axis = 1;
+      if(extent.z > extent[axis]) axis = 2;
+      mid = begin + count/2;
+      std::nth_element(refs + begin, refs + mid, refs + end, [&](uint32_t a, uint32_t b) {
+        return a_ctx.centroids[a][axis] < a_ctx.centroids[b][axis];
+      });
+    }
+
+    return mid;
+  }
+
+  static BVHTree BuildFromContext(BuildContext& a_ctx)
+  {
+    BVHTree res;
+    const uint32_t primsNum = uint32_t(a_ctx.refs.size());
+    if(primsNum == 0)
+      return res;
+
+    res.nodes.reserve(size_t(primsNum)*2);
+    res.nodes.resize(1);
+
+    // breadth-first, one level at a time, so that node storage is not reallocated while threads write to it
+    //
+    std::vector<BuildTask> tasks = { {0, 0, primsNum} };
+    std::vector<BuildTask> next;
+    std::vector<uint32_t>  mids;
+
+    while(!tasks.empty())
+    {
+      mids.assign(tasks.size(), 0);
+
+      for(size_t i = 0; i < tasks.size(); i++)
+        if(tasks[i].end - tasks[i].begin >= BVH_PARALLEL_PRIMS)
+          mids[i] = ProcessTask(a_ctx, tasks[i], res.nodes[tasks[i].node], true);
+
+      #pragma omp parallel for schedule(dynamic)
+      for(int64_t i = 0; i < int64_t(tasks.size()); i++)
+        if(tasks[i].end - tasks[i].begin < BVH_PARALLEL_PRIMS)
+          mids[i] = ProcessTask(a_ctx, tasks[i], res.nodes[tasks[i].node], false);
+
+      next.clear();
+      for(size_t i = 0; i < tasks.size(); i++)
+      {
+        if(mids[i] == 0)
+          continue;
+        const uint32_t left = uint32_t(res.nodes.size());
+        res.nodes[tasks[i].node].leftOrFirst = left;
+        res.nodes[tasks[i].node].primCount   = 0;
+        res.nodes.resize(res.nodes.size() + 2);
+        next.push_back({left,     tasks[i].begin, mids[i]});
+        next.push_back({left + 1, mids[i],        tasks[i].end});
+      }
+      tasks.swap(next);
+    }
+
+    res.nodes.shrink_to_fit();
+    res.primIndices = std::move(a_ctx.refs);
+    return res;
+  }
+
+  static inline float NodeHalfArea(const BVHNode& a_node)
+  {
+    const float dx = a_node.boxMax[0] - a_node.boxMin[0], dy = a_node.boxMax[1] - a_node.boxMin[1], dz = a_node.boxMax[2] - a_node.boxMin[2];
+    return dx*dy + dy*dz + dz*dx;
+  }
+
+  template<uint32_t Width>
+  static BVHWideTree<Width> CollapseBVH(const BVHTree& a_bvh)
+  {
+    BVHWideTree<Width> res;
+    if(a_bvh.nodes.empty())
+      return res;
+    res.primIndices = a_bvh.primIndices;
+
+    std::vector<uint32_t> queue = {0}; // binary node for every wide node
+    for(size_t q = 0; q < queue.size(); q++)
+    {
+      const BVHNode& root = a_bvh.nodes[queue[q]];
+
+      uint32_t children[Width];
+      uint32_t childrenNum = 0;
+      if(root.IsLeaf())
+        children[childrenNum++] = queue[q];
+      else
+      {
+        children[childrenNum++] = root.leftOrFirst;
+        children[childrenNum++] = root.leftOrFirst + 1;
+      }
+
+      while(childrenNum < Width)
+      {
+        int   best     = -1;
+        float bestArea = -1.0f;
+        for(uint32_t i = 0; i < childrenNum; i++)
+        {
+          const BVHNode& child = a_bvh.nodes[children[i]];
+          if(!child.IsLeaf() && NodeHalfArea(child) > bestArea)
+          {
+            bestArea = NodeHalfArea(child);
+            best     = int(i);
+          }
+        }
+        if(best < 0)
+          break;
+        const uint32_t left = a_bvh.nodes[children[best]].leftOrFirst;
+        children[best]          = left;
+        children[childrenNum++] = left + 1;
+      }
+
+      BVHWideNode<Width> node;
+      for(uint32_t i = 0; i < Width; i++)
+      {
+        if(i >= childrenNum)
+        {
+          node.boxMinX[i] = node.boxMinY[i] = node.boxMinZ[i] = +FLT_MAX;
+          node.boxMaxX[i] = node.boxMaxY[i] = node.boxMaxZ[i] = -FLT_MAX;
+          node.child[i]     = BVH_EMPTY_CHILD;
+          node.primCount[i] = 0;
+          continue;
+        }
+
+        const BVHNode& child = a_bvh.nodes[children[i]];
+        node.boxMinX[i] = child.boxMin[0]; node.boxMinY[i] = child.boxMin[1]; node.boxMinZ[i] = child.boxMin[2];
+        node.boxMaxX[i] = child.boxMax[0]; node.boxMaxY[i] = child.boxMax[1]; node.boxMaxZ[i] = child.boxMax[2];
+        if(child.IsLeaf())
+        {
+          node.child[i]     = child.leftOrFirst;
+          node.primCount[i] = child.primCount;
+        }
+        else
+        {
+          node.child[i]     = uint32_t(queue.size());
+          node.primCount[i] = 0;
+          queue.push_back(children[i]);
+        }
+      }
+      res.nodes.push_back(node);
+    }
+
+    return res;
+  }
+};
+
+cmesh4::BVHTree cmesh4::BuildBVH(const SimpleMesh& a_mesh, const BVHBuildOptions& a_options)
+{
+  const TriangleIndices tris(a_mesh);
+  const size_t trisNum = tris.TrianglesNum();
+  const size_t vertNum = a_mesh.VerticesNum();
+
+  BuildContext ctx;
+  ctx.options = a_options;
+  ctx.boxes.resize(trisNum);
+  ctx.centroids.resize(trisNum);
+
+  std::vector<uint8_t> valid(trisNum, 0);
+
+  #pragma omp parallel for
+  for(int64_t t = 0; t < int64_t(trisNum); t++)
+  {
+    const unsigned int* tri = tris.indices.data() + t*3;
+    if(tri[0] >= vertNum || tri[1] >= vertNum || tri[2] >= vertNum)
+      continue;
+    BuildBox box;
+    for(int k = 0; k < 3; k++)
+      box.Include(LiteMath::to_float3(a_mesh.vPos4f[tri[k]]));
+    ctx.boxes[t]     = box;
+    ctx.centroids[t] = (box.boxMin + box.boxMax)*0.5f;
+    valid[t]         = 1;
+  }
+
+  ctx.refs.reserve(trisNum);
+  for(size_t t = 0; t < trisNum; t++)
+    if(valid[t])
+      ctx.refs.push_back(uint32_t(t));
+
+  return BuildFromContext(ctx);
+}
+
+cmesh4::BVHTree cmesh4::BuildBVH(const LiteMath::Box4f* a_boxes, size_t a_boxesNum, const BVHBuildOptions& a_options)
+{
+  BuildContext ctx;
+  ctx.options = a_options;
+  ctx.boxes.resize(a_boxesNum);
+  ctx.centroids.resize(a_boxesNum);
+  ctx.refs.resize(a_boxesNum);
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < int64_t(a_boxesNum); i++)
+  {
+    ctx.boxes[i].boxMin = LiteMath::to_float3(a_boxes[i].boxMin);
+    ctx.boxes[i].boxMax = LiteMath::to_float3(a_boxes[i].boxMax);
+    ctx.centroids[i]    = (ctx.boxes[i].boxMin + ctx.boxes[i].boxMax)*0.5f;
+    ctx.refs[i]         = uint32_t(i);
+  }
+
+  return BuildFromContext(ctx);
+}
+
+cmesh4::BVH4Tree cmesh4::CollapseBVH4(const BVHTree& a_bvh) { return CollapseBVH<4>(a_bvh); }
+cmesh4::BVH8Tree cmesh4::CollapseBVH8(const BVHTree& a_bvh) { return CollapseBVH<8>(a_bvh); }
+
+bool cmesh4::SaveBVH(const char* a_fileName, const BVHTree& a_bvh)
+{
+  std::ofstream output(a_fileName, std::ios::binary);
+  if(!output.is_open())
+  {
+    printf("[cmesh4::SaveBVH] can't open file %s for writing\n", a_fileName);
+    return false;
+  }
+
+  BVHFileHeader header = {};
+  header.magic          = BVH_FILE_MAGIC;
+  header.version        = BVH_FILE_VERSION;
+  header.nodesNum       = a_bvh.nodes.size();
+  header.primIndicesNum = a_bvh.primIndices.size();
+
+  output.write((const char*)&header, sizeof(BVHFileHeader));
+  output.write((const char*)a_bvh.nodes.data(),       a_bvh.nodes.size()*sizeof(BVHNode));
+  output.write((const char*)a_bvh.primIndices.data(), a_bvh.primIndices.size()*sizeof(uint32_t));
+  return output.good();
+}
+
+cmesh4::BVHTree cmesh4::LoadBVH(const char* a_fileName)
+{
+  BVHTree res;
+  std::ifstream input(a_fileName, std::ios::binary);
+  if(!input.is_open())
+  {
+    printf("[cmesh4::LoadBVH] can't open file %s\n", a_fileName);
+    return res;
+  }
+
+  BVHFileHeader header = {};
+  input.read((char*)&header, sizeof(BVHFileHeader));
+  if(!input.good() || header.magic != BVH_FILE_MAGIC || header.version != BVH_FILE_VERSION)
+  {
+    printf("[cmesh4::LoadBVH] %s is not a BVH file or has unsupported version\n", a_fileName);
+    return res;
+  }
+
+  // counts come from the file, so check them against its size before allocating
+  //
+  const std::streamoff dataBegin = input.tellg();
+  input.seekg(0, std::ios::end);
+  const uint64_t dataSize = uint64_t(input.tellg() - dataBegin);
+  input.seekg(dataBegin);
+  if(header.nodesNum > dataSize/sizeof(BVHNode) || header.primIndicesNum > dataSize/sizeof(uint32_t) ||
+     header.nodesNum*sizeof(BVHNode) + header.primIndicesNum*sizeof(uint32_t) > dataSize)
+  {
+    printf("[cmesh4::LoadBVH] file %s is truncated\n", a_fileName);
+    return res;
+  }
+
+  res.nodes.resize(header.nodesNum);
+  res.primIndices.resize(header.primIndicesNum);
+  input.read((char*)res.nodes.data(),       res.nodes.size()*sizeof(BVHNode));
+  input.read((char*)res.primIndices.data(), res.primIndices.size()*sizeof(uint32_t));
+
+  if(!input.good())
+  {
+    printf("[cmesh4::LoadBVH] file %s is truncated\n", a_fileName);
+    return BVHTree();
+  }
+
+  // children are always stored after their parent, which also rules out cycles
+  //
+  for(size_t i = 0; i < res.nodes.size(); i++)
+  {
+    const BVHNode& node = res.nodes[i];
+    const bool valid = node.IsLeaf() ? uint64_t(node.leftOrFirst) + node.primCount <= res.primIndices.size()
+                                     : node.leftOrFirst > i && uint64_t(node.leftOrFirst) + 1 < res.nodes.size();
+    if(!valid)
+    {
+      printf("[cmesh4::LoadBVH] file %s has invalid node %zu\n", a_fileName, i);
+      return BVHTree();
+    }
+  }
+  return res;
+}
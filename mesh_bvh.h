@@ -0,0 +1,77 @@
+#ifndef LITESCENE_MESH_BVH_H_
+#define LITESCENE_MESH_BVH_H_
+#include "cmesh4.h"
+
+namespace cmesh4
+{
+  // binary BVH node, 32 bytes; children of an inner node are always stored next to each other
+  //
+  struct BVHNode
+  {
+    float    boxMin[3];
+    uint32_t leftOrFirst; ///< inner node: index of the left child, right one is leftOrFirst + 1; leaf: first element in BVHTree::primIndices
+    float    boxMax[3];
+    uint32_t primCount;   ///< 0 for inner nodes
+
+    inline bool IsLeaf() const { return primCount != 0; }
+  };
+
+  static_assert(sizeof(BVHNode) == 32, "BVHNode is expected to be 32 bytes");
+
+  struct BVHTree
+  {
+    std::vector<BVHNode>  nodes;       ///< nodes[0] is the root, empty for empty input
+    std::vector<uint32_t> primIndices; ///< triangle (or box) ids referenced by leaves
+  };
+
+  static constexpr uint32_t BVH_EMPTY_CHILD = 0xFFFFFFFF;
+
+  // node of BVH4/BVH8 with children boxes in SoA form, so all of them can be tested at once with SIMD;
+  // unused slots have inverted (empty) boxes and child == BVH_EMPTY_CHILD
+  //
+  template<uint32_t Width>
+  struct BVHWideNode
+  {
+    static constexpr uint32_t WIDTH = Width;
+
+    float    boxMinX[Width], boxMinY[Width], boxMinZ[Width];
+    float    boxMaxX[Width], boxMaxY[Width], boxMaxZ[Width];
+    uint32_t child[Width];     ///< inner child: node index; leaf child: first element in primIndices
+    uint32_t primCount[Width]; ///< 0 for inner children
+  };
+
+  template<uint32_t Width>
+  struct BVHWideTree
+  {
+    std::vector< BVHWideNode<Width> > nodes; ///< nodes[0] is the root
+    std::vector<uint32_t>             primIndices;
+  };
+
+  using BVH4Node = BVHWideNode<4>;
+  using BVH8Node = BVHWideNode<8>;
+  using BVH4Tree = BVHWideTree<4>;
+  using BVH8Tree = BVHWideTree<8>;
+
+  struct BVHBuildOptions
+  {
+    uint32_t binsNum       = 16;   ///< SAH bins per axis, at most 64
+    uint32_t maxLeafSize   = 4;    ///< leaves are never bigger than this, SAH may make them smaller
+    float    traversalCost = 1.0f; ///< cost of visiting a node relative to one primitive intersection
+  };
+
+  // top-down binned SAH; big nodes are binned by all threads, lower levels are built in parallel node by node.
+  // Triangles with out of range indices are not referenced by the tree; quads are triangulated, primIndices are triangle ids after Triangulate()
+  //
+  BVHTree BuildBVH(const SimpleMesh& a_mesh, const BVHBuildOptions& a_options = {});
+  BVHTree BuildBVH(const LiteMath::Box4f* a_boxes, size_t a_boxesNum, const BVHBuildOptions& a_options = {}); ///< over arbitrary primitives, e.g. instances
+
+  // wide trees are made from binary one by pulling up children with the largest surface area
+  //
+  BVH4Tree CollapseBVH4(const BVHTree& a_bvh);
+  BVH8Tree CollapseBVH8(const BVHTree& a_bvh);
+
+  bool    SaveBVH(const char* a_fileName, const BVHTree& a_bvh);
+  BVHTree LoadBVH(const char* a_fileName); ///< returns empty tree on error
+}
+
+#endif
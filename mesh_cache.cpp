@@ -0,0 +1,243 @@
+#include "mesh_cache.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace cmesh4
+{
+  static constexpr uint64_t MESH_CACHE_VERSION    = 1;           // change when converters produce different meshes from the same sources
+  static constexpr size_t   MESH_CACHE_HASH_CHUNK = size_t(1) << 20;
+
+  static constexpr uint64_t HASH_PRIME1 = 0x9E3779B185EBCA87ull;
+  static constexpr uint64_t HASH_PRIME2 = 0xC2B2AE3D27D4EB4Full;
+
+  static inline uint64_t Rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+  static inline uint64_t Mix64(uint64_t h)
+  {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static inline uint64_t Combine(uint64_t a_hash, uint64_t a_value) { return Mix64(a_hash ^ (a_value + HASH_PRIME1 + (a_hash << 6) + (a_hash >> 2))); }
+
+  // four independent lanes of 8 byte words, so the loop is not bound by multiplication latency
+  //
+  static uint64_t HashBytes(const uint8_t* a_data, size_t a_size, uint64_t a_seed)
+  {
+    uint64_t lanes[4] = {a_seed + HASH_PRIME1, a_seed + HASH_PRIME2, a_seed, a_seed - HASH_PRIME1};
+    size_t i = 0;
+    for(; i + 32 <= a_size; i += 32)
+    {
+      for(int k = 0; k < 4; k++)
+      {
+        uint64_t word;
+        std::memcpy(&word, a_data + i + k*8, sizeof(word));
+        lanes[k] = Rotl64(lanes[k] + word*HASH_PRIME2, 31)*HASH_PRIME1;
+      }
+    }
+
+    uint64_t h = uint64_t(a_size);
+    for(int k = 0; k < 4; k++)
+      h = Combine(h, lanes[k]);
+    for(; i < a_size; i++)
+      h = Combine(h, a_data[i]);
+    return h;
+  }
+
+  static bool HashFileContents(const std::string& a_fileName, uint64_t& a_hash)
+  {
+    MappedFile file;
+    if(!file.Open(a_fileName.c_str()))
+      return false;
+
+    const size_t chunksNum = (file.Size() + MESH_CACHE_HASH_CHUNK - 1) / MESH_CACHE_HASH_CHUNK;
+    std::vector<uint64_t> chunkHashes(chunksNum);
+
+    #pragma omp parallel for
+    for(int64_t c = 0; c < int64_t(chunksNum); c++)
+    {
+      const size_t begin = size_t(c)*MESH_CACHE_HASH_CHUNK;
+      const size_t end   = std::min(file.Size(), begin + MESH_CACHE_HASH_CHUNK);
+      chunkHashes[c] = HashBytes(file.Data() + begin, end - begin, uint64_t(c));
+    }
+
+    a_hash = 0;
+    for(uint64_t chunkHash : chunkHashes)
+      a_hash = Combine(a_hash, chunkHash);
+    return true;
+  }
+
+  static std::string ToHex(uint64_t a_value)
+  {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)a_value);
+    return std::string(buf);
+  }
+
+  static uint64_t HashString(const std::string& a_str) { return HashBytes((const uint8_t*)a_str.data(), a_str.size(), 0); }
+};
+
+cmesh4::MeshCache::MeshCache(const MeshCacheOptions& a_options) : m_options(a_options)
+{
+}
+
+std::string cmesh4::MeshCache::Key(const std::vector<std::string>& a_sourceFiles) const
+{
+  uint64_t key = Combine(MESH_CACHE_VERSION, a_sourceFiles.size());
+  for(const std::string& source : a_sourceFiles)
+  {
+    std::error_code ec;
+    const fs::path path = fs::weakly_canonical(fs::path(source), ec);
+    const uintmax_t size = fs::file_size(source, ec);
+    if(ec)
+      return std::string();
+    const fs::file_time_type mtime = fs::last_write_time(source, ec);
+    uint64_t contentHash = 0;
+    if(ec || !HashFileContents(source, contentHash))
+      return std::string();
+
+    key = Combine(key, HashString(path.empty() ? source : path.string()));
+    key = Combine(key, uint64_t(size));
+    key = Combine(key, uint64_t(mtime.time_since_epoch().count()));
+    key = Combine(key, contentHash);
+  }
+  return ToHex(key);
+}
+
+std::string cmesh4::MeshCache::SubKey(const std::string& a_key, const std::string& a_variant)
+{
+  return ToHex(Combine(HashString(a_key), HashString(a_variant)));
+}
+
+std::string cmesh4::MeshCache::EntryPath(const std::string& a_key) const
+{
+  return (fs::path(m_options.folder) / (a_key + ".vsgf")).string();
+}
+
+bool cmesh4::MeshCache::Load(const std::string& a_key, SimpleMesh& a_mesh) const
+{
+  if(!Enabled() || a_key.empty())
+    return false;
+
+  const std::string path = EntryPath(a_key);
+  std::error_code ec;
+  if(!fs::is_regular_file(path, ec))
+    return false;
+
+  SimpleMesh mesh = LoadMeshFromVSGF(path.c_str());
+  if(mesh.VerticesNum() == 0 || mesh.IndicesNum() == 0)
+  {
+    printf("[MeshCache::Load] Broken cache entry %s is removed\n", path.c_str());
+    fs::remove(path, ec);
+    return false;
+  }
+
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec); // LRU order is kept in modification times
+  if(m_options.verbose)
+    printf("[MeshCache::Load] Hit %s\n", path.c_str());
+  a_mesh = std::move(mesh);
+  return true;
+}
+
+bool cmesh4::MeshCache::Store(const std::string& a_key, const SimpleMesh& a_mesh)
+{
+  if(!Enabled() || a_key.empty() || a_mesh.VerticesNum() == 0 || a_mesh.IndicesNum() == 0)
+    return false;
+
+  std::error_code ec;
+  fs::create_directories(m_options.folder, ec);
+
+  const std::string path = EntryPath(a_key);
+  const size_t      tag  = std::hash<std::thread::id>()(std::this_thread::get_id()) ^ size_t(std::chrono::steady_clock::now().time_since_epoch().count());
+  const std::string temp = path + "." + ToHex(tag) + ".tmp";
+
+  const bool saved = m_options.compress ? SaveMeshToVSGF(temp.c_str(), a_mesh, VSGFSaveOptions{false, false, true, 6})
+                                        : SaveMeshToVSGF(temp.c_str(), a_mesh);
+  if(!saved)
+  {
+    printf("[MeshCache::Store] Can't write cache entry %s\n", temp.c_str());
+    fs::remove(temp, ec);
+    return false;
+  }
+  fs::rename(temp, path, ec); // atomic, readers see either no entry or the whole one
+  if(ec)
+  {
+    printf("[MeshCache::Store] Can't rename %s to %s: %s\n", temp.c_str(), path.c_str(), ec.message().c_str());
+    fs::remove(temp, ec);
+    return false;
+  }
+  if(m_options.verbose)
+    printf("[MeshCache::Store] Stored %s\n", path.c_str());
+
+  Evict();
+  return true;
+}
+
+void cmesh4::MeshCache::Evict()
+{
+  if(!Enabled() || m_options.maxBytes == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_evictMutex);
+
+  struct Entry { fs::path path; uint64_t bytes; fs::file_time_type lastUse; };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+
+  std::error_code ec;
+  for(fs::directory_iterator it(m_options.folder, ec), end; !ec && it != end; it.increment(ec))
+  {
+    if(it->path().extension() != ".vsgf")
+      continue;
+    std::error_code entryEc;
+    Entry entry;
+    entry.path    = it->path();
+    entry.bytes = uint64_t(it->file_size(entryEc));
+    if(entryEc)
+      continue; // removed by another process meanwhile
+    entry.lastUse = it->last_write_time(entryEc);
+    if(entryEc)
+      continue;
+    total += entry.bytes;
+    entries.push_back(std::move(entry));
+  }
+  if(total <= m_options.maxBytes)
+    return;
+
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+  for(size_t i = 0; i + 1 < entries.size() && total > m_options.maxBytes; i++) // the most recent entry is never evicted
+  {
+    if(fs::remove(entries[i].path, ec))
+      total -= entries[i].bytes;
+    if(m_options.verbose)
+      printf("[MeshCache::Evict] Removed %s\n", entries[i].path.string().c_str());
+  }
+}
+
+uint64_t cmesh4::MeshCache::SizeBytes() const
+{
+  uint64_t total = 0;
+  std::error_code ec;
+  for(fs::directory_iterator it(m_options.folder, ec), end; !ec && it != end; it.increment(ec))
+  {
+    if(it->path().extension() != ".vsgf")
+      continue;
+    std::error_code entryEc;
+    const uint64_t bytes = uint64_t(it->file_size(entryEc));
+    if(!entryEc)
+      total += bytes;
+  }
+  return total;
+}
@@ -0,0 +1,54 @@
+#ifndef LITESCENE_MESH_CACHE_H_
+#define LITESCENE_MESH_CACHE_H_
+
+#include "cmesh4.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cmesh4
+{
+  struct MeshCacheOptions
+  {
+    std::string folder;                      ///< created on first store; empty disables the cache
+    uint64_t    maxBytes = uint64_t(4) << 30; ///< least recently used entries are removed when total size exceeds it; 0 means no limit
+    bool        compress = false;            ///< lossless deflated VSGF v2 instead of plain VSGF; smaller, but several times slower to load
+    bool        verbose  = false;
+  };
+
+  // content addressed on-disk cache of meshes converted from text formats (OBJ, glTF) into .vsgf.
+  // Key of an entry is a hash of path, size, modification time and contents of all its source files,
+  // so any change of a source makes a new entry and the old one is eventually evicted.
+  // Entries are written to a temporary file and renamed, so several processes can share one folder.
+  //
+  class MeshCache
+  {
+  public:
+    explicit MeshCache(const MeshCacheOptions& a_options);
+
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    inline bool                    Enabled() const { return !m_options.folder.empty(); }
+    inline const MeshCacheOptions& Options() const { return m_options; }
+
+    std::string        Key(const std::vector<std::string>& a_sourceFiles) const; ///< empty string if some source can't be read
+    inline std::string Key(const char* a_sourceFile) const { return Key(std::vector<std::string>{a_sourceFile}); }
+    static std::string SubKey(const std::string& a_key, const std::string& a_variant); ///< key for one of several meshes or loader settings of the same sources
+
+    bool     Load (const std::string& a_key, SimpleMesh& a_mesh) const; ///< false on miss; marks entry as recently used
+    bool     Store(const std::string& a_key, const SimpleMesh& a_mesh); ///< then evicts old entries if the cache is over the limit
+    void     Evict();
+    uint64_t SizeBytes() const; ///< total size of all entries
+
+  private:
+    std::string EntryPath(const std::string& a_key) const;
+
+    MeshCacheOptions m_options;
+    std::mutex       m_evictMutex;
+  };
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "mesh_compact.h"
+#include "mesh_quant.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace cmesh4
+{
+  static constexpr float RAD_TO_DEG = 57.29577951308232f;
+
+  static inline float AngleBetween(const LiteMath::float3& a, const LiteMath::float3& b)
+  {
+    const float la = LiteMath::length(a), lb = LiteMath::length(b);
+    if(la == 0.0f || lb == 0.0f)
+      return (la == lb) ? 0.0f : 180.0f;
+    return std::acos(std::min(std::max(LiteMath::dot(a, b)/(la*lb), -1.0f), 1.0f))*RAD_TO_DEG;
+  }
+};
+
+LiteMath::float4x4 cmesh4::CompactMesh::DequantMatrix() const
+{
+  LiteMath::float4x4 res;
+  res.set_col(0, float4(posScale.x/65535.0f, 0, 0, 0));
+  res.set_col(1, float4(0, posScale.y/65535.0f, 0, 0));
+  res.set_col(2, float4(0, 0, posScale.z/65535.0f, 0));
+  res.set_col(3, float4(posOffset.x, posOffset.y, posOffset.z, 1));
+  return res;
+}
+
+cmesh4::float4 cmesh4::CompactMesh::GetPos(size_t a_vertId) const
+{
+  const CompactVertex& v = vertices[a_vertId];
+  return float4(DequantizeUnorm16(v.pos[0], posOffset.x, posScale.x),
+                DequantizeUnorm16(v.pos[1], posOffset.y, posScale.y),
+                DequantizeUnorm16(v.pos[2], posOffset.z, posScale.z), 1.0f);
+}
+
+cmesh4::CompactMesh cmesh4::ToCompactMesh(const SimpleMesh& a_mesh, CompactMeshError* a_pError)
+{
+  const size_t vertNum = a_mesh.VerticesNum();
+
+  CompactMesh res;
+  TriangulatedIndices(a_mesh, res.indices, res.matIndices);
+  res.vertices.resize(vertNum);
+
+  const bool hasNorm = a_mesh.vNorm4f.size()     == vertNum;
+  const bool hasTang = a_mesh.vTang4f.size()     == vertNum;
+  const bool hasUV   = a_mesh.vTexCoord2f.size() == vertNum;
+  res.attribs = (hasNorm ? CompactMesh::HAS_NORMALS : 0) | (hasTang ? CompactMesh::HAS_TANGENTS : 0) | (hasUV ? CompactMesh::HAS_TEXCOORDS : 0);
+
+  if(vertNum > 0)
+  {
+    const LiteMath::Box4f box = a_mesh.GetAABB();
+    res.posOffset = float4(box.boxMin.x, box.boxMin.y, box.boxMin.z, 0.0f);
+    res.posScale  = float4(box.boxMax.x - box.boxMin.x, box.boxMax.y - box.boxMin.y, box.boxMax.z - box.boxMin.z, 0.0f);
+  }
+  const float invScale[3] = {res.posScale.x > 0.0f ? 1.0f/res.posScale.x : 0.0f,
+                             res.posScale.y > 0.0f ? 1.0f/res.posScale.y : 0.0f,
+                             res.posScale.z > 0.0f ? 1.0f/res.posScale.z : 0.0f};
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < int64_t(vertNum); i++)
+  {
+    CompactVertex v = {};
+    const float4 p = a_mesh.vPos4f[i];
+    v.pos[0] = QuantizeUnorm16(p.x, res.posOffset.x, invScale[0]);
+    v.pos[1] = QuantizeUnorm16(p.y, res.posOffset.y, invScale[1]);
+    v.pos[2] = QuantizeUnorm16(p.z, res.posOffset.z, invScale[2]);
+    if(hasNorm)
+      EncodeOct16(a_mesh.vNorm4f[i].x, a_mesh.vNorm4f[i].y, a_mesh.vNorm4f[i].z, v.norm);
+    if(hasTang)
+    {
+      EncodeOct16(a_mesh.vTang4f[i].x, a_mesh.vTang4f[i].y, a_mesh.vTang4f[i].z, v.tang);
+      if(a_mesh.vTang4f[i].w < 0.0f)
+        v.flags |= CompactMesh::TANGENT_NEGATIVE_W;
+    }
+    if(hasUV)
+    {
+      v.uv[0] = FloatToHalf(a_mesh.vTexCoord2f[i].x);
+      v.uv[1] = FloatToHalf(a_mesh.vTexCoord2f[i].y);
+    }
+    res.vertices[i] = v;
+  }
+
+  if(a_pError != nullptr)
+    *a_pError = MeasureCompactMeshError(a_mesh, res);
+
+  return res;
+}
+
+cmesh4::SimpleMesh cmesh4::FromCompactMesh(const CompactMesh& a_mesh)
+{
+  const size_t vertNum = a_mesh.VerticesNum();
+
+  SimpleMesh res;
+  res.vPos4f.resize(vertNum);
+  res.vNorm4f.resize((a_mesh.attribs & CompactMesh::HAS_NORMALS) ? vertNum : 0);
+  res.vTang4f.resize((a_mesh.attribs & CompactMesh::HAS_TANGENTS) ? vertNum : 0);
+  res.vTexCoord2f.resize((a_mesh.attribs & CompactMesh::HAS_TEXCOORDS) ? vertNum : 0);
+  res.indices    = a_mesh.indices;
+  res.matIndices = a_mesh.matIndices;
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < int64_t(vertNum); i++)
+  {
+    const CompactVertex& v = a_mesh.vertices[i];
+    res.vPos4f[i] = a_mesh.GetPos(size_t(i));
+    if(!res.vNorm4f.empty())
+      res.vNorm4f[i] = LiteMath::to_float4(DecodeOct16(v.norm), 0.0f);
+    if(!res.vTang4f.empty())
+      res.vTang4f[i] = LiteMath::to_float4(DecodeOct16(v.tang), (v.flags & CompactMesh::TANGENT_NEGATIVE_W) ? -1.0f : 1.0f);
+    if(!res.vTexCoord2f.empty())
+      res.vTexCoord2f[i] = float2(HalfToFloat(v.uv[0]), HalfToFloat(v.uv[1]));
+  }
+
+  return res;
+}
+
+cmesh4::CompactMeshError cmesh4::MeasureCompactMeshError(const SimpleMesh& a_source, const CompactMesh& a_compact)
+{
+  CompactMeshError res;
+  const size_t vertNum = std::min(a_source.VerticesNum(), a_compact.VerticesNum());
+  const bool hasNorm = (a_compact.attribs & CompactMesh::HAS_NORMALS)   && a_source.vNorm4f.size()     >= vertNum;
+  const bool hasTang = (a_compact.attribs & CompactMesh::HAS_TANGENTS)  && a_source.vTang4f.size()     >= vertNum;
+  const bool hasUV   = (a_compact.attribs & CompactMesh::HAS_TEXCOORDS) && a_source.vTexCoord2f.size() >= vertNum;
+
+  #pragma omp parallel
+  {
+    CompactMeshError local;
+
+    #pragma omp for nowait
+    for(int64_t i = 0; i < int64_t(vertNum); i++)
+    {
+      const CompactVertex& v = a_compact.vertices[i];
+      local.maxPosError = std::max(local.maxPosError, LiteMath::length(LiteMath::to_float3(a_compact.GetPos(size_t(i))) - LiteMath::to_float3(a_source.vPos4f[i])));
+      if(hasNorm)
+        local.maxNormalAngle = std::max(local.maxNormalAngle, AngleBetween(DecodeOct16(v.norm), LiteMath::to_float3(a_source.vNorm4f[i])));
+      if(hasTang)
+        local.maxTangentAngle = std::max(local.maxTangentAngle, AngleBetween(DecodeOct16(v.tang), LiteMath::to_float3(a_source.vTang4f[i])));
+      if(hasUV)
+      {
+        local.maxTexCoordError = std::max(local.maxTexCoordError, std::abs(HalfToFloat(v.uv[0]) - a_source.vTexCoord2f[i].x));
+        local.maxTexCoordError = std::max(local.maxTexCoordError, std::abs(HalfToFloat(v.uv[1]) - a_source.vTexCoord2f[i].y));
+      }
+    }
+
+    #pragma omp critical
+    {
+      res.maxPosError      = std::max(res.maxPosError,      local.maxPosError);
+      res.maxNormalAngle   = std::max(res.maxNormalAngle,   local.maxNormalAngle);
+      res.maxTangentAngle  = std::max(res.maxTangentAngle,  local.maxTangentAngle);
+      res.maxTexCoordError = std::max(res.maxTexCoordError, local.maxTexCoordError);
+    }
+  }
+
+  const float diagonal = LiteMath::length(LiteMath::to_float3(a_compact.posScale));
+  res.maxPosErrorRel = (diagonal > 0.0f) ? res.maxPosError/diagonal : 0.0f;
+  return res;
+}
@@ -0,0 +1,57 @@
+#ifndef LITESCENE_MESH_COMPACT_H_
+#define LITESCENE_MESH_COMPACT_H_
+#include "cmesh4.h"
+
+namespace cmesh4
+{
+  // 20 bytes per vertex instead of 56 in SimpleMesh
+  //
+  struct CompactVertex
+  {
+    uint16_t pos[3];  ///< unorm16 inside mesh bounding box, see CompactMesh::DequantMatrix()
+    uint16_t flags;   ///< TANGENT_NEGATIVE_W bit stores tangent handedness
+    int16_t  norm[2]; ///< octahedral snorm16
+    int16_t  tang[2]; ///< octahedral snorm16
+    uint16_t uv[2];   ///< IEEE half
+  };
+
+  static_assert(sizeof(CompactVertex) == 20, "CompactVertex is expected to be tightly packed");
+
+  struct CompactMesh
+  {
+    enum VERTEX_FLAGS { TANGENT_NEGATIVE_W = 1 };
+    enum ATTR_FLAGS   { HAS_NORMALS = 1, HAS_TANGENTS = 2, HAS_TEXCOORDS = 4 };
+
+    float4   posOffset = float4(0,0,0,0); ///< position = posOffset + posScale*pos/65535
+    float4   posScale  = float4(0,0,0,0);
+    uint32_t attribs   = 0;               ///< ATTR_FLAGS of attributes that were present in the source mesh
+
+    std::vector<CompactVertex> vertices;
+    std::vector<unsigned int>  indices;
+    std::vector<unsigned int>  matIndices;
+
+    inline size_t VerticesNum()  const { return vertices.size(); }
+    inline size_t TrianglesNum() const { return indices.size() / 3; }
+    inline size_t SizeInBytes()  const { return vertices.size()*sizeof(CompactVertex) + (indices.size() + matIndices.size())*sizeof(unsigned int); }
+
+    LiteMath::float4x4 DequantMatrix() const; ///< maps (pos[0], pos[1], pos[2], 1) to object space, can be put into vertex shader
+    float4 GetPos(size_t a_vertId) const;
+  };
+
+  // maximal differences between the source mesh and its compact version
+  //
+  struct CompactMeshError
+  {
+    float maxPosError      = 0.0f; ///< object space distance
+    float maxPosErrorRel   = 0.0f; ///< same, relative to bounding box diagonal
+    float maxNormalAngle   = 0.0f; ///< degrees
+    float maxTangentAngle  = 0.0f; ///< degrees
+    float maxTexCoordError = 0.0f; ///< absolute, grows with |uv| because of half precision
+  };
+
+  CompactMesh      ToCompactMesh(const SimpleMesh& a_mesh, CompactMeshError* a_pError = nullptr);
+  SimpleMesh       FromCompactMesh(const CompactMesh& a_mesh);
+  CompactMeshError MeasureCompactMeshError(const SimpleMesh& a_source, const CompactMesh& a_compact);
+}
+
+#endif
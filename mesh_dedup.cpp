@@ -0,0 +1,146 @@
+#include "mesh_dedup.h"
+
+#include <algorithm>
+
+namespace cmesh4
+{
+  static constexpr uint32_t DEDUP_SHARD_BITS = 8; // fixed, so shards do not depend on number of threads
+  static constexpr size_t   DEDUP_CHUNK_SIZE = 65536;
+};
+
+cmesh4::IndexTripleTable::IndexTripleTable(size_t a_maxKeys)
+{
+  size_t capacity = 16;
+  while(capacity < 2*a_maxKeys)
+    capacity *= 2;
+  m_slots.resize(capacity, Slot{{0, 0, 0}, DEDUP_NO_INDEX});
+  m_mask = capacity - 1;
+}
+
+uint32_t cmesh4::IndexTripleTable::FindOrInsert(const IndexTriple& a_key, uint64_t a_hash, uint32_t a_value)
+{
+  for(size_t i = size_t(a_hash) & m_mask; ; i = (i + 1) & m_mask)
+  {
+    Slot& slot = m_slots[i];
+    if(slot.value == DEDUP_NO_INDEX)
+    {
+      slot.key   = a_key;
+      slot.value = a_value;
+      m_size++;
+      return a_value;
+    }
+    if(slot.key == a_key)
+      return slot.value;
+  }
+}
+
+uint32_t cmesh4::DedupIndexTriples(const IndexTriple* a_keys, size_t a_keysNum, std::vector<uint32_t>& a_ids, std::vector<uint32_t>& a_firsts)
+{
+  const size_t shardsNum = size_t(1) << DEDUP_SHARD_BITS;
+  const size_t chunksNum = (a_keysNum + DEDUP_CHUNK_SIZE - 1) / DEDUP_CHUNK_SIZE;
+
+  a_ids.resize(a_keysNum);
+  a_firsts.clear();
+  if(a_keysNum == 0)
+    return 0;
+
+  // (1) hashes and stable counting sort of key positions by shard, positions stay ascending inside every shard
+  //
+  std::vector<uint64_t> hashes(a_keysNum);
+  std::vector<uint32_t> offsets(chunksNum*shardsNum, 0);
+
+  #pragma omp parallel for
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+  {
+    uint32_t* hist = offsets.data() + size_t(c)*shardsNum;
+    const size_t end = std::min(a_keysNum, size_t(c + 1)*DEDUP_CHUNK_SIZE);
+    for(size_t i = size_t(c)*DEDUP_CHUNK_SIZE; i < end; i++)
+    {
+      hashes[i] = HashIndexTriple(a_keys[i]);
+      hist[hashes[i] >> (64 - DEDUP_SHARD_BITS)]++;
+    }
+  }
+
+  std::vector<size_t> shardBegin(shardsNum + 1, 0);
+  uint32_t running = 0;
+  for(size_t s = 0; s < shardsNum; s++)
+  {
+    shardBegin[s] = running;
+    for(size_t c = 0; c < chunksNum; c++)
+    {
+      const uint32_t count = offsets[c*shardsNum + s];
+      offsets[c*shardsNum + s] = running;
+      running += count;
+    }
+  }
+  shardBegin[shardsNum] = running;
+
+  std::vector<uint32_t> order(a_keysNum);
+
+  #pragma omp parallel for
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+  {
+    uint32_t* cursor = offsets.data() + size_t(c)*shardsNum;
+    const size_t end = std::min(a_keysNum, size_t(c + 1)*DEDUP_CHUNK_SIZE);
+    for(size_t i = size_t(c)*DEDUP_CHUNK_SIZE; i < end; i++)
+      order[cursor[hashes[i] >> (64 - DEDUP_SHARD_BITS)]++] = uint32_t(i);
+  }
+
+  // (2) every shard is deduplicated by one thread in its own table; the first occurrence of a key is the representative
+  //
+  std::vector<uint32_t> firstOf(a_keysNum);
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int64_t s = 0; s < int64_t(shardsNum); s++)
+  {
+    IndexTripleTable table(shardBegin[s + 1] - shardBegin[s]);
+    for(size_t j = shardBegin[s]; j < shardBegin[s + 1]; j++)
+    {
+      const uint32_t i = order[j];
+      firstOf[i] = table.FindOrInsert(a_keys[i], hashes[i], i);
+    }
+  }
+
+  // (3) ids of first occurrences by prefix sum over chunks, then ids of repeated keys (their first occurrence is always earlier)
+  //
+  std::vector<uint32_t> chunkFirsts(chunksNum + 1, 0);
+
+  #pragma omp parallel for
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+  {
+    const size_t end = std::min(a_keysNum, size_t(c + 1)*DEDUP_CHUNK_SIZE);
+    uint32_t count = 0;
+    for(size_t i = size_t(c)*DEDUP_CHUNK_SIZE; i < end; i++)
+      count += (firstOf[i] == uint32_t(i));
+    chunkFirsts[c + 1] = count;
+  }
+  for(size_t c = 0; c < chunksNum; c++)
+    chunkFirsts[c + 1] += chunkFirsts[c];
+
+  const uint32_t uniqueNum = chunkFirsts[chunksNum];
+  a_firsts.resize(uniqueNum);
+
+  #pragma omp parallel for
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+  {
+    const size_t end = std::min(a_keysNum, size_t(c + 1)*DEDUP_CHUNK_SIZE);
+    uint32_t id = chunkFirsts[c];
+    for(size_t i = size_t(c)*DEDUP_CHUNK_SIZE; i < end; i++)
+    {
+      if(firstOf[i] == uint32_t(i))
+      {
+        a_firsts[id] = uint32_t(i);
+        a_ids[i]     = id++;
+      }
+    }
+  }
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < int64_t(a_keysNum); i++)
+  {
+    if(firstOf[i] != uint32_t(i))
+      a_ids[i] = a_ids[firstOf[i]];
+  }
+
+  return uniqueNum;
+}
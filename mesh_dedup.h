@@ -0,0 +1,64 @@
+#ifndef LITESCENE_MESH_DEDUP_H_
+#define LITESCENE_MESH_DEDUP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cmesh4
+{
+  static constexpr uint32_t DEDUP_NO_INDEX = uint32_t(-1);
+
+  // corner of a polygon in formats with separate index per attribute, e.g. OBJ (position, texcoord, normal);
+  // DEDUP_NO_INDEX for absent attributes
+  //
+  struct IndexTriple
+  {
+    uint32_t i0, i1, i2;
+
+    inline bool operator==(const IndexTriple& other) const { return i0 == other.i0 && i1 == other.i1 && i2 == other.i2; }
+  };
+
+  static_assert(sizeof(IndexTriple) == 12, "IndexTriple is expected to be packed 96 bit key");
+
+  inline uint64_t HashIndexTriple(const IndexTriple& a_key)
+  {
+    uint64_t h = (uint64_t(a_key.i0) | (uint64_t(a_key.i1) << 32))*0x9E3779B185EBCA87ull;
+    h ^= (uint64_t(a_key.i2) + 0x165667B19E3779F9ull)*0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return h;
+  }
+
+  // flat open addressing table with linear probing; capacity is fixed at creation from the maximal number of keys,
+  // so it never rehashes. Not thread safe, DedupIndexTriples gives every thread its own tables
+  //
+  struct IndexTripleTable
+  {
+    explicit IndexTripleTable(size_t a_maxKeys);
+
+    uint32_t FindOrInsert(const IndexTriple& a_key, uint64_t a_hash, uint32_t a_value); ///< value stored for the key, a_value if it was just inserted
+    inline uint32_t FindOrInsert(const IndexTriple& a_key, uint32_t a_value) { return FindOrInsert(a_key, HashIndexTriple(a_key), a_value); }
+    inline size_t   Size() const { return m_size; }
+
+  private:
+    struct Slot
+    {
+      IndexTriple key;
+      uint32_t    value; ///< DEDUP_NO_INDEX for empty slot
+    };
+
+    std::vector<Slot> m_slots;
+    size_t            m_mask = 0;
+    size_t            m_size = 0;
+  };
+
+  // numbers unique keys in order of their first occurrence: a_ids[i] is id of a_keys[i], a_firsts[id] is position of its first occurrence.
+  // Keys are distributed to shards by hash and shards are filled in parallel, the result does not depend on number of threads.
+  // Returns number of unique keys
+  //
+  uint32_t DedupIndexTriples(const IndexTriple* a_keys, size_t a_keysNum, std::vector<uint32_t>& a_ids, std::vector<uint32_t>& a_firsts);
+}
+
+#endif
@@ -0,0 +1,193 @@
+#include "mesh_indices.h"
+#include "mesh_optimize.h"
+
+#include <algorithm>
+
+cmesh4::PackedUInts cmesh4::PackedUInts::Pack(const unsigned int* a_data, size_t a_size, uint32_t a_minWidth)
+{
+  const uint32_t maxVal = (a_size > 0) ? *std::max_element(a_data, a_data + a_size) : 0;
+
+  PackedUInts res;
+  res.m_size  = a_size;
+  res.m_width = (maxVal <= 0xFF) ? 1 : (maxVal <= 0xFFFF ? 2 : 4);
+  res.m_width = std::max(res.m_width, std::min(a_minWidth, 4u));
+  res.m_data.resize(a_size*res.m_width);
+
+  switch(res.m_width)
+  {
+  case 1:
+    for(size_t i = 0; i < a_size; i++)
+      res.m_data[i] = uint8_t(a_data[i]);
+    break;
+  case 2:
+  {
+    uint16_t* out = (uint16_t*)res.m_data.data();
+    for(size_t i = 0; i < a_size; i++)
+      out[i] = uint16_t(a_data[i]);
+    break;
+  }
+  default:
+    memcpy(res.m_data.data(), a_data, a_size*sizeof(uint32_t));
+    break;
+  };
+
+  return res;
+}
+
+void cmesh4::PackedUInts::Unpack(std::vector<unsigned int>& a_out) const
+{
+  a_out.resize(m_size);
+  switch(m_width)
+  {
+  case 1:
+    for(size_t i = 0; i < m_size; i++)
+      a_out[i] = m_data[i];
+    break;
+  case 2:
+  {
+    const uint16_t* in = (const uint16_t*)m_data.data();
+    for(size_t i = 0; i < m_size; i++)
+      a_out[i] = in[i];
+    break;
+  }
+  default:
+    memcpy(a_out.data(), m_data.data(), m_size*sizeof(uint32_t));
+    break;
+  };
+}
+
+cmesh4::PackedMeshIndices cmesh4::PackMeshIndices(const SimpleMesh& a_mesh)
+{
+  PackedMeshIndices res;
+  res.indices    = PackedUInts::Pack(a_mesh.indices.data(),    a_mesh.indices.size(), 2);
+  res.matIndices = PackedUInts::Pack(a_mesh.matIndices.data(), a_mesh.matIndices.size(), 1);
+  return res;
+}
+
+void cmesh4::UnpackMeshIndices(const PackedMeshIndices& a_packed, SimpleMesh& a_mesh)
+{
+  a_packed.indices.Unpack(a_mesh.indices);
+  a_packed.matIndices.Unpack(a_mesh.matIndices);
+}
+
+std::vector<cmesh4::SimpleMesh> cmesh4::SplitMesh(const SimpleMesh& a_mesh, size_t a_maxVertices)
+{
+  const size_t vertNum = a_mesh.VerticesNum();
+  a_maxVertices = std::max(a_maxVertices, size_t(3));
+
+  if(vertNum <= a_maxVertices)
+  {
+    std::vector<SimpleMesh> res = {a_mesh};
+    res[0].Triangulate();
+    return res;
+  }
+
+  const TriangleIndices tris(a_mesh); // vertices are read from a_mesh, so quads are not copied whole
+  const size_t trisNum = tris.TrianglesNum();
+
+  // (1) assign triangles to chunks greedily, in the original order
+  //
+  struct Chunk
+  {
+    size_t firstTri = 0;
+    size_t trisNum  = 0;
+    std::vector<uint32_t> vertices; // global ids in order of first use
+  };
+
+  std::vector<Chunk> chunks(1);
+  std::vector<uint32_t> stamp(vertNum, uint32_t(-1));
+
+  for(size_t t = 0; t < trisNum; t++)
+  {
+    const uint32_t* tri = tris.indices.data() + t*3;
+    if(tri[0] >= vertNum || tri[1] >= vertNum || tri[2] >= vertNum)
+      continue;
+
+    uint32_t chunkId = uint32_t(chunks.size() - 1);
+    size_t newVerts  = 0;
+    for(int k = 0; k < 3; k++)
+    {
+      const bool dup = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+      if(stamp[tri[k]] != chunkId && !dup)
+        newVerts++;
+    }
+
+    if(chunks.back().vertices.size() + newVerts > a_maxVertices)
+    {
+      chunks.emplace_back();
+      chunks.back().firstTri = t;
+      chunkId++;
+    }
+    else if(chunks.back().trisNum == 0)
+      chunks.back().firstTri = t;
+
+    for(int k = 0; k < 3; k++)
+    {
+      if(stamp[tri[k]] != chunkId)
+      {
+        stamp[tri[k]] = chunkId;
+        chunks.back().vertices.push_back(tri[k]);
+      }
+    }
+    chunks.back().trisNum = t + 1 - chunks.back().firstTri;
+  }
+
+  // (2) build chunks in parallel, each one has its own local remap table
+  //
+  std::vector<SimpleMesh> res(chunks.size());
+  const bool hasNorm = a_mesh.vNorm4f.size()       == vertNum;
+  const bool hasTang = a_mesh.vTang4f.size()       == vertNum;
+  const bool hasUV   = a_mesh.vTexCoord2f.size()   == vertNum;
+  const bool hasUV1  = a_mesh.vTexCoord2f_1.size() == vertNum;
+  const bool hasCol  = a_mesh.vColor4f.size()      == vertNum;
+  const bool hasMat  = tris.matIndices.size()      >= trisNum;
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int c = 0; c < int(chunks.size()); c++)
+  {
+    const Chunk& chunk = chunks[c];
+    SimpleMesh& out    = res[c];
+    const size_t chunkVerts = chunk.vertices.size();
+
+    out.vPos4f.resize(chunkVerts);
+    out.vNorm4f.resize(hasNorm ? chunkVerts : 0);
+    out.vTang4f.resize(hasTang ? chunkVerts : 0);
+    out.vTexCoord2f.resize(hasUV ? chunkVerts : 0);
+    out.vTexCoord2f_1.resize(hasUV1 ? chunkVerts : 0);
+    out.vColor4f.resize(hasCol ? chunkVerts : 0);
+
+    std::vector<std::pair<uint32_t, uint32_t>> globalToLocal(chunkVerts);
+    for(size_t i = 0; i < chunkVerts; i++)
+    {
+      const uint32_t v = chunk.vertices[i];
+      out.vPos4f[i] = a_mesh.vPos4f[v];
+      if(hasNorm) out.vNorm4f[i]       = a_mesh.vNorm4f[v];
+      if(hasTang) out.vTang4f[i]       = a_mesh.vTang4f[v];
+      if(hasUV)   out.vTexCoord2f[i]   = a_mesh.vTexCoord2f[v];
+      if(hasUV1)  out.vTexCoord2f_1[i] = a_mesh.vTexCoord2f_1[v];
+      if(hasCol)  out.vColor4f[i]      = a_mesh.vColor4f[v];
+      globalToLocal[i] = {v, uint32_t(i)};
+    }
+    std::sort(globalToLocal.begin(), globalToLocal.end());
+
+    auto local = [&](uint32_t v) {
+      return std::lower_bound(globalToLocal.begin(), globalToLocal.end(), std::make_pair(v, uint32_t(0)))->second;
+    };
+
+    out.indices.reserve(chunk.trisNum*3);
+    out.matIndices.reserve(chunk.trisNum);
+    for(size_t t = chunk.firstTri; t < chunk.firstTri + chunk.trisNum; t++)
+    {
+      const uint32_t* tri = tris.indices.data() + t*3;
+      if(tri[0] >= vertNum || tri[1] >= vertNum || tri[2] >= vertNum)
+        continue;
+      for(int k = 0; k < 3; k++)
+        out.indices.push_back(local(tri[k]));
+      out.matIndices.push_back(hasMat ? tris.matIndices[t] : 0);
+    }
+    if(!a_mesh.matRanges.empty())
+      out.matRanges = ComputeMaterialRanges(out);
+  }
+
+  return res;
+}
@@ -0,0 +1,60 @@
+#ifndef LITESCENE_MESH_INDICES_H_
+#define LITESCENE_MESH_INDICES_H_
+#include "cmesh4.h"
+
+#include <cstring>
+
+namespace cmesh4
+{
+  // array of unsigned integers stored with the smallest sufficient width (1, 2 or 4 bytes per element);
+  // data() can be uploaded as is, e.g. as VK_INDEX_TYPE_UINT16 index buffer when width == 2
+  //
+  struct PackedUInts
+  {
+    inline uint32_t width()       const { return m_width; }
+    inline size_t   size()        const { return m_size; }
+    inline size_t   SizeInBytes() const { return m_data.size(); }
+    inline const uint8_t* data()  const { return m_data.data(); }
+
+    inline uint32_t operator[](size_t i) const
+    {
+      switch(m_width)
+      {
+        case 1:  return m_data[i];
+        case 2:  { uint16_t v; memcpy(&v, m_data.data() + i*2, 2); return v; }
+        default: { uint32_t v; memcpy(&v, m_data.data() + i*4, 4); return v; }
+      }
+    }
+
+    // a_minWidth is 2 for index buffers, because 8 bit indices are not universally supported by graphics APIs
+    //
+    static PackedUInts Pack(const unsigned int* a_data, size_t a_size, uint32_t a_minWidth = 1);
+    void Unpack(std::vector<unsigned int>& a_out) const;
+
+  private:
+    std::vector<uint8_t> m_data;
+    size_t   m_size  = 0;
+    uint32_t m_width = 4;
+  };
+
+  // index data of SimpleMesh in compact form: 16 bit indices if the mesh has at most 65536 vertices,
+  // 8 or 16 bit material indices if material ids allow
+  //
+  struct PackedMeshIndices
+  {
+    PackedUInts indices;
+    PackedUInts matIndices;
+
+    inline size_t SizeInBytes() const { return indices.SizeInBytes() + matIndices.SizeInBytes(); }
+  };
+
+  PackedMeshIndices PackMeshIndices(const SimpleMesh& a_mesh);
+  void              UnpackMeshIndices(const PackedMeshIndices& a_packed, SimpleMesh& a_mesh);
+
+  // splits mesh into chunks of at most a_maxVertices vertices each (so 16 bit indices can be used), keeping triangle order;
+  // a vertex used by triangles of several chunks is copied to each of them
+  //
+  std::vector<SimpleMesh> SplitMesh(const SimpleMesh& a_mesh, size_t a_maxVertices = 65536);
+}
+
+#endif
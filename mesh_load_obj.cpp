@@ -1,148 +1,1022 @@
 #include "mesh_load_obj.h"
+#include "mesh_tangents.h"
+#include "mesh_dedup.h"
+#include "mesh_cache.h"
 
 #include <cstdio>
+#include <cstring>
+#include <cmath>
 #include <string>
+#include <fstream>
+#include <algorithm>
 #include <unordered_map>
+#include <filesystem>
 
 #ifdef DISABLE_OBJ_LOADER
-SimpleMesh LoadMeshFromObj(const char* a_fileName, bool aVerbose, const char* a_mtlBaseDir)
+cmesh4::SimpleMesh cmesh4::LoadMeshFromObj(const char* a_fileName, bool aVerbose, const char* a_mtlBaseDir, MeshCache* a_cache, bool a_keepQuads)
 {
   printf("[LoadMeshFromObj::ERROR] OBJ loader is disabled\n");
   return SimpleMesh();
 }
+
+bool cmesh4::ConvertObjToVSGF(const char* a_objFile, const char* a_vsgfFile, const ObjConvertOptions& a_options)
+{
+  printf("[ConvertObjToVSGF::ERROR] OBJ loader is disabled\n");
+  return false;
+}
 #else
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "3rd_party/tiny_obj_loader.h"
+#include "mapped_file.h"
 
-struct TinyObjIndexEqual
+namespace cmesh4
 {
-  bool operator()(const tinyobj::index_t &lhs, const tinyobj::index_t &rhs) const
+  static constexpr size_t  OBJ_CHUNK_SIZE       = size_t(4) << 20; // bytes, chunks are extended to the end of line
+  static constexpr int32_t OBJ_NO_INDEX         = -1;
+  static constexpr int32_t OBJ_INHERIT_MATERIAL = -2;               // face before the first usemtl of a chunk
+
+  struct ObjCorner
+  {
+    int32_t v, vt, vn; // 0-based, OBJ_NO_INDEX if absent
+  };
+
+  static inline int32_t& IndexOf(ObjCorner& a_corner, uint32_t a_component)
+  {
+    return (a_component == 0) ? a_corner.v : ((a_component == 1) ? a_corner.vt : a_corner.vn);
+  }
+
+  // everything found in one chunk of the file; negative (relative) indices are resolved against counts inside the chunk,
+  // so they get chunk base offsets added after all chunks are parsed
+  //
+  struct ObjChunk
+  {
+    std::vector<float>       pos;           ///< 3 per vertex
+    std::vector<float>       norm;          ///< 3 per normal
+    std::vector<float>       uv;            ///< 2 per texture coordinate
+    std::vector<ObjCorner>   corners;       ///< of all faces
+    std::vector<uint32_t>    faceSizes;
+    std::vector<int32_t>     faceMaterials; ///< index in materialNames or OBJ_INHERIT_MATERIAL
+    std::vector<uint32_t>    relative;      ///< corner*3 + component of indices that are relative to chunk start
+    std::vector<std::string> materialNames;
+    std::vector<std::string> mtlLibs;
+    int32_t                  lastMaterial = OBJ_INHERIT_MATERIAL;
+    std::vector<IndexTriple> tris;          ///< 3 per triangle after triangulation (or 4 per kept quad), (position, texcoord, normal)
+    std::vector<unsigned>    triMaterials;  ///< one per triangle or kept quad
+    size_t                   skipped = 0;   ///< triangles (or quads) with invalid position index
+  };
+
+  static inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+  static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+  static inline const char* SkipSpaces(const char* p, const char* end)
+  {
+    while(p < end && IsSpace(*p))
+      p++;
+    return p;
+  }
+
+  static inline const char* TrimRight(const char* begin, const char* end)
+  {
+    while(end > begin && IsSpace(end[-1]))
+      end--;
+    return end;
+  }
+
+  static inline double Pow10(int e)
+  {
+    static const double table[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    return (e <= 22) ? table[e] : std::pow(10.0, double(e));
+  }
+
+  // locale independent and allocation free, like std::from_chars; returns nullptr if there is no number at p
+  //
+  static const char* ParseFloat(const char* p, const char* end, float& a_res)
+  {
+    p = SkipSpaces(p, end);
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+      negative = (*p++ == '-');
+
+    uint64_t mantissa = 0;
+    int      digits   = 0; // significant ones, at most 19 fit into mantissa
+    int      exp10    = 0;
+    bool     any      = false;
+    for(; p < end && IsDigit(*p); p++, any = true)
+    {
+      if(digits < 19)
+      {
+        mantissa = mantissa*10 + uint64_t(*p - '0');
+        digits  += (mantissa != 0);
+      }
+      else
+        exp10++;
+    }
+    if(p < end && *p == '.')
+    {
+      for(p++; p < end && IsDigit(*p); p++, any = true)
+      {
+        if(digits < 19)
+        {
+          mantissa = mantissa*10 + uint64_t(*p - '0');
+          digits  += (mantissa != 0);
+          exp10--;
+        }
+      }
+    }
+    if(!any)
+      return nullptr;
+
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+      const char* q = p + 1;
+      bool expNegative = false;
+      if(q < end && (*q == '-' || *q == '+'))
+        expNegative = (*q++ == '-');
+      if(q < end && IsDigit(*q))
+      {
+        int e = 0;
+        for(; q < end && IsDigit(*q); q++)
+          e = std::min(e*10 + (*q - '0'), 100000);
+        exp10 += expNegative ? -e : e;
+        p = q;
+      }
+    }
+
+    double value = double(mantissa);
+    if(mantissa != 0)
+      value = (exp10 < 0) ? value / Pow10(-exp10) : value * Pow10(exp10);
+    a_res = float(negative ? -value : value);
+    return p;
+  }
+
+  static const char* ParseInt(const char* p, const char* end, int64_t& a_res)
   {
-    return lhs.vertex_index == rhs.vertex_index &&
-           lhs.normal_index == rhs.normal_index &&
-           lhs.texcoord_index == rhs.texcoord_index;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+      negative = (*p++ == '-');
+    if(p >= end || !IsDigit(*p))
+      return nullptr;
+    int64_t value = 0;
+    for(; p < end && IsDigit(*p); p++)
+      value = std::min<int64_t>(value*10 + (*p - '0'), INT64_C(1) << 40);
+    a_res = negative ? -value : value;
+    return p;
   }
+
+  // 1-based OBJ index to 0-based; negative ones count back from the last element seen so far in the chunk
+  //
+  static inline int32_t ResolveIndex(int64_t a_index, size_t a_localNum, bool& a_relative)
+  {
+    a_relative = (a_index < 0);
+    if(a_index > 0)
+      return int32_t(std::min<int64_t>(a_index - 1, INT32_MAX));
+    if(a_index < 0)
+      return int32_t(std::max<int64_t>(int64_t(a_localNum) + a_index, INT32_MIN + 1));
+    return OBJ_NO_INDEX;
+  }
+
+  static void ParseFace(const char* p, const char* end, ObjChunk& a_chunk)
+  {
+    const size_t firstCorner = a_chunk.corners.size();
+    const size_t localNum[3] = {a_chunk.pos.size()/3, a_chunk.uv.size()/2, a_chunk.norm.size()/3};
+
+    while(true)
+    {
+      p = SkipSpaces(p, end);
+      int64_t   raw[3] = {0, 0, 0};
+      const char* q = ParseInt(p, end, raw[0]);
+      if(q == nullptr)
+        break;
+      if(q < end && *q == '/')
+      {
+        q++;
+        if(q < end && *q != '/')
+          q = ParseInt(q, end, raw[1]);
+        if(q != nullptr && q < end && *q == '/')
+          q = ParseInt(q + 1, end, raw[2]);
+        if(q == nullptr)
+          break;
+      }
+      p = q;
+
+      int32_t res[3];
+      for(int k = 0; k < 3; k++)
+      {
+        bool relative = false;
+        res[k] = ResolveIndex(raw[k], localNum[k], relative);
+        if(relative)
+          a_chunk.relative.push_back(uint32_t(a_chunk.corners.size()*3 + k));
+      }
+      a_chunk.corners.push_back({res[0], res[1], res[2]});
+    }
+
+    const size_t cornersNum = a_chunk.corners.size() - firstCorner;
+    if(cornersNum < 3) // degenerated face
+    {
+      while(!a_chunk.relative.empty() && a_chunk.relative.back() >= firstCorner*3)
+        a_chunk.relative.pop_back();
+      a_chunk.corners.resize(firstCorner);
+      return;
+    }
+
+    a_chunk.faceSizes.push_back(uint32_t(cornersNum));
+    a_chunk.faceMaterials.push_back(a_chunk.lastMaterial);
+  }
+
+  static void ParseObjLine(const char* p, const char* end, ObjChunk& a_chunk)
+  {
+    if(p >= end)
+      return;
+
+    const size_t len = size_t(end - p);
+    if(p[0] == 'v' && len > 1)
+    {
+      int count = 0;
+      std::vector<float>* dst = nullptr;
+      const char* q = p + 2;
+      if(IsSpace(p[1]))     { dst = &a_chunk.pos;  count = 3; q = p + 1; }
+      else if(p[1] == 'n')  { dst = &a_chunk.norm; count = 3; }
+      else if(p[1] == 't')  { dst = &a_chunk.uv;   count = 2; }
+      if(dst == nullptr || (q < end && !IsSpace(*q)))
+        return;
+      for(int k = 0; k < count; k++)
+      {
+        float value = 0.0f;
+        const char* next = (q == nullptr) ? nullptr : ParseFloat(q, end, value);
+        dst->push_back(value); // missing components are zero, e.g. 'vt u'
+        q = next;
+      }
+    }
+    else if(p[0] == 'f' && len > 1 && IsSpace(p[1]))
+      ParseFace(p + 1, end, a_chunk);
+    else if(len > 7 && std::strncmp(p, "usemtl", 6) == 0 && IsSpace(p[6]))
+    {
+      const char* nameBegin = SkipSpaces(p + 6, end);
+      const std::string name(nameBegin, TrimRight(nameBegin, end));
+      auto it = std::find(a_chunk.materialNames.begin(), a_chunk.materialNames.end(), name);
+      a_chunk.lastMaterial = int32_t(it - a_chunk.materialNames.begin());
+      if(it == a_chunk.materialNames.end())
+        a_chunk.materialNames.push_back(name);
+    }
+    else if(len > 7 && std::strncmp(p, "mtllib", 6) == 0 && IsSpace(p[6]))
+    {
+      const char* q = p + 6;
+      while(true)
+      {
+        q = SkipSpaces(q, end);
+        const char* nameEnd = q;
+        while(nameEnd < end && !IsSpace(*nameEnd))
+          nameEnd++;
+        if(nameEnd == q)
+          break;
+        a_chunk.mtlLibs.emplace_back(q, nameEnd);
+        q = nameEnd;
+      }
+    }
+  }
+
+  static void ParseObjChunk(const char* a_begin, const char* a_end, ObjChunk& a_chunk)
+  {
+    const char* p = a_begin;
+    while(p < a_end)
+    {
+      const char* eol = (const char*)std::memchr(p, '\n', size_t(a_end - p));
+      if(eol == nullptr)
+        eol = a_end;
+      ParseObjLine(SkipSpaces(p, eol), eol, a_chunk);
+      p = eol + 1;
+    }
+  }
+
+  // material ids are positions of 'newmtl' in .mtl files, in order of 'mtllib' statements
+  //
+  static std::unordered_map<std::string, int32_t> ReadMaterialIds(const std::vector<std::string>& a_libs, const std::string& a_baseDir, bool aVerbose)
+  {
+    std::unordered_map<std::string, int32_t> res;
+    for(const std::string& lib : a_libs)
+    {
+      const std::string path = a_baseDir + lib;
+      std::ifstream input(path);
+      if(!input.is_open())
+      {
+        if(aVerbose)
+          printf("[LoadMeshFromObj::WARNING] Material file %s not found\n", path.c_str());
+        continue;
+      }
+      std::string line;
+      while(std::getline(input, line))
+      {
+        const char* begin = SkipSpaces(line.data(), line.data() + line.size());
+        const char* end   = TrimRight(begin, line.data() + line.size());
+        if(end - begin > 7 && std::strncmp(begin, "newmtl", 6) == 0 && IsSpace(begin[6]))
+        {
+          const char* nameBegin = SkipSpaces(begin + 6, end);
+          res.emplace(std::string(nameBegin, end), int32_t(res.size()));
+        }
+      }
+    }
+    return res;
+  }
+
+  static inline size_t NextLine(const char* a_data, size_t a_pos, size_t a_size)
+  {
+    if(a_pos >= a_size)
+      return a_size;
+    const char* eol = (const char*)std::memchr(a_data + a_pos, '\n', a_size - a_pos);
+    return (eol == nullptr) ? a_size : size_t(eol - a_data) + 1;
+  }
+
+  // folder with .mtl files, the folder of the .obj itself by default
+  //
+  static std::string MtlBaseDir(const char* a_fileName, const char* a_mtlBaseDir)
+  {
+    std::string baseDir;
+    if(a_mtlBaseDir != nullptr)
+    {
+      baseDir = a_mtlBaseDir;
+      if(!baseDir.empty() && baseDir.back() != '/' && baseDir.back() != '\\')
+        baseDir += '/';
+    }
+    else
+    {
+      const std::string path(a_fileName);
+      const size_t slash = path.find_last_of("/\\");
+      baseDir = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+    }
+    return baseDir;
+  }
+
+  static inline IndexTriple ToIndexTriple(const ObjCorner& a_corner, size_t a_posNum, size_t a_uvNum, size_t a_normNum)
+  {
+    IndexTriple res;
+    res.i0 = (a_corner.v  >= 0 && size_t(a_corner.v)  < a_posNum)  ? uint32_t(a_corner.v)  : DEDUP_NO_INDEX;
+    res.i1 = (a_corner.vt >= 0 && size_t(a_corner.vt) < a_uvNum)   ? uint32_t(a_corner.vt) : DEDUP_NO_INDEX;
+    res.i2 = (a_corner.vn >= 0 && size_t(a_corner.vn) < a_normNum) ? uint32_t(a_corner.vn) : DEDUP_NO_INDEX;
+    return res;
+  }
+
+  // (0,1,2),(0,2,3) or (0,1,3),(1,2,3) by the shorter diagonal, the same choice as tinyobjloader makes
+  //
+  static inline bool SplitQuadAt02(const IndexTriple* a_face, const float* a_pos)
+  {
+    for(int k = 0; k < 4; k++)
+      if(a_face[k].i0 == DEDUP_NO_INDEX)
+        return true;
+    float d02 = 0.0f, d13 = 0.0f;
+    for(int k = 0; k < 3; k++)
+    {
+      const float a = a_pos[size_t(a_face[2].i0)*3 + k] - a_pos[size_t(a_face[0].i0)*3 + k];
+      const float b = a_pos[size_t(a_face[3].i0)*3 + k] - a_pos[size_t(a_face[1].i0)*3 + k];
+      d02 += a*a;
+      d13 += b*b;
+    }
+    return d02 < d13;
+  }
+
+  // quads are split by the shorter diagonal, larger polygons are fanned; triangles with absent positions are skipped and counted.
+  // Negative materials become 0
+  //
+  static void TriangulateFaces(const IndexTriple* a_corners, const uint32_t* a_faceSizes, const int32_t* a_faceMaterials, size_t a_facesNum, const float* a_pos,
+                               std::vector<IndexTriple>& a_tris, std::vector<unsigned>& a_triMaterials, size_t& a_skipped)
+  {
+    auto addTriangle = [&](const IndexTriple& a, const IndexTriple& b, const IndexTriple& c, int32_t mat) {
+      if(a.i0 == DEDUP_NO_INDEX || b.i0 == DEDUP_NO_INDEX || c.i0 == DEDUP_NO_INDEX)
+      {
+        a_skipped++;
+        return;
+      }
+      a_tris.push_back(a);
+      a_tris.push_back(b);
+      a_tris.push_back(c);
+      a_triMaterials.push_back(mat < 0 ? 0u : unsigned(mat));
+    };
+
+    size_t first = 0;
+    for(size_t f = 0; f < a_facesNum; f++)
+    {
+      const IndexTriple* face = a_corners + first;
+      const uint32_t     n    = a_faceSizes[f];
+      const int32_t      mat  = a_faceMaterials[f];
+      if(n == 4)
+      {
+        const bool at02 = SplitQuadAt02(face, a_pos);
+        addTriangle(face[0], face[1], face[at02 ? 2 : 3], mat);
+        addTriangle(face[at02 ? 0 : 1], face[2], face[3], mat);
+      }
+      else // triangle or fan of a convex polygon
+      {
+        for(uint32_t k = 1; k + 1 < n; k++)
+          addTriangle(face[0], face[k], face[k + 1], mat);
+      }
+      first += n;
+    }
+  }
+
+  // for meshes made of quads only; quads with absent positions are skipped and counted. Negative materials become 0
+  //
+  static void CopyQuadFaces(const IndexTriple* a_corners, const int32_t* a_faceMaterials, size_t a_facesNum,
+                            std::vector<IndexTriple>& a_quads, std::vector<unsigned>& a_quadMaterials, size_t& a_skipped)
+  {
+    for(size_t f = 0; f < a_facesNum; f++)
+    {
+      const IndexTriple* face = a_corners + f*4;
+      if(face[0].i0 == DEDUP_NO_INDEX || face[1].i0 == DEDUP_NO_INDEX || face[2].i0 == DEDUP_NO_INDEX || face[3].i0 == DEDUP_NO_INDEX)
+      {
+        a_skipped++;
+        continue;
+      }
+      a_quads.insert(a_quads.end(), face, face + 4);
+      a_quadMaterials.push_back(a_faceMaterials[f] < 0 ? 0u : unsigned(a_faceMaterials[f]));
+    }
+  }
+
+  static SimpleMesh ParseObjFile(const char* a_fileName, bool aVerbose, const char* a_mtlBaseDir, bool a_keepQuads);
 };
 
-struct TinyObjIndexHasher
+cmesh4::SimpleMesh cmesh4::LoadMeshFromObj(const char* a_fileName, bool aVerbose, const char* a_mtlBaseDir, MeshCache* a_cache, bool a_keepQuads)
 {
-  size_t operator()(const tinyobj::index_t &index) const
+  if(a_cache == nullptr || !a_cache->Enabled())
+    return ParseObjFile(a_fileName, aVerbose, a_mtlBaseDir, a_keepQuads);
+
+  // material ids come from .mtl files looked up in a_mtlBaseDir, so it is a part of the key; edits of .mtl files are not tracked
+  //
+  const std::string sourceKey = a_cache->Key(a_fileName);
+  if(sourceKey.empty())
+    return ParseObjFile(a_fileName, aVerbose, a_mtlBaseDir, a_keepQuads);
+  const std::string key = MeshCache::SubKey(sourceKey, std::string(a_keepQuads ? "objq:" : "obj:") + (a_mtlBaseDir == nullptr ? "" : a_mtlBaseDir));
+
+  SimpleMesh mesh;
+  if(a_cache->Load(key, mesh))
+    return mesh;
+
+  mesh = ParseObjFile(a_fileName, aVerbose, a_mtlBaseDir, a_keepQuads);
+  a_cache->Store(key, mesh);
+  return mesh;
+}
+
+cmesh4::SimpleMesh cmesh4::ParseObjFile(const char* a_fileName, bool aVerbose, const char* a_mtlBaseDir, bool a_keepQuads)
+{
+  SimpleMesh mesh;
+
+  MappedFile file;
+  if(!file.Open(a_fileName))
   {
-    return ((std::hash<int>()(index.vertex_index) ^
-            (std::hash<int>()(index.normal_index) << 1)) >> 1) ^
-            (std::hash<int>()(index.texcoord_index) << 1);
+    printf("[LoadMeshFromObj::ERROR] Failed to load obj file: can't open %s\n", a_fileName);
+    return mesh;
   }
-};
+
+  // (1) parse line aligned chunks in parallel
+  //
+  const char*  data = (const char*)file.Data();
+  const size_t size = file.Size();
+
+  std::vector<size_t> bounds = {0};
+  while(bounds.back() < size)
+    bounds.push_back(NextLine(data, std::min(bounds.back() + OBJ_CHUNK_SIZE, size) - 1, size));
+
+  const size_t chunksNum = bounds.size() - 1;
+  std::vector<ObjChunk> chunks(chunksNum);
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+    ParseObjChunk(data + bounds[c], data + bounds[c + 1], chunks[c]);
+
+  // (2) prefix sums over chunks, global material ids
+  //
+  struct ChunkOffsets { size_t pos, uv, norm, primitives; int32_t startMaterial; std::vector<int32_t> materials; };
+  std::vector<ChunkOffsets> offsets(chunksNum);
+
+  std::vector<std::string> mtlLibs;
+  for(const ObjChunk& chunk : chunks)
+    for(const std::string& lib : chunk.mtlLibs)
+      if(std::find(mtlLibs.begin(), mtlLibs.end(), lib) == mtlLibs.end())
+        mtlLibs.push_back(lib);
+
+  const auto materialIds = ReadMaterialIds(mtlLibs, MtlBaseDir(a_fileName, a_mtlBaseDir), aVerbose);
+
+  size_t posNum = 0, uvNum = 0, normNum = 0;
+  int32_t material = OBJ_NO_INDEX;
+  for(size_t c = 0; c < chunksNum; c++)
+  {
+    offsets[c].pos           = posNum;
+    offsets[c].uv            = uvNum;
+    offsets[c].norm          = normNum;
+    offsets[c].startMaterial = material;
+    for(const std::string& name : chunks[c].materialNames)
+    {
+      auto it = materialIds.find(name);
+      offsets[c].materials.push_back(it == materialIds.end() ? OBJ_NO_INDEX : it->second);
+    }
+    if(chunks[c].lastMaterial != OBJ_INHERIT_MATERIAL)
+      material = offsets[c].materials[chunks[c].lastMaterial];
+
+    posNum  += chunks[c].pos.size()/3;
+    uvNum   += chunks[c].uv.size()/2;
+    normNum += chunks[c].norm.size()/3;
+  }
+
+  // (3) merge attributes, then resolve indices and triangulate faces of every chunk in parallel (or copy them if all faces are quads)
+  //
+  bool keepQuads = a_keepQuads;
+  for(size_t c = 0; c < chunksNum && keepQuads; c++)
+    keepQuads = std::all_of(chunks[c].faceSizes.begin(), chunks[c].faceSizes.end(), [](uint32_t n) { return n == 4; });
+  if(a_keepQuads && !keepQuads && aVerbose)
+    printf("[LoadMeshFromObj::INFO] Not all faces are quads, mesh is triangulated\n");
+
+  const size_t points = keepQuads ? SimpleMesh::POINTS_IN_QUAD : SimpleMesh::POINTS_IN_TRIANGLE;
+  mesh.topology = keepQuads ? SimpleMesh::SIMPLE_MESH_QUADS : SimpleMesh::SIMPLE_MESH_TRIANGLES;
+
+  std::vector<float> pos(posNum*3), uv(uvNum*2), norm(normNum*3);
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+  {
+    std::copy(chunks[c].pos.begin(),  chunks[c].pos.end(),  pos.begin()  + offsets[c].pos*3);
+    std::copy(chunks[c].uv.begin(),   chunks[c].uv.end(),   uv.begin()   + offsets[c].uv*2);
+    std::copy(chunks[c].norm.begin(), chunks[c].norm.end(), norm.begin() + offsets[c].norm*3);
+    std::vector<float>().swap(chunks[c].pos);
+    std::vector<float>().swap(chunks[c].uv);
+    std::vector<float>().swap(chunks[c].norm);
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+  {
+    ObjChunk& chunk = chunks[c];
+    const size_t base[3] = {offsets[c].pos, offsets[c].uv, offsets[c].norm};
+    for(uint32_t r : chunk.relative)
+    {
+      int32_t& idx = IndexOf(chunk.corners[r/3], r%3);
+      idx = int32_t(int64_t(idx) + int64_t(base[r%3]));
+    }
+
+    std::vector<IndexTriple> corners(chunk.corners.size());
+    for(size_t i = 0; i < corners.size(); i++)
+      corners[i] = ToIndexTriple(chunk.corners[i], posNum, uvNum, normNum);
+    std::vector<ObjCorner>().swap(chunk.corners);
+
+    for(int32_t& mat : chunk.faceMaterials)
+      mat = (mat == OBJ_INHERIT_MATERIAL) ? offsets[c].startMaterial : offsets[c].materials[mat];
+
+    if(keepQuads)
+      CopyQuadFaces(corners.data(), chunk.faceMaterials.data(), chunk.faceSizes.size(), chunk.tris, chunk.triMaterials, chunk.skipped);
+    else
+      TriangulateFaces(corners.data(), chunk.faceSizes.data(), chunk.faceMaterials.data(), chunk.faceSizes.size(), pos.data(),
+                       chunk.tris, chunk.triMaterials, chunk.skipped);
+  }
+
+  size_t primNum = 0, skipped = 0;
+  for(size_t c = 0; c < chunksNum; c++)
+  {
+    offsets[c].primitives = primNum;
+    primNum += chunks[c].triMaterials.size();
+    skipped += chunks[c].skipped;
+  }
+  if(skipped > 0 && aVerbose)
+    printf("[LoadMeshFromObj::WARNING] %zu %s with invalid vertex index are skipped\n", skipped, keepQuads ? "quads" : "triangles");
+
+  std::vector<IndexTriple> corners(primNum*points);
+  mesh.matIndices.resize(primNum);
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int64_t c = 0; c < int64_t(chunksNum); c++)
+  {
+    std::copy(chunks[c].tris.begin(), chunks[c].tris.end(), corners.begin() + offsets[c].primitives*points);
+    std::copy(chunks[c].triMaterials.begin(), chunks[c].triMaterials.end(), mesh.matIndices.begin() + offsets[c].primitives);
+  }
+  chunks.clear();
+
+  // (4) unique vertices in order of first use, corners are keyed by their packed (position, texcoord, normal) indices
+  //
+  std::vector<uint32_t> firsts;
+  const size_t vertNum = DedupIndexTriples(corners.data(), corners.size(), mesh.indices, firsts);
+
+  const bool has_texcoords = (uvNum > 0); // untextured meshes get neither texture coordinates nor tangents
+  mesh.vPos4f.resize(vertNum);
+  mesh.vNorm4f.resize(vertNum);
+  mesh.vTexCoord2f.resize(has_texcoords ? vertNum : 0);
+
+  int64_t missingNormals = 0;
+
+  #pragma omp parallel for reduction(+:missingNormals)
+  for(int64_t i = 0; i < int64_t(vertNum); i++)
+  {
+    const IndexTriple& corner = corners[firsts[i]];
+    mesh.vPos4f[i] = float4(pos[size_t(corner.i0)*3 + 0], pos[size_t(corner.i0)*3 + 1], pos[size_t(corner.i0)*3 + 2], 1.0f);
+    if(corner.i2 != DEDUP_NO_INDEX)
+      mesh.vNorm4f[i] = float4(norm[corner.i2*3 + 0], norm[corner.i2*3 + 1], norm[corner.i2*3 + 2], 0.0f);
+    else
+    {
+      mesh.vNorm4f[i] = float4(0, 0, 1, 0);
+      missingNormals++;
+    }
+    if(has_texcoords)
+      mesh.vTexCoord2f[i] = (corner.i1 != DEDUP_NO_INDEX) ? float2(uv[corner.i1*2 + 0], uv[corner.i1*2 + 1]) : float2(0, 0);
+  }
+  // vertices without normal in the file get computed ones, the rest keep normals from the file
+  //
+  if (missingNormals > 0)
+  {
+    const std::vector<float4> fileNormals = mesh.vNorm4f;
+    ComputeNormals(mesh, NORMALS_ANGLE_WEIGHTED);
+    if (size_t(missingNormals) < vertNum)
+    {
+      #pragma omp parallel for
+      for(int64_t i = 0; i < int64_t(vertNum); i++)
+        if(corners[firsts[i]].i2 != DEDUP_NO_INDEX)
+          mesh.vNorm4f[i] = fileNormals[i];
+    }
+  }
+  if (has_texcoords)
+    ComputeTangents(mesh);
+
+  if (aVerbose)
+  {
+    printf("[LoadMeshFromObj::INFO] Loaded obj file %s with %d vertices and %d indices\n",
+            a_fileName, (unsigned)mesh.vPos4f.size(), (unsigned)mesh.indices.size());
+  }
+
+  return mesh;
+}
 
 namespace cmesh4
 {
-  SimpleMesh LoadMeshFromObj(const char* a_fileName, bool aVerbose, const char* a_mtlBaseDir)
+  static constexpr size_t OBJ_COPY_BUFFER_SIZE = size_t(16) << 20;
+
+  // temporary file of ConvertObjToVSGF, written sequentially and removed in destructor
+  //
+  struct ObjSpillFile
   {
-    SimpleMesh mesh;
+    ~ObjSpillFile() { Remove(); }
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    
-    std::string warn;
-    std::string err;
+    bool Create(const std::string& a_path)
+    {
+      path = a_path;
+      file = std::fopen(path.c_str(), "w+b");
+      return file != nullptr;
+    }
 
-    bool loading_result = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, a_fileName, a_mtlBaseDir);
+    bool Write(const void* a_data, size_t a_size)
+    {
+      bytes += a_size;
+      return a_size == 0 || std::fwrite(a_data, 1, a_size, file) == a_size;
+    }
+
+    template<typename T> bool Write(const std::vector<T>& a_data) { return Write(a_data.data(), a_data.size()*sizeof(T)); }
+
+    bool Rewind() { return std::fflush(file) == 0 && std::fseek(file, 0, SEEK_SET) == 0; }
 
-    if (!loading_result)
+    template<typename T> bool Read(std::vector<T>& a_data, size_t a_count)
     {
-      printf("[LoadMeshFromObj::ERROR] Failed to load obj file: %s\n", err.c_str());
-      return mesh;
+      a_data.resize(a_count);
+      return a_count == 0 || std::fread(a_data.data(), sizeof(T), a_count, file) == a_count;
     }
 
-    if (aVerbose)
+    void Close()
     {
-      if (warn.empty())
-        printf("[LoadMeshFromObj::INFO] Loaded obj file: %s\n", a_fileName);
-      else
-        printf("[LoadMeshFromObj::WARNING] Loaded obj file %s with warnings: %s\n", a_fileName, warn.c_str());
+      if(file != nullptr)
+        std::fclose(file);
+      file = nullptr;
     }
 
-    const LiteMath::float4 default_norm = float4(0, 0, 1, 0);
-    const LiteMath::float4 default_tangent = float4(1, 0, 0, 0);
-    const LiteMath::float2 default_texcoord = float2(0, 0);
+    void Remove()
+    {
+      Close();
+      if(!path.empty())
+        std::remove(path.c_str());
+      path.clear();
+    }
 
-    std::unordered_map<tinyobj::index_t, uint32_t, TinyObjIndexHasher, TinyObjIndexEqual> uniqueVertIndices = {};
+    std::string path;
+    std::FILE*  file  = nullptr;
+    uint64_t    bytes = 0;
+  };
 
-    uint32_t numIndices = 0;
-    for (const auto& shape : shapes)
-      numIndices += shape.mesh.indices.size();
+  struct ObjFaceRecord
+  {
+    uint32_t size;
+    int32_t  material; ///< index of usemtl name in order of appearance, OBJ_NO_INDEX before the first one
+  };
 
-    mesh.vPos4f.reserve(attrib.vertices.size() / 3);
-    mesh.vNorm4f.reserve(attrib.vertices.size() / 3);
-    mesh.vTang4f.reserve(attrib.vertices.size() / 3);
-    mesh.vTexCoord2f.reserve(attrib.vertices.size() / 3);
-    mesh.indices.reserve(numIndices);
+  static bool AppendFile(std::FILE* a_out, ObjSpillFile& a_spill, std::vector<char>& a_buffer)
+  {
+    if(!a_spill.Rewind())
+      return false;
+    while(true)
+    {
+      const size_t got = std::fread(a_buffer.data(), 1, a_buffer.size(), a_spill.file);
+      if(got == 0)
+        return std::ferror(a_spill.file) == 0;
+      if(std::fwrite(a_buffer.data(), 1, got, a_out) != got)
+        return false;
+    }
+  }
+
+  static bool ConvertObjToVSGFImpl(const char* a_objFile, const char* a_vsgfFile, const ObjConvertOptions& a_options, std::FILE* a_input, std::FILE* a_out);
+};
+
+bool cmesh4::ConvertObjToVSGF(const char* a_objFile, const char* a_vsgfFile, const ObjConvertOptions& a_options)
+{
+  std::FILE* input = std::fopen(a_objFile, "rb");
+  if(input == nullptr)
+  {
+    printf("[ConvertObjToVSGF::ERROR] Can't open %s\n", a_objFile);
+    return false;
+  }
+  std::FILE* out = std::fopen(a_vsgfFile, "wb");
+  if(out == nullptr)
+  {
+    printf("[ConvertObjToVSGF::ERROR] Can't open %s for writing\n", a_vsgfFile);
+    std::fclose(input);
+    return false;
+  }
+
+  const bool ok = ConvertObjToVSGFImpl(a_objFile, a_vsgfFile, a_options, input, out);
+  std::fclose(input);
+  if(std::fclose(out) != 0 || !ok)
+  {
+    std::remove(a_vsgfFile);
+    return false;
+  }
+  return true;
+}
+
+bool cmesh4::ConvertObjToVSGFImpl(const char* a_objFile, const char* a_vsgfFile, const ObjConvertOptions& a_options, std::FILE* a_input, std::FILE* a_out)
+{
+  std::string tempPrefix = a_vsgfFile;
+  if(!a_options.tempFolder.empty())
+  {
+    const size_t slash = tempPrefix.find_last_of("/\\");
+    tempPrefix = a_options.tempFolder + "/" + ((slash == std::string::npos) ? tempPrefix : tempPrefix.substr(slash + 1));
+  }
 
-    for (const auto& shape : shapes)
+  ObjSpillFile posSpill, uvSpill, normSpill, cornerSpill, faceSpill;
+  ObjSpillFile vertNormSpill, vertUVSpill, indexSpill, matSpill;
+  std::pair<ObjSpillFile*, const char*> spills[] = {{&posSpill, "pos"}, {&uvSpill, "uv"}, {&normSpill, "norm"}, {&cornerSpill, "corners"}, {&faceSpill, "faces"},
+                                                    {&vertNormSpill, "vnorm"}, {&vertUVSpill, "vuv"}, {&indexSpill, "indices"}, {&matSpill, "mat"}};
+  for(auto& spill : spills)
+  {
+    if(!spill.first->Create(tempPrefix + "." + spill.second + ".tmp"))
+    {
+      printf("[ConvertObjToVSGF::ERROR] Can't create temporary file %s\n", spill.first->path.c_str());
+      return false;
+    }
+  }
+
+  // (1) read the text in line aligned windows, parse every window in parallel chunks and spill attributes and faces with global indices
+  //
+  std::error_code ec;
+  const uintmax_t fileSize    = std::filesystem::file_size(a_objFile, ec);
+  const size_t    windowBytes = std::max<size_t>(a_options.windowBytes, size_t(1) << 16);
+  std::vector<char> window(ec ? windowBytes : size_t(std::min<uintmax_t>(windowBytes, fileSize + 1))); // +1 to see the end of file in one read
+
+  std::unordered_map<std::string, int32_t> materialNameIds;
+  std::vector<std::string> materialNames, mtlLibs;
+  int32_t currMaterial = OBJ_NO_INDEX;
+  size_t  posNum = 0, uvNum = 0, normNum = 0, facesNum = 0, cornersNum = 0, missingNormals = 0;
+  size_t  filled = 0;
+
+  while(true)
+  {
+    filled += std::fread(window.data() + filled, 1, window.size() - filled, a_input);
+    const bool eof = (filled < window.size());
+    if(std::ferror(a_input))
     {
-      mesh.matIndices.insert(std::end(mesh.matIndices), std::begin(shape.mesh.material_ids), std::end(shape.mesh.material_ids));
+      printf("[ConvertObjToVSGF::ERROR] Failed to read %s\n", a_objFile);
+      return false;
+    }
 
-      for (const auto& index : shape.mesh.indices)
+    size_t end = filled;
+    if(!eof)
+    {
+      while(end > 0 && window[end - 1] != '\n')
+        end--;
+      if(end == 0)
       {
-        uint32_t my_index = 0;
-        auto it = uniqueVertIndices.find(index);
-        if (it != uniqueVertIndices.end())
-        {
-          my_index = it->second;
-        }
-        else
-        {
-          uniqueVertIndices.insert({index, static_cast<uint32_t>(mesh.vPos4f.size())});
-          my_index = static_cast<uint32_t>(mesh.vPos4f.size());
-
-          assert(index.vertex_index >= 0 && index.vertex_index < attrib.vertices.size() / 3);
-          mesh.vPos4f.push_back({attrib.vertices[3 * index.vertex_index + 0],
-                                 attrib.vertices[3 * index.vertex_index + 1],
-                                 attrib.vertices[3 * index.vertex_index + 2],
-                                 1.0f});
-          if(index.normal_index >= 0)
-          {
-            mesh.vNorm4f.push_back({attrib.normals[3 * index.normal_index + 0],
-                                    attrib.normals[3 * index.normal_index + 1],
-                                    attrib.normals[3 * index.normal_index + 2],
-                                    0.0f});
-          }
-          else
-          {
-            mesh.vNorm4f.push_back(default_norm);
-          }
-          if(index.texcoord_index >= 0)
-          {
-            mesh.vTexCoord2f.push_back({attrib.texcoords[2 * index.texcoord_index + 0],
-                                        attrib.texcoords[2 * index.texcoord_index + 1]});
-          }
-          else
-          {
-            mesh.vTexCoord2f.push_back(default_texcoord);
-          }
-          mesh.vTang4f.push_back(default_tangent);
-        }
+        printf("[ConvertObjToVSGF::ERROR] Line longer than window of %zu bytes in %s\n", window.size(), a_objFile);
+        return false;
+      }
+    }
+
+    std::vector<size_t> bounds = {0};
+    while(bounds.back() < end)
+      bounds.push_back(NextLine(window.data(), std::min(bounds.back() + OBJ_CHUNK_SIZE, end) - 1, end));
+
+    std::vector<ObjChunk> chunks(bounds.size() - 1);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int64_t c = 0; c < int64_t(chunks.size()); c++)
+      ParseObjChunk(window.data() + bounds[c], window.data() + bounds[c + 1], chunks[c]);
 
-        mesh.indices.push_back(my_index);
+    for(ObjChunk& chunk : chunks)
+    {
+      const size_t base[3] = {posNum, uvNum, normNum};
+      for(uint32_t r : chunk.relative)
+      {
+        int32_t& idx = IndexOf(chunk.corners[r/3], r%3);
+        const int64_t resolved = int64_t(idx) + int64_t(base[r%3]);
+        idx = (resolved > INT32_MAX) ? OBJ_NO_INDEX : int32_t(resolved);
+      }
+      for(const ObjCorner& corner : chunk.corners)
+        missingNormals += (corner.vn < 0);
+
+      std::vector<int32_t> ids(chunk.materialNames.size());
+      for(size_t i = 0; i < ids.size(); i++)
+      {
+        auto it = materialNameIds.emplace(chunk.materialNames[i], int32_t(materialNames.size())).first;
+        if(it->second == int32_t(materialNames.size()))
+          materialNames.push_back(chunk.materialNames[i]);
+        ids[i] = it->second;
+      }
+
+      std::vector<ObjFaceRecord> faces(chunk.faceSizes.size());
+      for(size_t f = 0; f < faces.size(); f++)
+      {
+        if(chunk.faceMaterials[f] != OBJ_INHERIT_MATERIAL)
+          currMaterial = ids[chunk.faceMaterials[f]];
+        faces[f] = {chunk.faceSizes[f], currMaterial};
+      }
+      if(chunk.lastMaterial != OBJ_INHERIT_MATERIAL)
+        currMaterial = ids[chunk.lastMaterial];
+
+      for(const std::string& lib : chunk.mtlLibs)
+        if(std::find(mtlLibs.begin(), mtlLibs.end(), lib) == mtlLibs.end())
+          mtlLibs.push_back(lib);
+
+      if(!posSpill.Write(chunk.pos) || !uvSpill.Write(chunk.uv) || !normSpill.Write(chunk.norm) || !cornerSpill.Write(chunk.corners) || !faceSpill.Write(faces))
+      {
+        printf("[ConvertObjToVSGF::ERROR] Failed to write temporary files\n");
+        return false;
       }
+      posNum     += chunk.pos.size()/3;
+      uvNum      += chunk.uv.size()/2;
+      normNum    += chunk.norm.size()/3;
+      facesNum   += faces.size();
+      cornersNum += chunk.corners.size();
     }
 
-    // fix material id
-    for (unsigned &mid : mesh.matIndices) 
-    { 
-      if(mid == uint32_t(-1)) 
-        mid = 0;
+    std::memmove(window.data(), window.data() + end, filled - end);
+    filled -= end;
+    if(eof)
+      break;
+  }
+  std::vector<char>().swap(window);
+
+  if(posNum > size_t(INT32_MAX))
+  {
+    printf("[ConvertObjToVSGF::ERROR] Too many vertices (%zu) in %s\n", posNum, a_objFile);
+    return false;
+  }
+
+  const auto materialIds = ReadMaterialIds(mtlLibs, MtlBaseDir(a_objFile, a_options.mtlBaseDir), a_options.verbose);
+  std::vector<int32_t> materialOfName(materialNames.size());
+  for(size_t i = 0; i < materialNames.size(); i++)
+  {
+    auto it = materialIds.find(materialNames[i]);
+    materialOfName[i] = (it == materialIds.end()) ? OBJ_NO_INDEX : it->second;
+  }
+
+  // (2) attributes are read through memory mappings, faces are triangulated and deduplicated in windows;
+  //     positions go directly to the output after the header that is written when all counts are known
+  //
+  posSpill.Close();
+  uvSpill.Close();
+  normSpill.Close();
+  MappedFile posFile, uvFile, normFile;
+  if((posNum  > 0 && !posFile.Open(posSpill.path.c_str())) ||
+     (uvNum   > 0 && !uvFile.Open(uvSpill.path.c_str()))   ||
+     (normNum > 0 && !normFile.Open(normSpill.path.c_str())))
+  {
+    printf("[ConvertObjToVSGF::ERROR] Can't map temporary files\n");
+    return false;
+  }
+  const float* pos  = (const float*)posFile.Data();
+  const float* uv   = (const float*)uvFile.Data();
+  const float* norm = (const float*)normFile.Data();
+
+  const bool hasNormals   = (missingNormals == 0 && cornersNum > 0);
+  const bool hasTexCoords = (uvNum > 0);
+
+  Header header = {};
+  if(std::fwrite(&header, sizeof(Header), 1, a_out) != 1 || !cornerSpill.Rewind() || !faceSpill.Rewind())
+  {
+    printf("[ConvertObjToVSGF::ERROR] Failed to write %s\n", a_vsgfFile);
+    return false;
+  }
+
+  const size_t windowCorners = std::max<size_t>(windowBytes/128, 1024);
+  uint64_t vertNum = 0, trisNum = 0, skipped = 0, windowsNum = 0;
+
+  std::vector<ObjFaceRecord> faces;
+  std::vector<ObjCorner>     objCorners;
+  std::vector<IndexTriple>   corners, tris;
+  std::vector<uint32_t>      faceSizes, ids, firsts;
+  std::vector<int32_t>       faceMaterials;
+  std::vector<unsigned>      triMaterials;
+
+  for(size_t faceBegin = 0; faceBegin < facesNum; windowsNum++)
+  {
+    const size_t windowFaces = std::min(facesNum - faceBegin, std::max<size_t>(windowCorners/4, 1));
+    size_t windowCornersNum  = 0;
+    bool   readOk = faceSpill.Read(faces, windowFaces);
+    faceSizes.resize(windowFaces);
+    faceMaterials.resize(windowFaces);
+    for(size_t f = 0; readOk && f < windowFaces; f++)
+    {
+      faceSizes[f]      = faces[f].size;
+      faceMaterials[f]  = (faces[f].material < 0) ? OBJ_NO_INDEX : materialOfName[faces[f].material];
+      windowCornersNum += faces[f].size;
     }
+    readOk = readOk && cornerSpill.Read(objCorners, windowCornersNum);
+    if(!readOk)
+    {
+      printf("[ConvertObjToVSGF::ERROR] Failed to read temporary files\n");
+      return false;
+    }
+    faceBegin += windowFaces;
+
+    corners.resize(windowCornersNum);
+    for(size_t i = 0; i < windowCornersNum; i++)
+      corners[i] = ToIndexTriple(objCorners[i], posNum, uvNum, normNum);
 
-    if (aVerbose)
+    tris.clear();
+    triMaterials.clear();
+    size_t windowSkipped = 0;
+    TriangulateFaces(corners.data(), faceSizes.data(), faceMaterials.data(), windowFaces, pos, tris, triMaterials, windowSkipped);
+    skipped += windowSkipped;
+
+    const uint32_t uniqueNum = DedupIndexTriples(tris.data(), tris.size(), ids, firsts);
+    if(vertNum + uniqueNum > uint64_t(UINT32_MAX))
     {
-      printf("[LoadMeshFromObj::INFO] Loaded obj file %s with %d vertices and %d indices\n", 
-              a_fileName, (unsigned)mesh.vPos4f.size(), (unsigned)mesh.indices.size());
+      printf("[ConvertObjToVSGF::ERROR] Too many vertices for VSGF in %s\n", a_objFile);
+      return false;
     }
 
-    return mesh;
+    std::vector<float4> vPos4f(uniqueNum), vNorm4f(hasNormals ? uniqueNum : 0);
+    std::vector<float2> vTexCoord2f(hasTexCoords ? uniqueNum : 0);
+
+    #pragma omp parallel for
+    for(int64_t i = 0; i < int64_t(uniqueNum); i++)
+    {
+      const IndexTriple& corner = tris[firsts[i]];
+      vPos4f[i] = float4(pos[size_t(corner.i0)*3 + 0], pos[size_t(corner.i0)*3 + 1], pos[size_t(corner.i0)*3 + 2], 1.0f);
+      if(hasNormals)
+        vNorm4f[i] = (corner.i2 != DEDUP_NO_INDEX) ? float4(norm[size_t(corner.i2)*3 + 0], norm[size_t(corner.i2)*3 + 1], norm[size_t(corner.i2)*3 + 2], 0.0f) : float4(0, 0, 1, 0);
+      if(hasTexCoords)
+        vTexCoord2f[i] = (corner.i1 != DEDUP_NO_INDEX) ? float2(uv[size_t(corner.i1)*2 + 0], uv[size_t(corner.i1)*2 + 1]) : float2(0, 0);
+    }
+
+    for(uint32_t& id : ids)
+      id += uint32_t(vertNum);
+
+    const bool writeOk = std::fwrite(vPos4f.data(), sizeof(float4), vPos4f.size(), a_out) == vPos4f.size() &&
+                         vertNormSpill.Write(vNorm4f) && vertUVSpill.Write(vTexCoord2f) && indexSpill.Write(ids) && matSpill.Write(triMaterials);
+    if(!writeOk)
+    {
+      printf("[ConvertObjToVSGF::ERROR] Failed to write %s\n", a_vsgfFile);
+      return false;
+    }
+    vertNum += uniqueNum;
+    trisNum += triMaterials.size();
+  }
+
+  if(trisNum*3 > uint64_t(UINT32_MAX))
+  {
+    printf("[ConvertObjToVSGF::ERROR] Too many indices for VSGF in %s\n", a_objFile);
+    return false;
+  }
+
+  // (3) the rest of channels in the order of SaveMeshToVSGF, then the header
+  //
+  std::vector<char> buffer(OBJ_COPY_BUFFER_SIZE);
+  bool appendOk = true;
+  if(hasNormals)
+    appendOk = appendOk && AppendFile(a_out, vertNormSpill, buffer);
+  if(hasTexCoords)
+    appendOk = appendOk && AppendFile(a_out, vertUVSpill, buffer);
+  appendOk = appendOk && AppendFile(a_out, indexSpill, buffer) && AppendFile(a_out, matSpill, buffer);
+
+  const uint32_t attribs = (hasNormals ? SimpleMesh::ATTR_NORMAL : 0) | (hasTexCoords ? SimpleMesh::ATTR_TEXCOORD : 0);
+  header.verticesNum     = uint32_t(vertNum);
+  header.indicesNum      = uint32_t(trisNum*3);
+  header.materialsNum    = uint32_t(trisNum);
+  header.flags           = VSGFFlagsFromAttributes(attribs);
+  header.fileSizeInBytes = sizeof(Header) + vertNum*sizeof(float4) + (hasNormals ? vertNum*sizeof(float4) : 0) + (hasTexCoords ? vertNum*sizeof(float2) : 0) +
+                           trisNum*4*sizeof(uint32_t);
+
+  if(!appendOk || std::fseek(a_out, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(Header), 1, a_out) != 1)
+  {
+    printf("[ConvertObjToVSGF::ERROR] Failed to write %s\n", a_vsgfFile);
+    return false;
+  }
+
+  if(skipped > 0 && a_options.verbose)
+    printf("[ConvertObjToVSGF::WARNING] %zu triangles with invalid vertex index are skipped\n", size_t(skipped));
+  if(a_options.verbose)
+  {
+    printf("[ConvertObjToVSGF::INFO] Converted %s to %s: %u vertices, %u triangles in %zu windows%s\n", a_objFile, a_vsgfFile,
+           header.verticesNum, header.materialsNum, size_t(windowsNum), hasNormals ? "" : ", no normals");
   }
+  return true;
 }
-#endif
\ No newline at end of file
+#endif
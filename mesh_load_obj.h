@@ -4,7 +4,27 @@
 
 namespace cmesh4
 {
-  SimpleMesh LoadMeshFromObj(const char* a_fileName, bool aVerbose = false, const char* a_mtlBaseDir = nullptr);
+  class MeshCache;
+
+  // with a_cache the converted mesh is taken from the cache if the file was loaded before, see mesh_cache.h.
+  // With a_keepQuads a file made of quads only gives SimpleMesh::SIMPLE_MESH_QUADS mesh, otherwise faces are triangulated
+  //
+  SimpleMesh LoadMeshFromObj(const char* a_fileName, bool aVerbose = false, const char* a_mtlBaseDir = nullptr, MeshCache* a_cache = nullptr, bool a_keepQuads = false);
+
+  struct ObjConvertOptions
+  {
+    size_t      windowBytes = size_t(256) << 20; ///< text is read and faces are processed in windows of about this size; peak memory is a few times larger
+    std::string tempFolder;                      ///< for spill files; the folder of the output file if empty
+    const char* mtlBaseDir  = nullptr;           ///< see LoadMeshFromObj
+    bool        verbose     = false;
+  };
+
+  // converts .obj to plain .vsgf with bounded memory, for files that do not fit in RAM. Attributes and faces are spilled to
+  // temporary files on the first pass; on the second one faces are triangulated and vertices are merged window by window,
+  // so vertices shared by faces of different windows are duplicated. Normals are written only if all corners have them,
+  // otherwise LoadMeshFromVSGF computes them; tangents are not computed. Returns false on error
+  //
+  bool ConvertObjToVSGF(const char* a_objFile, const char* a_vsgfFile, const ObjConvertOptions& a_options = ObjConvertOptions());
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "mesh_meshlets.h"
+
+#include <cmath>
+#include <cfloat>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+
+namespace cmesh4
+{
+  static constexpr uint32_t MESHLETS_FILE_MAGIC   = 0x4C48534D; // "MSHL"
+  static constexpr uint32_t MESHLETS_FILE_VERSION = 1;
+
+  struct MeshletsFileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t maxVerts;
+    uint32_t maxTris;
+    uint64_t meshletsNum;
+    uint64_t verticesNum;
+    uint64_t trianglesBytes;
+  };
+
+  static void ComputeMeshletBounds(const SimpleMesh& a_mesh, const MeshletMesh& a_res, Meshlet& a_meshlet)
+  {
+    using LiteMath::float3;
+    const uint32_t* verts = a_res.vertices.data() + a_meshlet.vertexOffset;
+    const uint8_t*  tris  = a_res.triangles.data() + a_meshlet.triangleOffset;
+
+    // bounding sphere around the box center
+    //
+    float3 boxMin(+FLT_MAX), boxMax(-FLT_MAX);
+    for(uint32_t i = 0; i < a_meshlet.vertexCount; i++)
+    {
+      const float3 p = LiteMath::to_float3(a_mesh.vPos4f[verts[i]]);
+      boxMin = LiteMath::min(boxMin, p);
+      boxMax = LiteMath::max(boxMax, p);
+    }
+    const float3 center = (boxMin + boxMax)*0.5f;
+    float radius = 0.0f;
+    for(uint32_t i = 0; i < a_meshlet.vertexCount; i++)
+      radius = std::max(radius, LiteMath::length(LiteMath::to_float3(a_mesh.vPos4f[verts[i]]) - center));
+    a_meshlet.boundSphere = LiteMath::to_float4(center, radius);
+
+    // normal cone from geometric normals of triangles
+    //
+    std::vector<float3> normals;
+    std::vector<float3> points;
+    normals.reserve(a_meshlet.triangleCount);
+    points.reserve(a_meshlet.triangleCount);
+    float3 axis(0.0f);
+    for(uint32_t t = 0; t < a_meshlet.triangleCount; t++)
+    {
+      const float3 A = LiteMath::to_float3(a_mesh.vPos4f[verts[tris[t*3 + 0]]]);
+      const float3 B = LiteMath::to_float3(a_mesh.vPos4f[verts[tris[t*3 + 1]]]);
+      const float3 C = LiteMath::to_float3(a_mesh.vPos4f[verts[tris[t*3 + 2]]]);
+      const float3 n = LiteMath::cross(B - A, C - A);
+      const float  len = LiteMath::length(n);
+      if(len <= 0.0f)
+        continue;
+      normals.push_back(n/len);
+      points.push_back(A);
+      axis += n/len;
+    }
+
+    a_meshlet.coneApex       = LiteMath::to_float4(center, 0.0f);
+    a_meshlet.coneAxisCutoff = float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    const float axisLen = LiteMath::length(axis);
+    if(normals.empty() || axisLen <= 0.0f)
+      return;
+    axis = axis/axisLen;
+
+    float minDot = 1.0f;
+    for(const auto& n : normals)
+      minDot = std::min(minDot, LiteMath::dot(n, axis));
+    if(minDot <= 0.1f) // cone of more than ~84 degrees, culling would almost never succeed
+      return;
+
+    // move apex back along the axis, so that all triangle planes are in front of it
+    //
+    float maxT = 0.0f;
+    for(size_t i = 0; i < normals.size(); i++)
+    {
+      const float dn = LiteMath::dot(axis, normals[i]);
+      const float dc = LiteMath::dot(center - points[i], normals[i]);
+      maxT = std::max(maxT, dc/dn);
+    }
+
+    a_meshlet.coneApex       = LiteMath::to_float4(center - axis*maxT, 0.0f);
+    a_meshlet.coneAxisCutoff = LiteMath::to_float4(axis, std::sqrt(1.0f - minDot*minDot));
+  }
+};
+
+cmesh4::MeshletMesh cmesh4::BuildMeshlets(const SimpleMesh& a_mesh, uint32_t a_maxVerts, uint32_t a_maxTris)
+{
+  MeshletMesh res;
+  res.maxVerts = std::min(std::max(a_maxVerts, 3u), MESHLET_MAX_VERTS);
+  res.maxTris  = std::max(a_maxTris, 1u);
+
+  const size_t vertNum = a_mesh.VerticesNum();
+  const TriangleIndices tris(a_mesh);
+  const size_t trisNum = tris.TrianglesNum();
+  const bool   hasMat  = tris.matIndices.size() >= trisNum;
+
+  // local id of a vertex in the current meshlet is valid only if stamp equals to the current meshlet number
+  //
+  std::vector<uint32_t> stamp(vertNum, uint32_t(-1));
+  std::vector<uint8_t>  localId(vertNum, 0);
+
+  res.vertices.reserve(trisNum + trisNum/2);
+  res.triangles.reserve(trisNum*3);
+
+  Meshlet current = {};
+  auto flush = [&]()
+  {
+    if(current.triangleCount == 0)
+      return;
+    res.meshlets.push_back(current);
+    current = {};
+    current.vertexOffset   = uint32_t(res.vertices.size());
+    current.triangleOffset = uint32_t(res.triangles.size());
+  };
+
+  for(size_t t = 0; t < trisNum; t++)
+  {
+    const uint32_t tri[3] = {tris.indices[t*3 + 0], tris.indices[t*3 + 1], tris.indices[t*3 + 2]};
+    if(tri[0] >= vertNum || tri[1] >= vertNum || tri[2] >= vertNum)
+      continue;
+
+    const uint32_t matId = hasMat ? tris.matIndices[t] : 0;
+    if(current.triangleCount > 0 && matId != current.materialId)
+      flush();
+
+    uint32_t newVerts = 0;
+    for(int k = 0; k < 3; k++)
+    {
+      const bool dup = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+      if(stamp[tri[k]] != uint32_t(res.meshlets.size()) && !dup)
+        newVerts++;
+    }
+
+    if(current.vertexCount + newVerts > res.maxVerts || current.triangleCount + 1 > res.maxTris)
+      flush();
+
+    current.materialId = matId;
+    const uint32_t meshletId = uint32_t(res.meshlets.size());
+    for(int k = 0; k < 3; k++)
+    {
+      if(stamp[tri[k]] != meshletId)
+      {
+        stamp[tri[k]]   = meshletId;
+        localId[tri[k]] = uint8_t(current.vertexCount++);
+        res.vertices.push_back(tri[k]);
+      }
+      res.triangles.push_back(localId[tri[k]]);
+    }
+    current.triangleCount++;
+  }
+  flush();
+
+  for(auto& meshlet : res.meshlets)
+    ComputeMeshletBounds(a_mesh, res, meshlet);
+
+  return res;
+}
+
+std::vector<cmesh4::MeshletMesh> cmesh4::BuildMeshlets(const std::vector<const SimpleMesh*>& a_meshes, uint32_t a_maxVerts, uint32_t a_maxTris)
+{
+  std::vector<MeshletMesh> res(a_meshes.size());
+
+  #pragma omp parallel for schedule(dynamic)
+  for(int i = 0; i < int(a_meshes.size()); i++)
+  {
+    if(a_meshes[i] != nullptr)
+      res[i] = BuildMeshlets(*a_meshes[i], a_maxVerts, a_maxTris);
+  }
+
+  return res;
+}
+
+std::string cmesh4::MeshletsPathFor(const std::string& a_vsgfPath)
+{
+  const size_t dot   = a_vsgfPath.find_last_of('.');
+  const size_t slash = a_vsgfPath.find_last_of("/\\");
+  if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return a_vsgfPath + ".meshlets";
+  return a_vsgfPath.substr(0, dot) + ".meshlets";
+}
+
+bool cmesh4::SaveMeshlets(const char* a_fileName, const MeshletMesh& a_meshlets)
+{
+  std::ofstream output(a_fileName, std::ios::binary);
+  if(!output.is_open())
+  {
+    printf("[cmesh4::SaveMeshlets] can't open file %s for writing\n", a_fileName);
+    return false;
+  }
+
+  MeshletsFileHeader header = {};
+  header.magic          = MESHLETS_FILE_MAGIC;
+  header.version        = MESHLETS_FILE_VERSION;
+  header.maxVerts       = a_meshlets.maxVerts;
+  header.maxTris        = a_meshlets.maxTris;
+  header.meshletsNum    = a_meshlets.meshlets.size();
+  header.verticesNum    = a_meshlets.vertices.size();
+  header.trianglesBytes = a_meshlets.triangles.size();
+
+  output.write((const char*)&header, sizeof(MeshletsFileHeader));
+  output.write((const char*)a_meshlets.meshlets.data(),  a_meshlets.meshlets.size()*sizeof(Meshlet));
+  output.write((const char*)a_meshlets.vertices.data(),  a_meshlets.vertices.size()*sizeof(uint32_t));
+  output.write((const char*)a_meshlets.triangles.data(), a_meshlets.triangles.size());
+  return output.good();
+}
+
+cmesh4::MeshletMesh cmesh4::LoadMeshlets(const char* a_fileName)
+{
+  MeshletMesh res;
+  std::ifstream input(a_fileName, std::ios::binary);
+  if(!input.is_open())
+  {
+    printf("[cmesh4::LoadMeshlets] can't open file %s\n", a_fileName);
+    return res;
+  }
+
+  MeshletsFileHeader header = {};
+  input.read((char*)&header, sizeof(MeshletsFileHeader));
+  if(!input.good() || header.magic != MESHLETS_FILE_MAGIC || header.version != MESHLETS_FILE_VERSION)
+  {
+    printf("[cmesh4::LoadMeshlets] %s is not a meshlets file or has unsupported version\n", a_fileName);
+    return res;
+  }
+
+  // counts come from the file, so check them against its size before allocating
+  //
+  const std::streamoff dataBegin = input.tellg();
+  input.seekg(0, std::ios::end);
+  const uint64_t dataSize = uint64_t(input.tellg() - dataBegin);
+  input.seekg(dataBegin);
+  if(header.meshletsNum > dataSize/sizeof(Meshlet) || header.verticesNum > dataSize/sizeof(uint32_t) || header.trianglesBytes > dataSize ||
+     header.meshletsNum*sizeof(Meshlet) + header.verticesNum*sizeof(uint32_t) + header.trianglesBytes > dataSize)
+  {
+    printf("[cmesh4::LoadMeshlets] file %s is truncated\n", a_fileName);
+    return res;
+  }
+  if(header.maxVerts > MESHLET_MAX_VERTS)
+  {
+    printf("[cmesh4::LoadMeshlets] file %s has invalid maxVerts %u\n", a_fileName, header.maxVerts);
+    return res;
+  }
+
+  res.maxVerts = header.maxVerts;
+  res.maxTris  = header.maxTris;
+  res.meshlets.resize(header.meshletsNum);
+  res.vertices.resize(header.verticesNum);
+  res.triangles.resize(header.trianglesBytes);
+  input.read((char*)res.meshlets.data(),  res.meshlets.size()*sizeof(Meshlet));
+  input.read((char*)res.vertices.data(),  res.vertices.size()*sizeof(uint32_t));
+  input.read((char*)res.triangles.data(), res.triangles.size());
+
+  if(!input.good())
+  {
+    printf("[cmesh4::LoadMeshlets] file %s is truncated\n", a_fileName);
+    return MeshletMesh();
+  }
+
+  // ranges must lie inside the arrays and local vertex ids inside the meshlet, consumers index with them directly
+  //
+  for(size_t i = 0; i < res.meshlets.size(); i++)
+  {
+    const Meshlet& meshlet = res.meshlets[i];
+    bool valid = meshlet.vertexCount <= res.maxVerts && meshlet.triangleCount <= res.maxTris &&
+                 uint64_t(meshlet.vertexOffset) + meshlet.vertexCount <= res.vertices.size() &&
+                 uint64_t(meshlet.triangleOffset) + uint64_t(meshlet.triangleCount)*3 <= res.triangles.size();
+    for(uint64_t t = 0; valid && t < uint64_t(meshlet.triangleCount)*3; t++)
+      valid = res.triangles[meshlet.triangleOffset + t] < meshlet.vertexCount;
+    if(!valid)
+    {
+      printf("[cmesh4::LoadMeshlets] file %s has invalid meshlet %zu\n", a_fileName, i);
+      return MeshletMesh();
+    }
+  }
+  return res;
+}
@@ -0,0 +1,48 @@
+#ifndef LITESCENE_MESH_MESHLETS_H_
+#define LITESCENE_MESH_MESHLETS_H_
+#include "cmesh4.h"
+
+#include <string>
+
+namespace cmesh4
+{
+  // small cluster of triangles for mesh shaders and cluster culling;
+  // triangles of a meshlet index its own vertex list, so local indices fit into 8 bits
+  //
+  struct Meshlet
+  {
+    uint32_t vertexOffset;   ///< into MeshletMesh::vertices
+    uint32_t triangleOffset; ///< into MeshletMesh::triangles, in bytes (3 per triangle)
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    uint32_t materialId;     ///< triangles of different materials are never put into the same meshlet
+    uint32_t padding[3];
+
+    float4   boundSphere;    ///< xyz is center, w is radius
+    float4   coneApex;       ///< xyz is apex of the normal cone (w = 0)
+    float4   coneAxisCutoff; ///< xyz is cone axis, w is cutoff: cluster is backfacing if dot(normalize(coneApex - cameraPos), axis) >= cutoff; cutoff = 1 means the cone is too wide
+  };
+
+  struct MeshletMesh
+  {
+    uint32_t maxVerts = 0;
+    uint32_t maxTris  = 0;
+
+    std::vector<Meshlet>  meshlets;
+    std::vector<uint32_t> vertices;  ///< global vertex ids of the source mesh, meshlet after meshlet
+    std::vector<uint8_t>  triangles; ///< local vertex ids, 3 per triangle, meshlet after meshlet
+  };
+
+  static constexpr uint32_t MESHLET_MAX_VERTS = 256; ///< local indices are 8 bit
+
+  // greedy packing of triangles in index buffer order, so it is better to call OptimizeForGPU before
+  //
+  MeshletMesh              BuildMeshlets(const SimpleMesh& a_mesh, uint32_t a_maxVerts = 64, uint32_t a_maxTris = 124);
+  std::vector<MeshletMesh> BuildMeshlets(const std::vector<const SimpleMesh*>& a_meshes, uint32_t a_maxVerts = 64, uint32_t a_maxTris = 124); ///< parallel over meshes
+
+  std::string MeshletsPathFor(const std::string& a_vsgfPath); ///< "dir/mesh.vsgf" -> "dir/mesh.meshlets"
+  bool        SaveMeshlets(const char* a_fileName, const MeshletMesh& a_meshlets);
+  MeshletMesh LoadMeshlets(const char* a_fileName); ///< returns empty MeshletMesh on error
+}
+
+#endif
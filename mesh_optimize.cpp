@@ -0,0 +1,563 @@
+#include "mesh_optimize.h"
+
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <unordered_map>
+
+namespace cmesh4
+{
+  static constexpr uint32_t OPT_INVALID = uint32_t(-1);
+
+  // vertex -> triangles adjacency in CSR form
+  //
+  struct VertexTriangles
+  {
+    std::vector<uint32_t> offsets; // size = vertNum + 1
+    std::vector<uint32_t> tris;
+
+    inline const uint32_t* begin(uint32_t v) const { return tris.data() + offsets[v]; }
+    inline const uint32_t* end  (uint32_t v) const { return tris.data() + offsets[v + 1]; }
+  };
+
+  static VertexTriangles BuildVertexTriangles(const std::vector<unsigned int>& a_indices, size_t a_vertNum)
+  {
+    VertexTriangles res;
+    res.offsets.assign(a_vertNum + 1, 0);
+    for(unsigned int v : a_indices)
+      res.offsets[v + 1]++;
+    for(size_t v = 0; v < a_vertNum; v++)
+      res.offsets[v + 1] += res.offsets[v];
+
+    res.tris.resize(a_indices.size());
+    std::vector<uint32_t> cursor(res.offsets.begin(), res.offsets.end() - 1);
+    for(size_t i = 0; i < a_indices.size(); i++)
+      res.tris[cursor[a_indices[i]]++] = uint32_t(i / 3);
+    return res;
+  }
+
+  // "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", Sander, Nehab, Barczak, 2007
+  //
+  static std::vector<uint32_t> TipsifyTriangleOrder(const std::vector<unsigned int>& a_indices, size_t a_vertNum, uint32_t a_cacheSize)
+  {
+    const size_t trisNum = a_indices.size() / 3;
+    const VertexTriangles adj = BuildVertexTriangles(a_indices, a_vertNum);
+
+    std::vector<uint32_t> live(a_vertNum);
+    for(size_t v = 0; v < a_vertNum; v++)
+      live[v] = adj.offsets[v + 1] - adj.offsets[v];
+
+    std::vector<uint32_t> cacheTime(a_vertNum, 0);
+    std::vector<uint8_t>  emitted(trisNum, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> order;
+    deadEnd.reserve(a_indices.size());
+    order.reserve(trisNum);
+
+    uint32_t time   = a_cacheSize + 1;
+    uint32_t cursor = 0;
+    uint32_t fan    = 0;
+    while(fan < a_vertNum && live[fan] == 0)
+      fan++;
+
+    while(fan < a_vertNum)
+    {
+      candidates.clear();
+      for(const uint32_t* t = adj.begin(fan); t != adj.end(fan); t++)
+      {
+        if(emitted[*t])
+          continue;
+        emitted[*t] = 1;
+        order.push_back(*t);
+
+        for(int k = 0; k < 3; k++)
+        {
+          const uint32_t v = a_indices[(*t)*3 + k];
+          deadEnd.push_back(v);
+          candidates.push_back(v);
+          live[v]--;
+          if(time - cacheTime[v] > a_cacheSize)
+            cacheTime[v] = time++;
+        }
+      }
+
+      // next fanning vertex is the one that stays in cache longest while its remaining triangles are emitted
+      //
+      uint32_t next     = OPT_INVALID;
+      int64_t  bestPrio = -1;
+      for(uint32_t v : candidates)
+      {
+        if(live[v] == 0)
+          continue;
+        int64_t prio = 0;
+        if(int64_t(time) - int64_t(cacheTime[v]) + 2*int64_t(live[v]) <= int64_t(a_cacheSize))
+          prio = int64_t(time) - int64_t(cacheTime[v]);
+        if(prio > bestPrio)
+        {
+          bestPrio = prio;
+          next     = v;
+        }
+      }
+
+      if(next == OPT_INVALID) // dead end, take the most recent vertex with live triangles or just the next one in input order
+      {
+        while(!deadEnd.empty() && next == OPT_INVALID)
+        {
+          const uint32_t v = deadEnd.back();
+          deadEnd.pop_back();
+          if(live[v] > 0)
+            next = v;
+        }
+        while(next == OPT_INVALID && cursor < a_vertNum)
+        {
+          if(live[cursor] > 0)
+            next = cursor;
+          cursor++;
+        }
+      }
+
+      fan = (next == OPT_INVALID) ? uint32_t(a_vertNum) : next;
+    }
+
+    return order;
+  }
+
+  template<typename Vec>
+  static void PermuteVertices(Vec& a_arr, const std::vector<uint32_t>& a_newToOld)
+  {
+    if(a_arr.size() != a_newToOld.size())
+      return;
+    Vec res(a_arr.size());
+    for(size_t i = 0; i < a_newToOld.size(); i++)
+      res[i] = a_arr[a_newToOld[i]];
+    a_arr = std::move(res);
+  }
+
+  static inline uint32_t MaterialOf(const SimpleMesh& a_mesh, uint32_t a_tri)
+  {
+    return a_tri < a_mesh.matIndices.size() ? a_mesh.matIndices[a_tri] : 0u;
+  }
+
+  // stable counting sort of triangle sequence a_order by material; chunks of the sequence are counted and scattered in parallel
+  //
+  static std::vector<uint32_t> StableOrderByMaterial(const SimpleMesh& a_mesh, const std::vector<uint32_t>& a_order, std::vector<MaterialRange>* a_pRanges)
+  {
+    const size_t trisNum = a_order.size();
+
+    // (1) dense ranks of material ids in ascending order
+    //
+    std::vector<uint32_t> materials;
+    std::unordered_map<uint32_t, uint32_t> rankOf;
+    for(size_t i = 0; i < trisNum; i++)
+    {
+      const uint32_t mat = MaterialOf(a_mesh, a_order[i]);
+      if((materials.empty() || materials.back() != mat) && rankOf.emplace(mat, 0).second)
+        materials.push_back(mat);
+    }
+    std::sort(materials.begin(), materials.end());
+    for(size_t r = 0; r < materials.size(); r++)
+      rankOf[materials[r]] = uint32_t(r);
+
+    const size_t ranksNum = materials.size();
+    std::vector<uint32_t> rank(trisNum);
+
+    #pragma omp parallel for
+    for(int64_t i = 0; i < int64_t(trisNum); i++)
+      rank[i] = rankOf.find(MaterialOf(a_mesh, a_order[i]))->second;
+
+    // (2) per chunk histograms -> output offsets, chunk-major inside each material keeps the sort stable
+    //
+    const size_t CHUNK_SIZE = 65536;
+    const size_t chunksNum  = (trisNum + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<uint32_t> offsets(chunksNum*ranksNum, 0);
+
+    #pragma omp parallel for
+    for(int64_t c = 0; c < int64_t(chunksNum); c++)
+    {
+      const size_t end = std::min(trisNum, size_t(c + 1)*CHUNK_SIZE);
+      for(size_t i = size_t(c)*CHUNK_SIZE; i < end; i++)
+        offsets[size_t(c)*ranksNum + rank[i]]++;
+    }
+
+    if(a_pRanges != nullptr)
+      a_pRanges->clear();
+
+    uint32_t running = 0;
+    for(size_t r = 0; r < ranksNum; r++)
+    {
+      const uint32_t first = running;
+      for(size_t c = 0; c < chunksNum; c++)
+      {
+        const uint32_t count = offsets[c*ranksNum + r];
+        offsets[c*ranksNum + r] = running;
+        running += count;
+      }
+      if(a_pRanges != nullptr)
+        a_pRanges->push_back({materials[r], first*3, (running - first)*3});
+    }
+
+    // (3) scatter
+    //
+    std::vector<uint32_t> res(trisNum);
+
+    #pragma omp parallel for
+    for(int64_t c = 0; c < int64_t(chunksNum); c++)
+    {
+      uint32_t* cursor = offsets.data() + size_t(c)*ranksNum;
+      const size_t end = std::min(trisNum, size_t(c + 1)*CHUNK_SIZE);
+      for(size_t i = size_t(c)*CHUNK_SIZE; i < end; i++)
+        res[cursor[rank[i]]++] = a_order[i];
+    }
+
+    return res;
+  }
+
+  // indices must be in range; unreferenced vertices are placed at the end
+  //
+  static void ReorderVerticesByFirstUse(SimpleMesh& a_mesh)
+  {
+    const size_t vertNum = a_mesh.VerticesNum();
+    std::vector<uint32_t> oldToNew(vertNum, OPT_INVALID);
+    std::vector<uint32_t> newToOld;
+    newToOld.reserve(vertNum);
+    for(unsigned int& v : a_mesh.indices)
+    {
+      if(oldToNew[v] == OPT_INVALID)
+      {
+        oldToNew[v] = uint32_t(newToOld.size());
+        newToOld.push_back(v);
+      }
+      v = oldToNew[v];
+    }
+    for(size_t v = 0; v < vertNum; v++)
+    {
+      if(oldToNew[v] == OPT_INVALID)
+      {
+        oldToNew[v] = uint32_t(newToOld.size());
+        newToOld.push_back(uint32_t(v));
+      }
+    }
+
+    PermuteVertices(a_mesh.vPos4f,        newToOld);
+    PermuteVertices(a_mesh.vNorm4f,       newToOld);
+    PermuteVertices(a_mesh.vTang4f,       newToOld);
+    PermuteVertices(a_mesh.vTexCoord2f,   newToOld);
+    PermuteVertices(a_mesh.vTexCoord2f_1, newToOld);
+    PermuteVertices(a_mesh.vColor4f,      newToOld);
+  }
+
+  static bool IndicesInRange(const SimpleMesh& a_mesh, const char* a_funcName)
+  {
+    const size_t vertNum = a_mesh.VerticesNum();
+    for(unsigned int v : a_mesh.indices)
+    {
+      if(v >= vertNum)
+      {
+        printf("[cmesh4::%s] index %u is out of range, mesh is left unchanged\n", a_funcName, v);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // stable LSD radix sort of values by 64 bit keys, 8 bits per pass; chunks are counted and scattered in parallel
+  // like in StableOrderByMaterial, passes where all keys have the same digit are skipped
+  //
+  static void RadixSortByKey(std::vector<uint64_t>& a_keys, std::vector<uint32_t>& a_values)
+  {
+    const size_t   num        = a_keys.size();
+    const size_t   CHUNK_SIZE = 65536;
+    const size_t   chunksNum  = (num + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const uint32_t BUCKETS    = 256;
+
+    std::vector<uint64_t> keys2(num);
+    std::vector<uint32_t> values2(num);
+    std::vector<uint32_t> offsets(chunksNum*BUCKETS);
+
+    for(uint32_t shift = 0; shift < 64; shift += 8)
+    {
+      std::fill(offsets.begin(), offsets.end(), 0u);
+
+      #pragma omp parallel for
+      for(int64_t c = 0; c < int64_t(chunksNum); c++)
+      {
+        uint32_t* hist = offsets.data() + size_t(c)*BUCKETS;
+        const size_t end = std::min(num, size_t(c + 1)*CHUNK_SIZE);
+        for(size_t i = size_t(c)*CHUNK_SIZE; i < end; i++)
+          hist[(a_keys[i] >> shift) & (BUCKETS - 1)]++;
+      }
+
+      uint32_t running = 0;
+      bool     trivial = false;
+      for(uint32_t b = 0; b < BUCKETS; b++)
+      {
+        const uint32_t first = running;
+        for(size_t c = 0; c < chunksNum; c++)
+        {
+          const uint32_t count = offsets[c*BUCKETS + b];
+          offsets[c*BUCKETS + b] = running;
+          running += count;
+        }
+        trivial = trivial || (running - first == num);
+      }
+      if(trivial)
+        continue;
+
+      #pragma omp parallel for
+      for(int64_t c = 0; c < int64_t(chunksNum); c++)
+      {
+        uint32_t* cursor = offsets.data() + size_t(c)*BUCKETS;
+        const size_t end = std::min(num, size_t(c + 1)*CHUNK_SIZE);
+        for(size_t i = size_t(c)*CHUNK_SIZE; i < end; i++)
+        {
+          const uint32_t dst = cursor[(a_keys[i] >> shift) & (BUCKETS - 1)]++;
+          keys2[dst]   = a_keys[i];
+          values2[dst] = a_values[i];
+        }
+      }
+      a_keys.swap(keys2);
+      a_values.swap(values2);
+    }
+  }
+
+  // 21 low bits of a_x to every third bit
+  //
+  static inline uint64_t SpreadBits3(uint32_t a_x)
+  {
+    uint64_t v = a_x & 0x1FFFFF;
+    v = (v | v << 32) & 0x001F00000000FFFFull;
+    v = (v | v << 16) & 0x001F0000FF0000FFull;
+    v = (v | v << 8)  & 0x100F00F00F00F00Full;
+    v = (v | v << 4)  & 0x10C30C30C30C30C3ull;
+    v = (v | v << 2)  & 0x1249249249249249ull;
+    return v;
+  }
+
+  static void PermuteTriangles(SimpleMesh& a_mesh, const std::vector<uint32_t>& a_triOrder)
+  {
+    const size_t trisNum = a_triOrder.size();
+    std::vector<unsigned int> indices(trisNum*3);
+    for(size_t i = 0; i < trisNum; i++)
+      for(int k = 0; k < 3; k++)
+        indices[i*3 + k] = a_mesh.indices[a_triOrder[i]*3 + k];
+    a_mesh.indices = std::move(indices);
+
+    if(a_mesh.matIndices.size() == trisNum)
+    {
+      std::vector<unsigned int> matIndices(trisNum);
+      for(size_t i = 0; i < trisNum; i++)
+        matIndices[i] = a_mesh.matIndices[a_triOrder[i]];
+      a_mesh.matIndices = std::move(matIndices);
+    }
+  }
+};
+
+cmesh4::VertexCacheStats cmesh4::AnalyzeVertexCache(const SimpleMesh& a_mesh, uint32_t a_cacheSize)
+{
+  const TriangleIndices tris(a_mesh);
+  const size_t trisNum = tris.TrianglesNum();
+
+  VertexCacheStats res;
+  const size_t vertNum = a_mesh.VerticesNum();
+  if(trisNum == 0 || vertNum == 0 || a_cacheSize == 0)
+    return res;
+
+  std::vector<uint32_t> cacheTime(vertNum, 0);
+  std::vector<uint8_t>  referenced(vertNum, 0);
+  uint32_t time = a_cacheSize + 1; // FIFO: a vertex is in cache if fewer than a_cacheSize misses happened after it was loaded
+  size_t   misses = 0, referencedNum = 0;
+
+  for(size_t i = 0; i < trisNum*3; i++)
+  {
+    const uint32_t v = tris.indices[i];
+    if(v >= vertNum)
+      continue;
+    if(!referenced[v])
+    {
+      referenced[v] = 1;
+      referencedNum++;
+    }
+    if(time - cacheTime[v] > a_cacheSize)
+    {
+      cacheTime[v] = time++;
+      misses++;
+    }
+  }
+
+  res.acmr = float(misses) / float(trisNum);
+  res.atvr = referencedNum > 0 ? float(misses) / float(referencedNum) : 0.0f;
+  return res;
+}
+
+cmesh4::OptimizeForGPUStats cmesh4::OptimizeForGPU(SimpleMesh& a_mesh, uint32_t a_cacheSize)
+{
+  a_mesh.Triangulate();
+
+  OptimizeForGPUStats stats;
+  stats.before = AnalyzeVertexCache(a_mesh, a_cacheSize);
+
+  const size_t vertNum = a_mesh.VerticesNum();
+  const size_t trisNum = a_mesh.TrianglesNum();
+  if(trisNum == 0 || a_mesh.IndicesNum() != trisNum*3)
+  {
+    stats.after = stats.before;
+    return stats;
+  }
+
+  if(!IndicesInRange(a_mesh, "OptimizeForGPU"))
+  {
+    stats.after = stats.before;
+    return stats;
+  }
+
+  // (1) triangle order
+  //
+  std::vector<uint32_t> triOrder = TipsifyTriangleOrder(a_mesh.indices, vertNum, a_cacheSize);
+  if(!a_mesh.matRanges.empty())
+    triOrder = StableOrderByMaterial(a_mesh, triOrder, &a_mesh.matRanges);
+  PermuteTriangles(a_mesh, triOrder);
+
+  // (2) vertex order of first use
+  //
+  ReorderVerticesByFirstUse(a_mesh);
+
+  stats.after = AnalyzeVertexCache(a_mesh, a_cacheSize);
+  return stats;
+}
+
+void cmesh4::SortTrianglesByMaterial(SimpleMesh& a_mesh)
+{
+  a_mesh.Triangulate();
+  const size_t trisNum = a_mesh.TrianglesNum();
+  if(a_mesh.IndicesNum() != trisNum*3)
+    return;
+
+  std::vector<uint32_t> order(trisNum);
+  for(size_t i = 0; i < trisNum; i++)
+    order[i] = uint32_t(i);
+
+  order = StableOrderByMaterial(a_mesh, order, &a_mesh.matRanges);
+  PermuteTriangles(a_mesh, order);
+}
+
+std::vector<cmesh4::MaterialRange> cmesh4::ComputeMaterialRanges(const SimpleMesh& a_mesh)
+{
+  std::vector<MaterialRange> res;
+  const size_t primNum = a_mesh.PrimitivesNum();
+  const size_t points  = a_mesh.PointsInPrimitive();
+  for(size_t t = 0; t < primNum; t++)
+  {
+    const uint32_t mat = MaterialOf(a_mesh, uint32_t(t));
+    if(res.empty() || res.back().matId != mat)
+      res.push_back({mat, uint32_t(t*points), 0});
+    res.back().indexCount += uint32_t(points);
+  }
+  return res;
+}
+
+uint64_t cmesh4::MortonCode3D(uint32_t a_x, uint32_t a_y, uint32_t a_z)
+{
+  return SpreadBits3(a_x) | (SpreadBits3(a_y) << 1) | (SpreadBits3(a_z) << 2);
+}
+
+// Skilling's transform of coordinates to the transposed Hilbert index ("Programming the Hilbert curve", 2004),
+// bits of the index are then interleaved the same way as in Morton code
+//
+uint64_t cmesh4::HilbertCode3D(uint32_t a_x, uint32_t a_y, uint32_t a_z)
+{
+  uint32_t X[3] = {a_x & 0x1FFFFF, a_y & 0x1FFFFF, a_z & 0x1FFFFF};
+  const uint32_t M = 1u << 20;
+
+  for(uint32_t Q = M; Q > 1; Q >>= 1)
+  {
+    const uint32_t P = Q - 1;
+    for(int i = 0; i < 3; i++)
+    {
+      if(X[i] & Q)
+        X[0] ^= P;
+      else
+      {
+        const uint32_t t = (X[0] ^ X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+
+  X[1] ^= X[0];
+  X[2] ^= X[1];
+  uint32_t t = 0;
+  for(uint32_t Q = M; Q > 1; Q >>= 1)
+    if(X[2] & Q)
+      t ^= Q - 1;
+  for(int i = 0; i < 3; i++)
+    X[i] ^= t;
+
+  return (SpreadBits3(X[0]) << 2) | (SpreadBits3(X[1]) << 1) | SpreadBits3(X[2]);
+}
+
+std::vector<uint32_t> cmesh4::SpaceCurveOrder(const float4* a_points, size_t a_pointsNum, SPACE_CURVE a_curve)
+{
+  // box of finite coordinates only, NaN and infinities go to cell 0 below; sizes are in double to not overflow
+  //
+  double boxMin[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, boxMax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+  for(size_t i = 0; i < a_pointsNum; i++)
+  {
+    for(int k = 0; k < 3; k++)
+    {
+      if(!std::isfinite(a_points[i][k]))
+        continue;
+      boxMin[k] = std::min(boxMin[k], double(a_points[i][k]));
+      boxMax[k] = std::max(boxMax[k], double(a_points[i][k]));
+    }
+  }
+
+  const double GRID_MAX = double((1u << 21) - 1);
+  double scale[3];
+  for(int k = 0; k < 3; k++)
+  {
+    const double size = boxMax[k] - boxMin[k];
+    scale[k] = (size > 0.0) ? GRID_MAX/size : 0.0;
+  }
+
+  std::vector<uint64_t> keys(a_pointsNum);
+  std::vector<uint32_t> order(a_pointsNum);
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < int64_t(a_pointsNum); i++)
+  {
+    uint32_t cell[3];
+    for(int k = 0; k < 3; k++)
+      cell[k] = std::isfinite(a_points[i][k]) ? uint32_t(std::min(std::max((double(a_points[i][k]) - boxMin[k])*scale[k], 0.0), GRID_MAX)) : 0u;
+    keys[i]  = (a_curve == SPACE_CURVE::HILBERT) ? HilbertCode3D(cell[0], cell[1], cell[2]) : MortonCode3D(cell[0], cell[1], cell[2]);
+    order[i] = uint32_t(i);
+  }
+
+  RadixSortByKey(keys, order);
+  return order;
+}
+
+void cmesh4::ReorderAlongCurve(SimpleMesh& a_mesh, SPACE_CURVE a_curve)
+{
+  a_mesh.Triangulate();
+  const size_t trisNum = a_mesh.TrianglesNum();
+  if(trisNum == 0 || a_mesh.IndicesNum() != trisNum*3 || !IndicesInRange(a_mesh, "ReorderAlongCurve"))
+    return;
+
+  std::vector<float4> centroids(trisNum);
+
+  #pragma omp parallel for
+  for(int64_t t = 0; t < int64_t(trisNum); t++)
+  {
+    const unsigned int* tri = a_mesh.indices.data() + t*3;
+    centroids[t] = (a_mesh.vPos4f[tri[0]] + a_mesh.vPos4f[tri[1]] + a_mesh.vPos4f[tri[2]])*(1.0f/3.0f);
+  }
+
+  std::vector<uint32_t> order = SpaceCurveOrder(centroids.data(), trisNum, a_curve);
+  if(!a_mesh.matRanges.empty())
+    order = StableOrderByMaterial(a_mesh, order, &a_mesh.matRanges);
+  PermuteTriangles(a_mesh, order);
+  ReorderVerticesByFirstUse(a_mesh);
+}
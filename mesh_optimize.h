@@ -0,0 +1,54 @@
+#ifndef LITESCENE_MESH_OPTIMIZE_H_
+#define LITESCENE_MESH_OPTIMIZE_H_
+#include "cmesh4.h"
+
+namespace cmesh4
+{
+  // efficiency of the post-transform vertex cache, simulated as FIFO of a_cacheSize entries
+  //
+  struct VertexCacheStats
+  {
+    float acmr = 0.0f; ///< average cache miss ratio, transformed vertices per triangle (0.5 is ideal for large grids, 3 is the worst)
+    float atvr = 0.0f; ///< average transformed to vertex ratio, transformed vertices per referenced vertex (1 is ideal)
+  };
+
+  struct OptimizeForGPUStats
+  {
+    VertexCacheStats before;
+    VertexCacheStats after;
+  };
+
+  VertexCacheStats AnalyzeVertexCache(const SimpleMesh& a_mesh, uint32_t a_cacheSize = 16);
+
+  // reorders triangles for vertex cache locality (Tipsify), then vertices in order of first use for fetch locality;
+  // matIndices are moved together with triangles, unreferenced vertices are placed at the end.
+  // If a_mesh.matRanges is not empty, triangles stay grouped by material and ranges are updated. Quads are triangulated first
+  //
+  OptimizeForGPUStats OptimizeForGPU(SimpleMesh& a_mesh, uint32_t a_cacheSize = 16);
+
+  // stable sort of triangles by material id (ascending), fills a_mesh.matRanges; vertices are not moved, quads are triangulated
+  //
+  void SortTrianglesByMaterial(SimpleMesh& a_mesh);
+
+  // ranges of consecutive triangles (or quads) with equal material id, for meshes sorted earlier (e.g. loaded from file)
+  //
+  std::vector<MaterialRange> ComputeMaterialRanges(const SimpleMesh& a_mesh);
+
+  enum class SPACE_CURVE { MORTON, HILBERT }; ///< Hilbert order has no jumps between distant cells, Morton is cheaper to compute
+
+  // 63 bit curve codes of a point on 2^21 x 2^21 x 2^21 grid
+  //
+  uint64_t MortonCode3D (uint32_t a_x, uint32_t a_y, uint32_t a_z);
+  uint64_t HilbertCode3D(uint32_t a_x, uint32_t a_y, uint32_t a_z);
+
+  // order of points along the curve over their bounding box, codes are sorted with stable parallel radix sort
+  //
+  std::vector<uint32_t> SpaceCurveOrder(const float4* a_points, size_t a_pointsNum, SPACE_CURVE a_curve);
+
+  // reorders triangles (with matIndices) along the curve by their centroids, then vertices in order of first use.
+  // If a_mesh.matRanges is not empty, triangles stay grouped by material and ranges are updated. Quads are triangulated first
+  //
+  void ReorderAlongCurve(SimpleMesh& a_mesh, SPACE_CURVE a_curve = SPACE_CURVE::HILBERT);
+}
+
+#endif
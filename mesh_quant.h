@@ -0,0 +1,136 @@
+#ifndef LITESCENE_MESH_QUANT_H_
+#define LITESCENE_MESH_QUANT_H_
+
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "LiteMath.h"
+
+// quantization helpers shared by compressed mesh storage formats
+//
+namespace cmesh4
+{
+  static constexpr int16_t OCT16_ZERO = -32768; // marks zero length vector, snorm16 values are in [-32767, 32767]
+
+  inline int16_t PackSnorm16(float a_val)
+  {
+    const float v = std::min(std::max(a_val, -1.0f), 1.0f);
+    return int16_t(std::lround(v*32767.0f));
+  }
+
+  inline float UnpackSnorm16(int16_t a_val) { return std::max(float(a_val)/32767.0f, -1.0f); }
+
+  // unit vector to 2 x snorm16 with octahedral mapping, zero vectors are preserved
+  //
+  inline void EncodeOct16(float a_x, float a_y, float a_z, int16_t a_res[2])
+  {
+    const float sum = std::abs(a_x) + std::abs(a_y) + std::abs(a_z);
+    if(sum < 1e-20f)
+    {
+      a_res[0] = OCT16_ZERO;
+      a_res[1] = OCT16_ZERO;
+      return;
+    }
+
+    float u = a_x/sum;
+    float v = a_y/sum;
+    if(a_z < 0.0f)
+    {
+      const float u1 = (1.0f - std::abs(v))*(u >= 0.0f ? 1.0f : -1.0f);
+      const float v1 = (1.0f - std::abs(u))*(v >= 0.0f ? 1.0f : -1.0f);
+      u = u1;
+      v = v1;
+    }
+    a_res[0] = PackSnorm16(u);
+    a_res[1] = PackSnorm16(v);
+  }
+
+  inline LiteMath::float3 DecodeOct16(const int16_t a_enc[2])
+  {
+    if(a_enc[0] == OCT16_ZERO && a_enc[1] == OCT16_ZERO)
+      return LiteMath::float3(0,0,0);
+
+    float x = UnpackSnorm16(a_enc[0]);
+    float y = UnpackSnorm16(a_enc[1]);
+    float z = 1.0f - std::abs(x) - std::abs(y);
+    const float t = std::max(-z, 0.0f);
+    x += (x >= 0.0f) ? -t : t;
+    y += (y >= 0.0f) ? -t : t;
+    const float invLen = 1.0f/std::sqrt(x*x + y*y + z*z);
+    return LiteMath::float3(x*invLen, y*invLen, z*invLen);
+  }
+
+  // value in [a_min, a_min + 1/a_invScale] to unorm16
+  //
+  inline uint16_t QuantizeUnorm16(float a_val, float a_min, float a_invScale)
+  {
+    const float t = std::min(std::max((a_val - a_min)*a_invScale, 0.0f), 1.0f);
+    return uint16_t(std::lround(t*65535.0f));
+  }
+
+  inline float DequantizeUnorm16(uint16_t a_val, float a_min, float a_scale) { return a_min + (float(a_val)/65535.0f)*a_scale; }
+
+  // IEEE 754 binary16 with round to nearest even; overflow goes to infinity, NaN stays NaN
+  //
+  inline uint16_t FloatToHalf(float a_val)
+  {
+    uint32_t f;
+    memcpy(&f, &a_val, sizeof(float));
+    const uint32_t sign = (f >> 16) & 0x8000u;
+    const uint32_t absF = f & 0x7FFFFFFFu;
+
+    if(absF >= 0x7F800000u)                                     // inf or NaN
+      return uint16_t(sign | 0x7C00u | ((absF > 0x7F800000u) ? 0x200u : 0u));
+    if(absF >= 0x477FF000u)                                     // rounds to value above 65504
+      return uint16_t(sign | 0x7C00u);
+    if(absF < 0x38800000u)                                      // half denormal or zero
+    {
+      if(absF < 0x33000000u)
+        return uint16_t(sign);
+      const uint32_t shift = 126u - (absF >> 23);               // 14..24
+      const uint32_t mant  = (absF & 0x7FFFFFu) | 0x800000u;
+      uint32_t res = mant >> shift;
+      const uint32_t rem  = mant & ((1u << shift) - 1u);
+      const uint32_t half = 1u << (shift - 1u);
+      if(rem > half || (rem == half && (res & 1u)))
+        res++;
+      return uint16_t(sign | res);
+    }
+    uint32_t res = ((absF - 0x38000000u) >> 13);                // rebias exponent 127 -> 15
+    const uint32_t rem = absF & 0x1FFFu;
+    if(rem > 0x1000u || (rem == 0x1000u && (res & 1u)))
+      res++;
+    return uint16_t(sign | res);
+  }
+
+  inline float HalfToFloat(uint16_t a_val)
+  {
+    const uint32_t sign = uint32_t(a_val & 0x8000u) << 16;
+    const uint32_t exp  = (a_val >> 10) & 0x1Fu;
+    const uint32_t mant = a_val & 0x3FFu;
+    uint32_t f;
+    if(exp == 0x1Fu)
+      f = sign | 0x7F800000u | (mant << 13);
+    else if(exp != 0)
+      f = sign | ((exp + 112u) << 23) | (mant << 13);
+    else if(mant == 0)
+      f = sign;
+    else                                                        // denormal, normalize it
+    {
+      uint32_t e = 113u, m = mant;
+      while((m & 0x400u) == 0)
+      {
+        m <<= 1;
+        e--;
+      }
+      f = sign | (e << 23) | ((m & 0x3FFu) << 13);
+    }
+    float res;
+    memcpy(&res, &f, sizeof(float));
+    return res;
+  }
+};
+
+#endif
@@ -0,0 +1,527 @@
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace cmesh4
+{
+  static constexpr uint32_t SIMPLIFY_INVALID = uint32_t(-1);
+
+  // symmetric 4x4 matrix of plane quadric: error(p) = p^T A p + 2 b^T p + c
+  //
+  struct Quadric
+  {
+    double xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+    double dx = 0, dy = 0, dz = 0, dd = 0;
+
+    inline void AddPlane(double nx, double ny, double nz, double d)
+    {
+      xx += nx*nx; xy += nx*ny; xz += nx*nz;
+      yy += ny*ny; yz += ny*nz; zz += nz*nz;
+      dx += d*nx;  dy += d*ny;  dz += d*nz;
+      dd += d*d;
+    }
+
+    inline void Add(const Quadric& q)
+    {
+      xx += q.xx; xy += q.xy; xz += q.xz; yy += q.yy; yz += q.yz; zz += q.zz;
+      dx += q.dx; dy += q.dy; dz += q.dz; dd += q.dd;
+    }
+
+    inline double Eval(const float4& p) const
+    {
+      const double x = p.x, y = p.y, z = p.z;
+      const double res = xx*x*x + 2.0*xy*x*y + 2.0*xz*x*z + yy*y*y + 2.0*yz*y*z + zz*z*z + 2.0*(dx*x + dy*y + dz*z) + dd;
+      return std::max(res, 0.0);
+    }
+  };
+
+  struct Collapse
+  {
+    uint32_t from;
+    uint32_t to;
+    double   cost;  ///< surface and seam quadrics, collapses are applied in this order
+    double   error; ///< surface quadrics only
+  };
+
+  static inline LiteMath::float3 TriNormal(const float4& a, const float4& b, const float4& c)
+  {
+    return LiteMath::cross(LiteMath::to_float3(b) - LiteMath::to_float3(a), LiteMath::to_float3(c) - LiteMath::to_float3(a));
+  }
+
+  static constexpr double   SIMPLIFY_SEAM_WEIGHT = 10.0; // of planes that keep attribute seams in place, relative to surface planes
+
+  // vertices with bitwise equal positions form one group. Collapses move whole groups, so meshes split per face corner
+  // (flat shading, per face texture coordinates) stay connected; topology is defined on groups, not on vertices
+  //
+  static uint32_t GroupByPosition(const SimpleMesh& a_mesh, std::vector<uint32_t>& a_groupOf, std::vector<float4>& a_groupPos)
+  {
+    const size_t vertNum = a_mesh.VerticesNum();
+    struct PosKey { uint32_t x, y, z; bool operator==(const PosKey& o) const { return x == o.x && y == o.y && z == o.z; } };
+    struct PosHash { size_t operator()(const PosKey& k) const { return size_t(k.x)*73856093u ^ size_t(k.y)*19349663u ^ size_t(k.z)*83492791u; } };
+    std::unordered_map<PosKey, uint32_t, PosHash> groups;
+    groups.reserve(vertNum);
+    a_groupOf.resize(vertNum);
+    a_groupPos.clear();
+    for(size_t v = 0; v < vertNum; v++)
+    {
+      PosKey key;
+      const float px = a_mesh.vPos4f[v].x + 0.0f, py = a_mesh.vPos4f[v].y + 0.0f, pz = a_mesh.vPos4f[v].z + 0.0f;
+      memcpy(&key.x, &px, sizeof(float));
+      memcpy(&key.y, &py, sizeof(float));
+      memcpy(&key.z, &pz, sizeof(float));
+      auto it = groups.emplace(key, uint32_t(a_groupPos.size())).first;
+      if(it->second == a_groupPos.size())
+        a_groupPos.push_back(a_mesh.vPos4f[v]);
+      a_groupOf[v] = it->second;
+    }
+    return uint32_t(a_groupPos.size());
+  }
+
+  static inline uint64_t EdgeKey(uint32_t a, uint32_t b) { return (uint64_t(std::min(a, b)) << 32) | std::max(a, b); }
+
+  // texture coordinates and colors; normals may differ across an edge of a flat shaded mesh, that is a crease the surface planes keep
+  //
+  static inline bool SameSeamAttributes(const SimpleMesh& a_mesh, uint32_t a, uint32_t b)
+  {
+    const size_t vertNum = a_mesh.VerticesNum();
+    if(a_mesh.vTexCoord2f.size()   == vertNum && memcmp(&a_mesh.vTexCoord2f[a],   &a_mesh.vTexCoord2f[b],   sizeof(float2)) != 0) return false;
+    if(a_mesh.vTexCoord2f_1.size() == vertNum && memcmp(&a_mesh.vTexCoord2f_1[a], &a_mesh.vTexCoord2f_1[b], sizeof(float2)) != 0) return false;
+    if(a_mesh.vColor4f.size()      == vertNum && memcmp(&a_mesh.vColor4f[a],      &a_mesh.vColor4f[b],      sizeof(float4)) != 0) return false;
+    return true;
+  }
+
+  static inline bool SameAttributes(const SimpleMesh& a_mesh, uint32_t a, uint32_t b)
+  {
+    const size_t vertNum = a_mesh.VerticesNum();
+    if(a_mesh.vNorm4f.size() == vertNum && memcmp(&a_mesh.vNorm4f[a], &a_mesh.vNorm4f[b], sizeof(float4)) != 0) return false;
+    if(a_mesh.vTang4f.size() == vertNum && memcmp(&a_mesh.vTang4f[a], &a_mesh.vTang4f[b], sizeof(float4)) != 0) return false;
+    return SameSeamAttributes(a_mesh, a, b);
+  }
+
+  // groups that must not be moved: material boundaries and open borders
+  //
+  static std::vector<uint8_t> FindLockedGroups(const TriangleIndices& a_tris, const std::vector<uint32_t>& a_groupOf, uint32_t a_groupsNum)
+  {
+    const size_t trisNum = a_tris.TrianglesNum();
+    const bool   hasMat  = a_tris.matIndices.size() >= trisNum;
+
+    std::vector<uint8_t>  lockedGroup(a_groupsNum, 0);
+    std::vector<uint32_t> groupMat(a_groupsNum, SIMPLIFY_INVALID);
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    edgeUse.reserve(trisNum*2);
+    for(size_t t = 0; t < trisNum; t++)
+    {
+      const uint32_t g[3] = {a_groupOf[a_tris.indices[t*3 + 0]], a_groupOf[a_tris.indices[t*3 + 1]], a_groupOf[a_tris.indices[t*3 + 2]]};
+      const uint32_t matId = hasMat ? a_tris.matIndices[t] : 0;
+      for(int k = 0; k < 3; k++)
+      {
+        if(groupMat[g[k]] == SIMPLIFY_INVALID)
+          groupMat[g[k]] = matId;
+        else if(groupMat[g[k]] != matId)
+          lockedGroup[g[k]] = 1;
+        edgeUse[EdgeKey(g[k], g[(k + 1) % 3])]++;
+      }
+    }
+
+    for(const auto& [key, count] : edgeUse)
+    {
+      if(count == 1)
+      {
+        lockedGroup[uint32_t(key >> 32)]        = 1;
+        lockedGroup[uint32_t(key & 0xFFFFFFFF)] = 1;
+      }
+    }
+    return lockedGroup;
+  }
+
+  // an edge is a seam if triangles on its sides have different texture coordinates or colors at its ends; returns such edges
+  // as keys of group pairs
+  //
+  static std::unordered_set<uint64_t> FindSeamEdges(const SimpleMesh& a_mesh, const std::vector<unsigned int>& a_indices,
+                                                    const std::vector<uint32_t>& a_groupOf)
+  {
+    struct EdgeCorners { uint32_t v0, v1; }; // vertices at the ends with lower and higher group id
+    std::unordered_map<uint64_t, EdgeCorners> edges;
+    std::unordered_set<uint64_t> seams;
+    edges.reserve(a_indices.size()*2/3);
+    for(size_t i = 0; i < a_indices.size(); i += 3)
+    {
+      for(int k = 0; k < 3; k++)
+      {
+        uint32_t a = a_indices[i + k], b = a_indices[i + (k + 1) % 3];
+        if(a_groupOf[a] > a_groupOf[b])
+          std::swap(a, b);
+        const uint64_t key = EdgeKey(a_groupOf[a], a_groupOf[b]);
+        auto [it, inserted] = edges.emplace(key, EdgeCorners{a, b});
+        if(!inserted && (!SameSeamAttributes(a_mesh, it->second.v0, a) || !SameSeamAttributes(a_mesh, it->second.v1, b)))
+          seams.insert(key);
+      }
+    }
+    return seams;
+  }
+
+  // seam edges get planes orthogonal to their triangles, so moving a seam vertex along a curved seam costs more than along
+  // a straight one
+  //
+  static void AddSeamQuadrics(const SimpleMesh& a_mesh, const std::vector<unsigned int>& a_indices, const std::vector<uint32_t>& a_groupOf,
+                              std::vector<Quadric>& a_seamQuadrics)
+  {
+    const size_t trisNum = a_indices.size()/3;
+    const std::unordered_set<uint64_t> seams = FindSeamEdges(a_mesh, a_indices, a_groupOf);
+
+    const double w = std::sqrt(SIMPLIFY_SEAM_WEIGHT);
+    for(size_t t = 0; t < trisNum; t++)
+    {
+      const uint32_t tri[3] = {a_indices[t*3 + 0], a_indices[t*3 + 1], a_indices[t*3 + 2]};
+      const LiteMath::float3 n = TriNormal(a_mesh.vPos4f[tri[0]], a_mesh.vPos4f[tri[1]], a_mesh.vPos4f[tri[2]]);
+      for(int k = 0; k < 3; k++)
+      {
+        const uint32_t a = tri[k], b = tri[(k + 1) % 3];
+        const uint32_t ga = a_groupOf[a], gb = a_groupOf[b];
+        if(ga == gb || seams.count(EdgeKey(ga, gb)) == 0)
+          continue;
+        const LiteMath::float3 pa = LiteMath::to_float3(a_mesh.vPos4f[a]);
+        const LiteMath::float3 p  = LiteMath::cross(LiteMath::to_float3(a_mesh.vPos4f[b]) - pa, n);
+        const float len = LiteMath::length(p);
+        if(len <= 0.0f)
+          continue;
+        const LiteMath::float3 pn = p/len;
+        Quadric q;
+        q.AddPlane(w*pn.x, w*pn.y, w*pn.z, -w*double(LiteMath::dot(pn, pa)));
+        a_seamQuadrics[ga].Add(q);
+        a_seamQuadrics[gb].Add(q);
+      }
+    }
+  }
+
+  // triangles around each vertex in CSR form (with a_pointsInPrimitive = 1, vertices of each group), rebuilt after every pass
+  //
+  static void BuildAdjacency(const std::vector<unsigned int>& a_indices, size_t a_vertNum, std::vector<uint32_t>& a_offsets, std::vector<uint32_t>& a_tris,
+                             uint32_t a_pointsInPrimitive = 3)
+  {
+    a_offsets.assign(a_vertNum + 1, 0);
+    for(unsigned int v : a_indices)
+      a_offsets[v + 1]++;
+    for(size_t v = 0; v < a_vertNum; v++)
+      a_offsets[v + 1] += a_offsets[v];
+    a_tris.resize(a_indices.size());
+    std::vector<uint32_t> cursor(a_offsets.begin(), a_offsets.end() - 1);
+    for(size_t i = 0; i < a_indices.size(); i++)
+      a_tris[cursor[a_indices[i]]++] = uint32_t(i / a_pointsInPrimitive);
+  }
+};
+
+cmesh4::SimpleMesh cmesh4::SimplifyMesh(const SimpleMesh& a_mesh, const SimplifyOptions& a_options, float* a_pOutError)
+{
+  if(a_pOutError != nullptr)
+    *a_pOutError = 0.0f;
+  auto unchanged = [&a_mesh]() {
+    SimpleMesh res = a_mesh;
+    res.Triangulate();
+    return res;
+  };
+
+  const TriangleIndices tris(a_mesh); // vertices are read from a_mesh, so quads are not copied whole
+  const size_t vertNum = a_mesh.VerticesNum();
+  const size_t trisNum = tris.TrianglesNum();
+  if(trisNum == 0 || tris.indices.size() != trisNum*3)
+    return unchanged();
+  for(unsigned int v : tris.indices)
+    if(v >= vertNum)
+      return unchanged();
+
+  const LiteMath::Box4f box = a_mesh.GetAABB();
+  const double diagonal = std::max(double(LiteMath::length(LiteMath::to_float3(box.boxMax) - LiteMath::to_float3(box.boxMin))), 1e-20);
+  const double maxCost  = (a_options.maxError >= FLT_MAX) ? DBL_MAX : (double(a_options.maxError)*diagonal)*(double(a_options.maxError)*diagonal);
+  const size_t target   = (a_options.targetTriangles != 0) ? a_options.targetTriangles : size_t(double(trisNum)*double(a_options.targetRatio));
+
+  std::vector<uint32_t> groupOf;
+  std::vector<float4>   groupPos; // collapses move groups to positions of other groups, so these never change
+  const uint32_t groupsNum = GroupByPosition(a_mesh, groupOf, groupPos);
+  const std::vector<uint8_t> locked = FindLockedGroups(tris, groupOf, groupsNum);
+
+  std::vector<Quadric> quadrics(groupsNum);
+  for(size_t t = 0; t < trisNum; t++)
+  {
+    const uint32_t A = tris.indices[t*3 + 0], B = tris.indices[t*3 + 1], C = tris.indices[t*3 + 2];
+    const LiteMath::float3 n = TriNormal(a_mesh.vPos4f[A], a_mesh.vPos4f[B], a_mesh.vPos4f[C]);
+    const float len = LiteMath::length(n);
+    if(len <= 0.0f)
+      continue;
+    const LiteMath::float3 nn = n/len;
+    const double d = -double(LiteMath::dot(nn, LiteMath::to_float3(a_mesh.vPos4f[A])));
+    Quadric q;
+    q.AddPlane(nn.x, nn.y, nn.z, d);
+    quadrics[groupOf[A]].Add(q);
+    quadrics[groupOf[B]].Add(q);
+    quadrics[groupOf[C]].Add(q);
+  }
+  std::vector<Quadric> seamQuadrics(groupsNum);
+  AddSeamQuadrics(a_mesh, tris.indices, groupOf, seamQuadrics);
+
+  // seams are found once and then follow collapses: a vertex moved without a survivor keeps its texture coordinates and must
+  // not make a new seam
+  //
+  std::unordered_set<uint64_t> seams = FindSeamEdges(a_mesh, tris.indices, groupOf);
+
+  std::vector<unsigned int> indices    = tris.indices;
+  std::vector<unsigned int> matIndices = tris.matIndices;
+  const bool hasMat = matIndices.size() >= trisNum;
+
+  std::vector<uint32_t> adjOffsets, adjTris, groupOffsets, groupVerts;
+  std::vector<Collapse> collapses;
+  std::vector<uint8_t>  touched(groupsNum);
+  std::vector<uint32_t> seamEdges(groupsNum); // per group
+  std::vector<uint32_t> collapsedTo(groupsNum);
+  std::vector<uint32_t> remap(vertNum);
+  double maxAppliedCost = 0.0;
+  size_t curTris        = trisNum;
+
+  while(curTris > target)
+  {
+    BuildAdjacency(indices, vertNum, adjOffsets, adjTris);
+    BuildAdjacency(groupOf, groupsNum, groupOffsets, groupVerts, 1); // vertices of every group
+
+    // groups on a seam may only slide along it, groups where seams meet stay
+    //
+    std::fill(seamEdges.begin(), seamEdges.end(), 0);
+    for(uint64_t key : seams)
+    {
+      seamEdges[uint32_t(key >> 32)]++;
+      seamEdges[uint32_t(key & 0xFFFFFFFF)]++;
+    }
+
+    collapses.clear();
+    for(size_t t = 0; t < indices.size()/3; t++)
+    {
+      for(int k = 0; k < 3; k++)
+      {
+        const uint32_t a = groupOf[indices[t*3 + k]];
+        const uint32_t b = groupOf[indices[t*3 + (k + 1) % 3]];
+        const bool seamEdge = seams.count(EdgeKey(a, b)) != 0;
+        if(!locked[a] && (seamEdges[a] == 0 || (seamEdge && seamEdges[a] <= 2)))
+          collapses.push_back({a, b, 0.0, 0.0});
+        if(!locked[b] && (seamEdges[b] == 0 || (seamEdge && seamEdges[b] <= 2)))
+          collapses.push_back({b, a, 0.0, 0.0});
+      }
+    }
+
+    #pragma omp parallel for if(collapses.size() >= 65536)
+    for(int64_t i = 0; i < int64_t(collapses.size()); i++)
+    {
+      Collapse& c = collapses[i];
+      Quadric q = quadrics[c.from];
+      q.Add(quadrics[c.to]);
+      Quadric seam = seamQuadrics[c.from];
+      seam.Add(seamQuadrics[c.to]);
+      c.error = q.Eval(groupPos[c.to]);
+      c.cost  = c.error + seam.Eval(groupPos[c.to]);
+    }
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+      return x.cost < y.cost || (x.cost == y.cost && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+    });
+
+    std::fill(touched.begin(), touched.end(), 0);
+    for(uint32_t g = 0; g < groupsNum; g++)
+      collapsedTo[g] = g;
+    for(size_t v = 0; v < vertNum; v++)
+      remap[v] = uint32_t(v);
+
+    size_t applied = 0;
+    for(const auto& c : collapses)
+    {
+      if(curTris <= target)
+        break;
+      if(c.error > maxCost || touched[c.from] || touched[c.to])
+        continue;
+
+      // reject collapses that flip triangles around group 'from'
+      //
+      bool   flips   = false;
+      size_t removed = 0;
+      for(uint32_t j = groupOffsets[c.from]; j < groupOffsets[c.from + 1] && !flips; j++)
+      {
+        const uint32_t v = groupVerts[j];
+        for(uint32_t i = adjOffsets[v]; i < adjOffsets[v + 1] && !flips; i++)
+        {
+          const uint32_t t = adjTris[i];
+          const uint32_t g[3] = {groupOf[indices[t*3 + 0]], groupOf[indices[t*3 + 1]], groupOf[indices[t*3 + 2]]};
+          if(g[0] == c.to || g[1] == c.to || g[2] == c.to)
+          {
+            removed++;
+            continue;
+          }
+          float4 p[3], q[3];
+          for(int k = 0; k < 3; k++)
+          {
+            p[k] = groupPos[g[k]];
+            q[k] = (g[k] == c.from) ? groupPos[c.to] : p[k];
+          }
+          const LiteMath::float3 n0 = TriNormal(p[0], p[1], p[2]);
+          const LiteMath::float3 n1 = TriNormal(q[0], q[1], q[2]);
+          if(LiteMath::dot(n0, n1) <= 0.0f)
+            flips = true;
+        }
+      }
+      if(flips || removed == 0)
+        continue;
+
+      // a vertex of 'from' is merged into a vertex of 'to' it shares a triangle with (half-edge collapse, attributes of the
+      // survivor are kept) or into one with equal attributes; otherwise it keeps its attributes and moves to the position of 'to'
+      //
+      for(uint32_t j = groupOffsets[c.from]; j < groupOffsets[c.from + 1]; j++)
+      {
+        const uint32_t v = groupVerts[j];
+        uint32_t survivor = SIMPLIFY_INVALID;
+        for(uint32_t i = adjOffsets[v]; i < adjOffsets[v + 1] && survivor == SIMPLIFY_INVALID; i++)
+        {
+          const uint32_t t = adjTris[i];
+          for(int k = 0; k < 3; k++)
+            if(groupOf[indices[t*3 + k]] == c.to)
+              survivor = indices[t*3 + k];
+        }
+        for(uint32_t i = groupOffsets[c.to]; i < groupOffsets[c.to + 1] && survivor == SIMPLIFY_INVALID; i++)
+          if(SameAttributes(a_mesh, v, groupVerts[i]))
+            survivor = groupVerts[i];
+
+        if(survivor != SIMPLIFY_INVALID)
+          remap[v] = survivor;
+        groupOf[v] = c.to;
+      }
+      quadrics[c.to].Add(quadrics[c.from]);
+      seamQuadrics[c.to].Add(seamQuadrics[c.from]);
+      collapsedTo[c.from] = c.to;
+      curTris -= removed;
+      maxAppliedCost = std::max(maxAppliedCost, c.error);
+      applied++;
+
+      // neighbourhood of 'from' changes, so it can't take part in other collapses of this pass
+      //
+      for(uint32_t j = groupOffsets[c.from]; j < groupOffsets[c.from + 1]; j++)
+      {
+        const uint32_t v = groupVerts[j];
+        for(uint32_t i = adjOffsets[v]; i < adjOffsets[v + 1]; i++)
+        {
+          const uint32_t t = adjTris[i];
+          touched[groupOf[indices[t*3 + 0]]] = 1;
+          touched[groupOf[indices[t*3 + 1]]] = 1;
+          touched[groupOf[indices[t*3 + 2]]] = 1;
+        }
+      }
+      touched[c.from] = 1;
+    }
+
+    if(applied == 0)
+      break;
+
+    std::unordered_set<uint64_t> movedSeams;
+    movedSeams.reserve(seams.size());
+    for(uint64_t key : seams)
+    {
+      const uint32_t a = collapsedTo[uint32_t(key >> 32)], b = collapsedTo[uint32_t(key & 0xFFFFFFFF)];
+      if(a != b)
+        movedSeams.insert(EdgeKey(a, b));
+    }
+    seams.swap(movedSeams);
+
+    // apply collapses and remove triangles degenerate by position
+    //
+    size_t newTris = 0;
+    for(size_t t = 0; t < indices.size()/3; t++)
+    {
+      const uint32_t A = remap[indices[t*3 + 0]], B = remap[indices[t*3 + 1]], C = remap[indices[t*3 + 2]];
+      if(groupOf[A] == groupOf[B] || groupOf[B] == groupOf[C] || groupOf[A] == groupOf[C])
+        continue;
+      indices[newTris*3 + 0] = A;
+      indices[newTris*3 + 1] = B;
+      indices[newTris*3 + 2] = C;
+      if(hasMat)
+        matIndices[newTris] = matIndices[t];
+      newTris++;
+    }
+    indices.resize(newTris*3);
+    if(hasMat)
+      matIndices.resize(newTris);
+    curTris = newTris;
+  }
+
+  // compact vertices, keeping their original order
+  //
+  std::vector<uint32_t> newId(vertNum, SIMPLIFY_INVALID);
+  size_t newVertNum = 0;
+  for(unsigned int v : indices)
+    newId[v] = 0;
+  for(size_t v = 0; v < vertNum; v++)
+    if(newId[v] != SIMPLIFY_INVALID)
+      newId[v] = uint32_t(newVertNum++);
+
+  SimpleMesh res;
+  auto compact = [&](const auto& a_src, auto& a_dst)
+  {
+    if(a_src.size() != vertNum)
+      return;
+    a_dst.resize(newVertNum);
+    for(size_t v = 0; v < vertNum; v++)
+      if(newId[v] != SIMPLIFY_INVALID)
+        a_dst[newId[v]] = a_src[v];
+  };
+  compact(a_mesh.vPos4f,        res.vPos4f);
+  for(size_t v = 0; v < vertNum; v++)
+    if(newId[v] != SIMPLIFY_INVALID)
+      res.vPos4f[newId[v]] = groupPos[groupOf[v]]; // moved vertices
+  compact(a_mesh.vNorm4f,       res.vNorm4f);
+  compact(a_mesh.vTang4f,       res.vTang4f);
+  compact(a_mesh.vTexCoord2f,   res.vTexCoord2f);
+  compact(a_mesh.vTexCoord2f_1, res.vTexCoord2f_1);
+  compact(a_mesh.vColor4f,      res.vColor4f);
+
+  res.indices.resize(indices.size());
+  for(size_t i = 0; i < indices.size(); i++)
+    res.indices[i] = newId[indices[i]];
+  res.matIndices = hasMat ? std::move(matIndices) : std::vector<unsigned int>(indices.size()/3, 0);
+  if(!a_mesh.matRanges.empty()) // triangle order is preserved, so they are still grouped by material
+    res.matRanges = ComputeMaterialRanges(res);
+
+  if(a_pOutError != nullptr)
+    *a_pOutError = float(std::sqrt(maxAppliedCost)/diagonal);
+  return res;
+}
+
+std::vector<cmesh4::MeshLODLevel> cmesh4::BuildLODChain(const SimpleMesh& a_mesh, const LODChainOptions& a_options)
+{
+  std::vector<MeshLODLevel> res;
+  res.reserve(a_options.maxLods); // 'prev' points into res
+  const SimpleMesh* prev = &a_mesh;
+  float prevError        = 0.0f;
+
+  for(uint32_t level = 0; level < a_options.maxLods; level++)
+  {
+    const size_t target = size_t(double(prev->TrianglesNum())*double(a_options.ratio));
+    if(target < a_options.minTriangles || prevError >= a_options.maxError)
+      break;
+
+    SimplifyOptions options;
+    options.targetTriangles = target;
+    options.maxError        = a_options.maxError - prevError;
+
+    MeshLODLevel lod;
+    lod.mesh  = SimplifyMesh(*prev, options, &lod.error);
+    lod.error += prevError;
+
+    // stop if simplification got stuck on locked features or error limit
+    //
+    if(lod.mesh.TrianglesNum() == 0 || double(lod.mesh.TrianglesNum()) > 0.9*double(prev->TrianglesNum()))
+      break;
+
+    prevError = lod.error;
+    res.push_back(std::move(lod));
+    prev = &res.back().mesh;
+  }
+
+  return res;
+}
@@ -0,0 +1,42 @@
+#ifndef LITESCENE_MESH_SIMPLIFY_H_
+#define LITESCENE_MESH_SIMPLIFY_H_
+#include "cmesh4.h"
+
+#include <cfloat>
+
+namespace cmesh4
+{
+  // Quadric error metric simplification with half-edge collapses: all vertices at one position are moved to a neighbour position,
+  // so surviving vertices keep their original attributes. Split vertices (flat shading, texture seams) move together and stay
+  // connected; vertices on seams of texture coordinates and colors only slide along them. Vertices on material
+  // boundaries and on open borders are never removed, so these features are preserved exactly.
+  //
+  struct SimplifyOptions
+  {
+    float  targetRatio     = 0.5f;    ///< fraction of triangles to keep
+    size_t targetTriangles = 0;       ///< if not 0, used instead of targetRatio
+    float  maxError        = FLT_MAX; ///< stop when the next collapse moves surface further than this, relative to bounding box diagonal
+  };
+
+  SimpleMesh SimplifyMesh(const SimpleMesh& a_mesh, const SimplifyOptions& a_options, float* a_pOutError = nullptr); ///< a_pOutError gets relative error of the result
+
+  struct LODChainOptions
+  {
+    uint32_t maxLods      = 4;    ///< not counting the source mesh
+    float    ratio        = 0.5f; ///< triangle count ratio between neighbour levels
+    size_t   minTriangles = 64;   ///< levels with fewer triangles are not generated
+    float    maxError     = 0.05f;
+  };
+
+  struct MeshLODLevel
+  {
+    SimpleMesh mesh;
+    float      error = 0.0f; ///< relative to bounding box diagonal of the source mesh
+  };
+
+  // every level is simplified from the previous one; generation stops when target is not reached because of locked features or error limit
+  //
+  std::vector<MeshLODLevel> BuildLODChain(const SimpleMesh& a_mesh, const LODChainOptions& a_options = LODChainOptions());
+}
+
+#endif
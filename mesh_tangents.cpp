@@ -0,0 +1,294 @@
+#include "mesh_tangents.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+namespace cmesh4
+{
+  using LiteMath::float3;
+
+  // corners (index buffer positions) grouped by key in CSR form
+  //
+  struct CornerGroups
+  {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> corners;
+  };
+
+  static CornerGroups GroupCorners(const std::vector<uint32_t>& a_cornerKeys, size_t a_keysNum)
+  {
+    CornerGroups res;
+    res.offsets.assign(a_keysNum + 1, 0);
+    for(uint32_t key : a_cornerKeys)
+      res.offsets[key + 1]++;
+    for(size_t k = 0; k < a_keysNum; k++)
+      res.offsets[k + 1] += res.offsets[k];
+    res.corners.resize(a_cornerKeys.size());
+    std::vector<uint32_t> cursor(res.offsets.begin(), res.offsets.end() - 1);
+    for(size_t i = 0; i < a_cornerKeys.size(); i++)
+      res.corners[cursor[a_cornerKeys[i]]++] = uint32_t(i);
+    return res;
+  }
+
+  // vertices with bitwise equal positions share an id, so normals are smooth across attribute seams
+  //
+  static std::vector<uint32_t> PositionGroups(const SimpleMesh& a_mesh, size_t* a_pGroupsNum)
+  {
+    struct PosKey { uint32_t x, y, z; bool operator==(const PosKey& o) const { return x == o.x && y == o.y && z == o.z; } };
+    struct PosHash { size_t operator()(const PosKey& k) const { return size_t(k.x)*73856093u ^ size_t(k.y)*19349663u ^ size_t(k.z)*83492791u; } };
+
+    std::unordered_map<PosKey, uint32_t, PosHash> groups;
+    groups.reserve(a_mesh.VerticesNum());
+    std::vector<uint32_t> res(a_mesh.VerticesNum());
+    for(size_t v = 0; v < a_mesh.VerticesNum(); v++)
+    {
+      PosKey key;
+      const float px = a_mesh.vPos4f[v].x + 0.0f, py = a_mesh.vPos4f[v].y + 0.0f, pz = a_mesh.vPos4f[v].z + 0.0f;
+      memcpy(&key.x, &px, sizeof(float));
+      memcpy(&key.y, &py, sizeof(float));
+      memcpy(&key.z, &pz, sizeof(float));
+      res[v] = groups.emplace(key, uint32_t(groups.size())).first->second;
+    }
+    *a_pGroupsNum = groups.size();
+    return res;
+  }
+
+  static inline float CornerAngle(const float3& a_edge1, const float3& a_edge2)
+  {
+    const float len = LiteMath::length(a_edge1)*LiteMath::length(a_edge2);
+    if(len <= 0.0f)
+      return 0.0f;
+    return std::acos(std::min(std::max(LiteMath::dot(a_edge1, a_edge2)/len, -1.0f), 1.0f));
+  }
+
+  static inline float3 SafeNormalize(const float3& v)
+  {
+    const float len = LiteMath::length(v);
+    return (len > 0.0f) ? v/len : float3(0.0f);
+  }
+
+  static inline float3 AnyOrthogonal(const float3& n)
+  {
+    const float3 axis = (std::abs(n.x) < 0.9f) ? float3(1, 0, 0) : float3(0, 1, 0);
+    return SafeNormalize(axis - n*LiteMath::dot(n, axis));
+  }
+
+  // smooth normals and tangents depend only on vertices and triangles, so quads are split for the time of a_func and restored
+  //
+  template<typename Func>
+  static void WithQuadsAsTriangles(SimpleMesh& a_mesh, Func a_func)
+  {
+    std::vector<unsigned int>  quads     = a_mesh.indices;
+    std::vector<unsigned int>  materials = a_mesh.matIndices;
+    std::vector<MaterialRange> ranges    = a_mesh.matRanges;
+    a_mesh.Triangulate();
+    a_func(a_mesh);
+    a_mesh.indices    = std::move(quads);
+    a_mesh.matIndices = std::move(materials);
+    a_mesh.matRanges  = std::move(ranges);
+    a_mesh.topology   = SimpleMesh::SIMPLE_MESH_QUADS;
+  }
+
+  static bool AnyNonZero(const std::vector<float4>& a_data, size_t a_size)
+  {
+    if(a_data.size() < a_size || a_size == 0)
+      return false;
+    for(size_t i = 0; i < a_size; i++)
+      if(a_data[i].x != 0.0f || a_data[i].y != 0.0f || a_data[i].z != 0.0f)
+        return true;
+    return false;
+  }
+};
+
+bool cmesh4::HasNormals(const SimpleMesh& a_mesh)  { return AnyNonZero(a_mesh.vNorm4f, a_mesh.VerticesNum()); }
+bool cmesh4::HasTangents(const SimpleMesh& a_mesh) { return AnyNonZero(a_mesh.vTang4f, a_mesh.VerticesNum()); }
+
+void cmesh4::ComputeNormals(SimpleMesh& a_mesh, NORMALS_MODE a_mode)
+{
+  if(a_mesh.topology != SimpleMesh::SIMPLE_MESH_TRIANGLES)
+  {
+    if(a_mode == NORMALS_FLAT) // vertices are split per triangle anyway
+      a_mesh.Triangulate();
+    else
+    {
+      WithQuadsAsTriangles(a_mesh, [a_mode](SimpleMesh& a_tris) { ComputeNormals(a_tris, a_mode); });
+      return;
+    }
+  }
+
+  const size_t vertNum = a_mesh.VerticesNum();
+  const size_t trisNum = a_mesh.TrianglesNum();
+  for(unsigned int v : a_mesh.indices)
+    if(v >= vertNum)
+      return;
+
+  if(a_mode == NORMALS_FLAT)
+  {
+    SimpleMesh res;
+    const size_t cornersNum = trisNum*3;
+    const bool   hasTang    = a_mesh.vTang4f.size() == vertNum;
+    const bool   hasUV      = a_mesh.vTexCoord2f.size() == vertNum;
+    const bool   hasUV1     = a_mesh.vTexCoord2f_1.size() == vertNum;
+    const bool   hasCol     = a_mesh.vColor4f.size() == vertNum;
+    res.vPos4f.resize(cornersNum);
+    res.vNorm4f.resize(cornersNum);
+    res.vTang4f.resize(hasTang ? cornersNum : 0);
+    res.vTexCoord2f.resize(hasUV ? cornersNum : 0);
+    res.vTexCoord2f_1.resize(hasUV1 ? cornersNum : 0);
+    res.vColor4f.resize(hasCol ? cornersNum : 0);
+    res.indices.resize(cornersNum);
+    res.matIndices = a_mesh.matIndices;
+    res.matRanges  = a_mesh.matRanges;
+
+    #pragma omp parallel for
+    for(int64_t t = 0; t < int64_t(trisNum); t++)
+    {
+      const uint32_t* tri = a_mesh.indices.data() + t*3;
+      const float3 A = LiteMath::to_float3(a_mesh.vPos4f[tri[0]]);
+      const float3 B = LiteMath::to_float3(a_mesh.vPos4f[tri[1]]);
+      const float3 C = LiteMath::to_float3(a_mesh.vPos4f[tri[2]]);
+      const float4 n = LiteMath::to_float4(SafeNormalize(LiteMath::cross(B - A, C - A)), 0.0f);
+      for(int k = 0; k < 3; k++)
+      {
+        const size_t c = size_t(t)*3 + k;
+        res.vPos4f[c]  = a_mesh.vPos4f[tri[k]];
+        res.vNorm4f[c] = n;
+        if(hasTang)
+          res.vTang4f[c] = a_mesh.vTang4f[tri[k]];
+        if(hasUV)
+          res.vTexCoord2f[c] = a_mesh.vTexCoord2f[tri[k]];
+        if(hasUV1)
+          res.vTexCoord2f_1[c] = a_mesh.vTexCoord2f_1[tri[k]];
+        if(hasCol)
+          res.vColor4f[c] = a_mesh.vColor4f[tri[k]];
+        res.indices[c] = uint32_t(c);
+      }
+    }
+
+    a_mesh = std::move(res);
+    return;
+  }
+
+  // (1) angle weighted face normal for every corner
+  //
+  std::vector<float3> cornerNormals(trisNum*3);
+
+  #pragma omp parallel for
+  for(int64_t t = 0; t < int64_t(trisNum); t++)
+  {
+    const uint32_t* tri = a_mesh.indices.data() + t*3;
+    const float3 P[3] = {LiteMath::to_float3(a_mesh.vPos4f[tri[0]]), LiteMath::to_float3(a_mesh.vPos4f[tri[1]]), LiteMath::to_float3(a_mesh.vPos4f[tri[2]])};
+    const float3 n = SafeNormalize(LiteMath::cross(P[1] - P[0], P[2] - P[0]));
+    for(int k = 0; k < 3; k++)
+      cornerNormals[t*3 + k] = n*CornerAngle(P[(k + 1) % 3] - P[k], P[(k + 2) % 3] - P[k]);
+  }
+
+  // (2) gather per position group, each group is summed by one thread, so no atomics are needed
+  //
+  size_t groupsNum = 0;
+  const std::vector<uint32_t> group = PositionGroups(a_mesh, &groupsNum);
+  std::vector<uint32_t> cornerKeys(trisNum*3);
+  for(size_t i = 0; i < cornerKeys.size(); i++)
+    cornerKeys[i] = group[a_mesh.indices[i]];
+  const CornerGroups corners = GroupCorners(cornerKeys, groupsNum);
+
+  std::vector<float3> groupNormals(groupsNum);
+
+  #pragma omp parallel for
+  for(int64_t g = 0; g < int64_t(groupsNum); g++)
+  {
+    float3 sum(0.0f);
+    for(uint32_t i = corners.offsets[g]; i < corners.offsets[g + 1]; i++)
+      sum += cornerNormals[corners.corners[i]];
+    groupNormals[g] = SafeNormalize(sum);
+  }
+
+  a_mesh.vNorm4f.resize(vertNum);
+
+  #pragma omp parallel for
+  for(int64_t v = 0; v < int64_t(vertNum); v++)
+    a_mesh.vNorm4f[v] = LiteMath::to_float4(groupNormals[group[v]], 0.0f);
+}
+
+void cmesh4::ComputeTangents(SimpleMesh& a_mesh)
+{
+  if(a_mesh.topology != SimpleMesh::SIMPLE_MESH_TRIANGLES)
+  {
+    WithQuadsAsTriangles(a_mesh, [](SimpleMesh& a_tris) { ComputeTangents(a_tris); });
+    return;
+  }
+
+  const size_t vertNum = a_mesh.VerticesNum();
+  const size_t trisNum = a_mesh.TrianglesNum();
+  if(a_mesh.vNorm4f.size() != vertNum)
+    return;
+  for(unsigned int v : a_mesh.indices)
+    if(v >= vertNum)
+      return;
+
+  const bool hasUV = a_mesh.vTexCoord2f.size() == vertNum;
+
+  // (1) per corner tangent and bitangent, projected to the plane of the vertex normal and weighted by corner angle
+  //
+  std::vector<float3> cornerTang(trisNum*3, float3(0.0f));
+  std::vector<float3> cornerBitang(trisNum*3, float3(0.0f));
+
+  if(hasUV)
+  {
+    #pragma omp parallel for
+    for(int64_t t = 0; t < int64_t(trisNum); t++)
+    {
+      const uint32_t* tri = a_mesh.indices.data() + t*3;
+      const float3 P[3] = {LiteMath::to_float3(a_mesh.vPos4f[tri[0]]), LiteMath::to_float3(a_mesh.vPos4f[tri[1]]), LiteMath::to_float3(a_mesh.vPos4f[tri[2]])};
+      const float2 T[3] = {a_mesh.vTexCoord2f[tri[0]], a_mesh.vTexCoord2f[tri[1]], a_mesh.vTexCoord2f[tri[2]]};
+
+      const float3 e1 = P[1] - P[0], e2 = P[2] - P[0];
+      const float  du1 = T[1].x - T[0].x, dv1 = T[1].y - T[0].y;
+      const float  du2 = T[2].x - T[0].x, dv2 = T[2].y - T[0].y;
+      const float  det = du1*dv2 - du2*dv1;
+      if(std::abs(det) < 1e-20f)
+        continue;
+
+      // orientation of uv mapping is taken from sign of det, magnitude is normalized away below
+      const float  sgn = (det > 0.0f) ? 1.0f : -1.0f;
+      const float3 tangent   = (e1*dv2 - e2*dv1)*sgn;
+      const float3 bitangent = (e2*du1 - e1*du2)*sgn;
+
+      for(int k = 0; k < 3; k++)
+      {
+        const float3 n      = LiteMath::to_float3(a_mesh.vNorm4f[tri[k]]);
+        const float  weight = CornerAngle(P[(k + 1) % 3] - P[k], P[(k + 2) % 3] - P[k]);
+        cornerTang  [t*3 + k] = SafeNormalize(tangent   - n*LiteMath::dot(n, tangent))*weight;
+        cornerBitang[t*3 + k] = SafeNormalize(bitangent - n*LiteMath::dot(n, bitangent))*weight;
+      }
+    }
+  }
+
+  // (2) gather per vertex
+  //
+  std::vector<uint32_t> cornerKeys(a_mesh.indices.begin(), a_mesh.indices.begin() + trisNum*3);
+  const CornerGroups corners = GroupCorners(cornerKeys, vertNum);
+
+  a_mesh.vTang4f.resize(vertNum);
+
+  #pragma omp parallel for
+  for(int64_t v = 0; v < int64_t(vertNum); v++)
+  {
+    float3 sumT(0.0f), sumB(0.0f);
+    for(uint32_t i = corners.offsets[v]; i < corners.offsets[v + 1]; i++)
+    {
+      sumT += cornerTang[corners.corners[i]];
+      sumB += cornerBitang[corners.corners[i]];
+    }
+
+    const float3 n = SafeNormalize(LiteMath::to_float3(a_mesh.vNorm4f[v]));
+    float3 t = SafeNormalize(sumT - n*LiteMath::dot(n, sumT));
+    if(LiteMath::length(t) == 0.0f)
+      t = (LiteMath::length(n) > 0.0f) ? AnyOrthogonal(n) : float3(1, 0, 0);
+
+    const float w = (LiteMath::dot(LiteMath::cross(n, t), sumB) < 0.0f) ? -1.0f : 1.0f;
+    a_mesh.vTang4f[v] = LiteMath::to_float4(t, w);
+  }
+}
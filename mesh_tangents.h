@@ -0,0 +1,25 @@
+#ifndef LITESCENE_MESH_TANGENTS_H_
+#define LITESCENE_MESH_TANGENTS_H_
+#include "cmesh4.h"
+
+namespace cmesh4
+{
+  enum NORMALS_MODE
+  {
+    NORMALS_FLAT           = 0, ///< face normals; every triangle gets its own 3 vertices, so the mesh is unwelded (and triangulated)
+    NORMALS_ANGLE_WEIGHTED = 1, ///< smooth normals, face normals are weighted by corner angle; vertices with equal positions get equal normals
+  };
+
+  void ComputeNormals(SimpleMesh& a_mesh, NORMALS_MODE a_mode = NORMALS_ANGLE_WEIGHTED);
+
+  // per-vertex tangent frames in the MikkTSpace convention: xyz is tangent orthogonal to the normal, w = +-1 is handedness,
+  // bitangent = w*cross(normal, tangent). Per-corner tangents are angle-weighted and accumulated per vertex, as MikkTSpace does
+  // for vertices it doesn't split. Normals must be valid; vertices without usable texture coordinates get an arbitrary orthogonal tangent.
+  //
+  void ComputeTangents(SimpleMesh& a_mesh);
+
+  bool HasNormals (const SimpleMesh& a_mesh); ///< false if normals are absent or all zero (e.g. VSGF file without normals)
+  bool HasTangents(const SimpleMesh& a_mesh); ///< false if tangents are absent or all zero (e.g. VSGF file without tangents)
+}
+
+#endif
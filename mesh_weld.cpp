@@ -0,0 +1,198 @@
+#include "cmesh4.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+namespace cmesh4
+{
+  static constexpr uint32_t WELD_INVALID = uint32_t(-1);
+
+  struct WeldCell { int64_t x, y, z; };
+
+  // far positions are clamped to the border cells, so the cast and neighbour cells (+-1) can't overflow; it only makes those cells crowded
+  //
+  static inline int64_t CellCoord(float a_x, float a_invCellSize)
+  {
+    const double LIMIT = double(int64_t(1) << 62);
+    return int64_t(std::min(std::max(std::floor(double(a_x)*double(a_invCellSize)), -LIMIT), LIMIT));
+  }
+
+  static inline WeldCell CellOf(const float4& p, float a_invCellSize, bool a_exact)
+  {
+    if(a_exact) // hash bit patterns, -0.0f is folded to 0.0f so they get into the same cell
+    {
+      uint32_t bx, by, bz;
+      const float px = p.x + 0.0f, py = p.y + 0.0f, pz = p.z + 0.0f;
+      memcpy(&bx, &px, sizeof(float));
+      memcpy(&by, &py, sizeof(float));
+      memcpy(&bz, &pz, sizeof(float));
+      return WeldCell{int64_t(bx), int64_t(by), int64_t(bz)};
+    }
+    return WeldCell{CellCoord(p.x, a_invCellSize), CellCoord(p.y, a_invCellSize), CellCoord(p.z, a_invCellSize)};
+  }
+
+  static inline bool IsFinite(const float4& p) { return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z); }
+
+  static inline uint32_t HashCell(int64_t x, int64_t y, int64_t z, uint32_t a_mask)
+  {
+    uint64_t h = uint64_t(x)*0x9E3779B185EBCA87ull ^ uint64_t(y)*0xC2B2AE3D27D4EB4Full ^ uint64_t(z)*0x165667B19E3779F9ull;
+    h ^= h >> 29;
+    return uint32_t(h) & a_mask;
+  }
+};
+
+size_t cmesh4::WeldVertices(SimpleMesh& mesh, const WeldOptions& a_options)
+{
+  const size_t vertNum = mesh.VerticesNum();
+  if(vertNum == 0 || vertNum >= size_t(WELD_INVALID))
+    return vertNum;
+
+  const bool hasNorm = a_options.compareNormals   && mesh.vNorm4f.size()       == vertNum;
+  const bool hasUV   = a_options.compareTexCoords && mesh.vTexCoord2f.size()   == vertNum;
+  const bool hasUV1  = a_options.compareTexCoords && mesh.vTexCoord2f_1.size() == vertNum;
+  const bool hasTang = mesh.vTang4f.size()   == vertNum;
+  const bool hasCol  = mesh.vColor4f.size() == vertNum;
+  const bool exact   = !(a_options.posEps > 0.0f);
+
+  const float  invCellSize = exact ? 0.0f : 1.0f/a_options.posEps;
+  const float  posEps2     = a_options.posEps*a_options.posEps;
+  const float4* vPos       = mesh.vPos4f.data();
+  const float4* vNorm      = mesh.vNorm4f.data();
+  const float4* vTang      = mesh.vTang4f.data();
+  const float2* vUV        = mesh.vTexCoord2f.data();
+  const float2* vUV1       = mesh.vTexCoord2f_1.data();
+  const float4* vCol       = mesh.vColor4f.data();
+
+  // (1) lock-free hash grid: bucket heads are swapped atomically, every finite vertex is pushed to the front of its bucket list
+  //
+  uint32_t bucketsNum = 1024;
+  while(bucketsNum < 2*vertNum && bucketsNum < (1u << 31))
+    bucketsNum *= 2;
+  const uint32_t mask = bucketsNum - 1;
+
+  std::vector< std::atomic<uint32_t> > heads(bucketsNum);
+  std::vector<uint32_t> next(vertNum, WELD_INVALID);
+
+  #pragma omp parallel
+  {
+    #pragma omp for
+    for(int64_t i = 0; i < int64_t(bucketsNum); i++)
+      heads[i].store(WELD_INVALID, std::memory_order_relaxed);
+
+    #pragma omp for
+    for(int64_t i = 0; i < int64_t(vertNum); i++)
+    {
+      if(!IsFinite(vPos[i])) // NaN or infinite position is never merged, not even with an identical one
+        continue;
+      const WeldCell c = CellOf(vPos[i], invCellSize, exact);
+      next[i] = heads[HashCell(c.x, c.y, c.z, mask)].exchange(uint32_t(i), std::memory_order_relaxed);
+    }
+  }
+
+  // (2) for every vertex find the minimal id of a matching vertex in neighbour cells
+  //
+  auto same = [&](uint32_t a, uint32_t b)
+  {
+    const float dx = vPos[a].x - vPos[b].x, dy = vPos[a].y - vPos[b].y, dz = vPos[a].z - vPos[b].z;
+    if(exact ? (dx != 0.0f || dy != 0.0f || dz != 0.0f) : (dx*dx + dy*dy + dz*dz > posEps2))
+      return false;
+    if(hasNorm && (std::abs(vNorm[a].x - vNorm[b].x) > a_options.normEps ||
+                   std::abs(vNorm[a].y - vNorm[b].y) > a_options.normEps ||
+                   std::abs(vNorm[a].z - vNorm[b].z) > a_options.normEps))
+      return false;
+    if(hasUV && (std::abs(vUV[a].x - vUV[b].x) > a_options.uvEps || std::abs(vUV[a].y - vUV[b].y) > a_options.uvEps))
+      return false;
+    if(hasUV1 && (std::abs(vUV1[a].x - vUV1[b].x) > a_options.uvEps || std::abs(vUV1[a].y - vUV1[b].y) > a_options.uvEps))
+      return false;
+    if(hasTang && vTang[a].w != vTang[b].w) // mirrored uv seam, only one tangent is kept after merge
+      return false;
+    if(hasCol && (vCol[a].x != vCol[b].x || vCol[a].y != vCol[b].y || vCol[a].z != vCol[b].z || vCol[a].w != vCol[b].w))
+      return false;
+    return true;
+  };
+
+  std::vector<uint32_t> rep(vertNum);
+  const int64_t range = exact ? 0 : 1;
+
+  #pragma omp parallel for schedule(dynamic, 4096)
+  for(int64_t i = 0; i < int64_t(vertNum); i++)
+  {
+    rep[i] = uint32_t(i);
+    if(!IsFinite(vPos[i]))
+      continue;
+    const WeldCell c = CellOf(vPos[i], invCellSize, exact);
+    uint32_t best = uint32_t(i);
+    for(int64_t z = c.z - range; z <= c.z + range; z++)
+    for(int64_t y = c.y - range; y <= c.y + range; y++)
+    for(int64_t x = c.x - range; x <= c.x + range; x++)
+    {
+      for(uint32_t j = heads[HashCell(x, y, z, mask)].load(std::memory_order_relaxed); j != WELD_INVALID; j = next[j])
+      {
+        if(j < best && same(uint32_t(i), j))
+          best = j;
+      }
+    }
+    rep[i] = best;
+  }
+
+  // (3) resolve chains in order (rep[i] <= i) and assign compact ids to representatives
+  //
+  std::vector<uint32_t> newId(vertNum);
+  std::vector<uint32_t> oldId;
+  oldId.reserve(vertNum);
+  for(size_t i = 0; i < vertNum; i++)
+  {
+    if(rep[i] == uint32_t(i))
+    {
+      newId[i] = uint32_t(oldId.size());
+      oldId.push_back(uint32_t(i));
+    }
+    else
+      newId[i] = newId[rep[i]];
+  }
+
+  const size_t newVertNum = oldId.size();
+  if(newVertNum == vertNum)
+    return vertNum;
+
+  // (4) compact attributes and remap indices
+  //
+  auto compact = [&](auto& a_arr)
+  {
+    if(a_arr.size() != vertNum)
+      return;
+    typename std::remove_reference<decltype(a_arr)>::type res(newVertNum);
+    #pragma omp parallel for
+    for(int64_t i = 0; i < int64_t(newVertNum); i++)
+      res[i] = a_arr[oldId[i]];
+    a_arr = std::move(res);
+  };
+
+  compact(mesh.vPos4f);
+  compact(mesh.vNorm4f);
+  compact(mesh.vTang4f);
+  compact(mesh.vTexCoord2f);
+  compact(mesh.vTexCoord2f_1);
+  compact(mesh.vColor4f);
+
+  const int64_t indNum = int64_t(mesh.indices.size());
+  unsigned int* ind    = mesh.indices.data();
+
+  #pragma omp parallel for
+  for(int64_t i = 0; i < indNum; i++)
+  {
+    if(ind[i] < vertNum)
+      ind[i] = newId[ind[i]];
+  }
+
+  return newVertNum;
+}
+
+void cmesh4::WeldVertices(SimpleMesh& mesh, int indexNum)
+{
+  (void)indexNum; // vertex arrays are compacted, so all indices have to be remapped anyway
+  WeldVertices(mesh, WeldOptions());
+}
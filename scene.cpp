@@ -1,6 +1,7 @@
 #include "scene.h"
 #include "hydraxml.h"
 #include "loadutil.h"
+#include "mesh_tangents.h"
 
 #include <sstream>
 #include <fstream>
@@ -8,6 +9,14 @@
 #include <cassert>
 #include <locale>
 #include <codecvt>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <exception>
 
 namespace LiteScene
 {
@@ -119,6 +128,25 @@ namespace LiteScene
         relative_file_path = ws2s(node.attribute(L"loc").as_string());
         type_id = MESH_TYPE_ID;
 
+        lods.clear();
+        std::vector<std::pair<uint32_t, LOD>> levels;
+        for (pugi::xml_node lod_node = node.child(L"lod"); lod_node != nullptr; lod_node = lod_node.next_sibling(L"lod"))
+        {
+            if (lod_node.attribute(L"loc").empty())
+            {
+                printf("[MeshGeometry::load_node] LOD without location is skipped\n");
+                continue;
+            }
+            LOD lod;
+            lod.relative_file_path = ws2s(lod_node.attribute(L"loc").as_string());
+            lod.error = lod_node.attribute(L"error").as_float(0.0f);
+            lod.tri_num = lod_node.attribute(L"triNum").as_uint(0);
+            levels.push_back({lod_node.attribute(L"level").as_uint(uint32_t(levels.size() + 1)), lod});
+        }
+        std::stable_sort(levels.begin(), levels.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+        for (auto &level : levels)
+            lods.push_back(std::move(level.second));
+
         return true;
     }
 
@@ -132,6 +160,19 @@ namespace LiteScene
         save_node_base(node);
         node.set_name(L"mesh");
         set_attr(node, L"loc", s2ws(relative_file_path));
+
+        while (node.child(L"lod")) //node may be a copy of the loaded one, with outdated LODs
+            node.remove_child(L"lod");
+        for (size_t i = 0; i < lods.size(); i++)
+        {
+            if (lods[i].relative_file_path == INVALID_PATH)
+                continue;
+            pugi::xml_node lod_node = node.append_child(L"lod");
+            set_attr(lod_node, L"level", uint32_t(i + 1));
+            set_attr(lod_node, L"loc", s2ws(lods[i].relative_file_path));
+            set_attr(lod_node, L"triNum", lods[i].tri_num);
+            set_attr(lod_node, L"error", lods[i].error);
+        }
         return true;
     }
     bool MeshGeometry::load_data(const SceneMetadata &metadata)
@@ -145,12 +186,53 @@ namespace LiteScene
             return false;
         }
         std::string path = metadata.scene_xml_folder + "/" + relative_file_path;
-        mesh = cmesh4::LoadMeshFromVSGF(path.c_str());
-        bool ok = mesh.VerticesNum() > 0 && mesh.IndicesNum() > 0;
-        if (!ok)
+        bool mapped = false;
+        if (map_data)
         {
-            printf("[MeshGeometry::load_data] Failed to load mesh %s\n", path.c_str());
-            return false;
+            mesh_view = cmesh4::LoadMeshViewFromVSGF(path.c_str());
+            mapped = mesh_view.VerticesNum() > 0 && mesh_view.IndicesNum() > 0;
+            if (!mapped)
+                mesh_view = cmesh4::SimpleMeshView(); // can't map this file, fall back to regular loading
+        }
+        if (!mapped)
+        {
+            mesh = cmesh4::LoadMeshFromVSGF(path.c_str());
+            bool ok = mesh.VerticesNum() > 0 && mesh.IndicesNum() > 0;
+            if (!ok)
+            {
+                printf("[MeshGeometry::load_data] Failed to load mesh %s\n", path.c_str());
+                return false;
+            }
+
+            if (generate_tangents && !cmesh4::HasTangents(mesh))
+            {
+                cmesh4::ComputeTangents(mesh);
+                if (cache_generated)
+                {
+                    // keep encodings of the source file, so lossless assets stay lossless; write a temporary file and
+                    // rename it, so an interrupted write doesn't destroy the asset
+                    std::string temp = path + ".tmp";
+                    std::error_code ec;
+                    cmesh4::VSGFSaveOptions options;
+                    const bool saved = cmesh4::LoadVSGFSaveOptions(path.c_str(), &options) ? cmesh4::SaveMeshToVSGF(temp.c_str(), mesh, options)
+                                                                                            : cmesh4::SaveMeshToVSGF(temp.c_str(), mesh);
+                    if (saved)
+                        fs::rename(temp, path, ec);
+                    if (!saved || ec)
+                    {
+                        printf("[MeshGeometry::load_data] Can't cache generated tangents in %s\n", path.c_str());
+                        fs::remove(temp, ec);
+                    }
+                }
+            }
+        }
+
+        for (auto &lod : lods)
+        {
+            std::string lod_path = metadata.scene_xml_folder + "/" + lod.relative_file_path;
+            lod.mesh = cmesh4::LoadMeshFromVSGF(lod_path.c_str());
+            if (lod.mesh.IndicesNum() == 0)
+                printf("[MeshGeometry::load_data] Failed to load LOD %s\n", lod_path.c_str());
         }
         is_loaded = true;
         return true;
@@ -163,15 +245,58 @@ namespace LiteScene
             printf("[MeshGeometry::save_data] Mesh is not loaded\n");
             return false;
         }
+        if (mesh_view.VerticesNum() > 0) // target file may be the mapped one, so detach from it before writing
+        {
+            mesh = mesh_view.ToSimpleMesh();
+            mesh_view = cmesh4::SimpleMeshView();
+        }
         std::string mesh_name = "mesh_" + std::to_string(id);
         relative_file_path = metadata.geometry_folder_relative + "/" + mesh_name + ".vsgf";
         std::string file_path = metadata.scene_xml_folder == "" ? relative_file_path : 
         metadata.scene_xml_folder + "/" + relative_file_path;
         cmesh4::SaveMeshToVSGF(file_path.c_str(), mesh);
 
+        std::vector<LOD> saved_lods;
+        for (auto &lod : lods)
+        {
+            if (lod.mesh.IndicesNum() == 0)
+            {
+                printf("[MeshGeometry::save_data] LOD %s of mesh %u is not loaded and is dropped\n", lod.relative_file_path.c_str(), id);
+                continue;
+            }
+            lod.relative_file_path = metadata.geometry_folder_relative + "/" + mesh_name + "_lod" + std::to_string(saved_lods.size() + 1) + ".vsgf";
+            std::string lod_path = metadata.scene_xml_folder == "" ? lod.relative_file_path :
+            metadata.scene_xml_folder + "/" + lod.relative_file_path;
+            cmesh4::SaveMeshToVSGF(lod_path.c_str(), lod.mesh);
+            saved_lods.push_back(std::move(lod));
+        }
+        lods = std::move(saved_lods);
+
         return true;
     }
 
+    bool MeshGeometry::generate_lods(const cmesh4::LODChainOptions &options)
+    {
+        if (!is_loaded)
+        {
+            printf("[MeshGeometry::generate_lods] Mesh is not loaded\n");
+            return false;
+        }
+
+        lods.clear();
+        auto chain = mesh_view.VerticesNum() > 0 ? cmesh4::BuildLODChain(mesh_view.ToSimpleMesh(), options) :
+                                                   cmesh4::BuildLODChain(mesh, options);
+        for (auto &level : chain)
+        {
+            LOD lod;
+            lod.error = level.error;
+            lod.tri_num = uint32_t(level.mesh.TrianglesNum());
+            lod.mesh = std::move(level.mesh);
+            lods.push_back(std::move(lod));
+        }
+        return !lods.empty();
+    }
+
     bool CustomGeometry::load_node(pugi::xml_node node)
     {
         bool ok = load_node_base(node);
@@ -743,6 +868,123 @@ namespace LiteScene
         return t_loaded && m_loaded && g_loaded && l_loaded && c_loaded && rs_loaded && s_loaded;
     }
 
+    //loads data of given meshes on several threads, see HydraScene::load_all_geometry
+    //meshes not started before a_cancel is set are skipped; on_loaded is called from worker threads
+    std::vector<GeometryLoadInfo> load_meshes_parallel(const SceneMetadata &metadata, const std::vector<MeshGeometry *> &meshes,
+                                                       unsigned threads, size_t budget_bytes, const std::atomic<bool> *a_cancel,
+                                                       const std::function<void(const GeometryLoadInfo &)> &on_loaded)
+    {
+        std::vector<GeometryLoadInfo> infos(meshes.size());
+        const int num_threads = threads > 0 ? int(threads) : int(std::max(std::thread::hardware_concurrency(), 1u));
+
+        std::mutex budget_mutex;
+        std::condition_variable budget_cv;
+        size_t bytes_in_flight = 0;
+
+        //exceptions can't leave omp region: a failed mesh is reported in its info, the first one thrown by on_loaded is rethrown after the loop
+        std::mutex error_mutex;
+        std::exception_ptr callback_error;
+
+        #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+        for (int i = 0; i < int(meshes.size()); i++)
+        {
+            MeshGeometry *mesh = meshes[i];
+            GeometryLoadInfo &info = infos[i];
+            info.geom_id = mesh->id;
+            if (a_cancel != nullptr && a_cancel->load())
+                continue;
+
+            std::error_code ec;
+            const std::string path = metadata.scene_xml_folder + "/" + mesh->relative_file_path;
+            info.bytes = std::filesystem::file_size(path, ec);
+            if (ec)
+                info.bytes = mesh->bytesize;
+
+            if (budget_bytes != 0) // a file larger than the whole budget is loaded alone
+            {
+                std::unique_lock<std::mutex> lock(budget_mutex);
+                budget_cv.wait(lock, [&]() { return bytes_in_flight == 0 || bytes_in_flight + info.bytes <= budget_bytes; });
+                bytes_in_flight += info.bytes;
+            }
+
+            const auto start = std::chrono::high_resolution_clock::now();
+            try
+            {
+                info.ok = mesh->load_data(metadata);
+            }
+            catch (const std::exception &e)
+            {
+                printf("[HydraScene::load_all_geometry] Failed to load mesh %s: %s\n", path.c_str(), e.what());
+                info.ok = false;
+            }
+            catch (...)
+            {
+                printf("[HydraScene::load_all_geometry] Failed to load mesh %s\n", path.c_str());
+                info.ok = false;
+            }
+            const auto end = std::chrono::high_resolution_clock::now();
+            info.time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+            if (budget_bytes != 0)
+            {
+                std::lock_guard<std::mutex> lock(budget_mutex);
+                bytes_in_flight -= info.bytes;
+                budget_cv.notify_all();
+            }
+
+            if (on_loaded)
+            {
+                try
+                {
+                    on_loaded(info);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!callback_error)
+                        callback_error = std::current_exception();
+                }
+            }
+        }
+
+        if (callback_error)
+            std::rethrow_exception(callback_error);
+        return infos;
+    }
+
+    std::vector<GeometryLoadInfo> HydraScene::load_all_geometry(unsigned threads, size_t budget_bytes)
+    {
+        std::vector<MeshGeometry *> meshes;
+        for (const auto &[id, geom] : geometries)
+        {
+            auto *mesh = dynamic_cast<MeshGeometry *>(geom);
+            if (mesh != nullptr && !mesh->is_loaded)
+                meshes.push_back(mesh);
+        }
+
+        return load_meshes_parallel(metadata, meshes, threads, budget_bytes, nullptr, {});
+    }
+
+    uint32_t HydraScene::generate_lods(const cmesh4::LODChainOptions &options)
+    {
+        std::vector<MeshGeometry *> meshes;
+        for (auto &[id, geom] : geometries)
+        {
+            auto *mesh = dynamic_cast<MeshGeometry *>(geom);
+            if (mesh != nullptr && mesh->is_loaded)
+                meshes.push_back(mesh);
+        }
+
+        std::atomic<uint32_t> count{0};
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < int(meshes.size()); i++)
+        {
+            if (meshes[i]->generate_lods(options))
+                count++;
+        }
+        return count;
+    }
+
     bool save_geometry(const HydraScene &scene, const SceneMetadata &save_metadata, pugi::xml_node &lib_node)
     {
         for (const auto &[id, geom] : scene.geometries)
@@ -1146,7 +1388,7 @@ namespace LiteScene
             auto *mesh = dynamic_cast<const MeshGeometry *>(geom);
             if (mesh != nullptr) {
                 if (mesh->is_loaded) {
-                    count += mesh->mesh.TrianglesNum();
+                    count += mesh->mesh.TrianglesNum() + mesh->mesh_view.TrianglesNum();
                 }
                 else {
                     count += mesh->custom_data.attribute(L"triNum").as_uint(0);
@@ -1209,5 +1451,37 @@ namespace LiteScene
         }
     }
 
+    bool HydraScene::reorder_instances(uint32_t sceneId, cmesh4::SPACE_CURVE curve)
+    {
+        auto scene_it = scenes.find(sceneId);
+        if (scene_it == scenes.end())
+        {
+            printf("[HydraScene::reorder_instances] Scene %u does not exist\n", sceneId);
+            return false;
+        }
+        auto &instances = scene_it->second.instances;
+
+        std::vector<uint32_t> ids;
+        std::vector<LiteMath::float4> positions;
+        ids.reserve(instances.size());
+        positions.reserve(instances.size());
+        for (const auto &[id, inst] : instances)
+        {
+            ids.push_back(id);
+            positions.push_back(inst.matrix.get_col(3));
+        }
+
+        const std::vector<uint32_t> order = cmesh4::SpaceCurveOrder(positions.data(), positions.size(), curve);
+        std::map<uint32_t, Instance> reordered;
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            Instance &inst = reordered[ids[i]];
+            inst = std::move(instances[ids[order[i]]]);
+            inst.id = ids[i];
+        }
+        instances = std::move(reordered);
+        return true;
+    }
+
 
 }
\ No newline at end of file
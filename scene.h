@@ -2,6 +2,9 @@
 #define LITESCENE_SCENE_H_
 #include "scene_common.h"
 #include "cmesh4.h"
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+#include "mesh_cache.h"
 #include "material.h"
 #include <string>
 #include <vector>
@@ -9,6 +12,9 @@
 #include <variant>
 #include <istream>
 #include <unordered_map>
+#include <atomic>
+#include <functional>
+#include <future>
 
 namespace LiteScene
 {
@@ -105,8 +111,25 @@ namespace LiteScene
         bool save_data(const SceneMetadata &metadata) override;
 
         bool is_loaded = false;
+        bool map_data  = false; // if set, load_data maps .vsgf file to memory (mesh_view) instead of copying it to mesh
+        bool generate_tangents = false; // if set, load_data computes tangents when the file has none (not for mapped meshes)
+        bool cache_generated   = false; // if set, generated tangents are written back to the .vsgf file, so it's done only once
         std::string relative_file_path = INVALID_PATH;
-        cmesh4::SimpleMesh mesh; // empty when not loaded
+        cmesh4::SimpleMesh mesh;          // empty when not loaded or loaded as mapped view
+        cmesh4::SimpleMeshView mesh_view; // read-only zero-copy data, only when loaded with map_data
+
+        // simplified version of the mesh, stored in its own .vsgf file referenced by <lod> child of <mesh> node
+        struct LOD
+        {
+            std::string relative_file_path = INVALID_PATH;
+            float error = 0.0f;       //relative to bounding box diagonal of the mesh
+            uint32_t tri_num = 0;
+            cmesh4::SimpleMesh mesh;  //loaded by load_data together with the main mesh
+        };
+        std::vector<LOD> lods;        //from fine to coarse, level 0 (the mesh itself) is not included
+
+        //replaces lods with a new chain built from the loaded mesh; they are written to disk by save_data
+        bool generate_lods(const cmesh4::LODChainOptions &options = {});
     };
 
     /* It is not a mesh, it is something else, like SDF or other implicit stuff
@@ -289,12 +312,91 @@ namespace LiteScene
         pugi::xml_node     custom_data; //all properties from xml node that are not loaded to struct fields
     };
 
+    // per-geometry report of HydraScene::load_all_geometry
+    struct GeometryLoadInfo
+    {
+        uint32_t geom_id = INVALID_ID;
+        size_t bytes = 0;      //size of the data file
+        double time_ms = 0.0;  //time spent in load_data
+        bool ok = false;
+    };
+
+    struct FlattenOptions
+    {
+        enum class Grouping
+        {
+            SINGLE,      //all instances go to one mesh
+            BY_MATERIAL, //one mesh per (remapped) material id
+            BY_CELL      //one mesh per cell of a uniform grid over the scene, instance goes to the cell with its bbox center
+        };
+
+        Grouping grouping = Grouping::SINGLE;
+        uint32_t cells_per_axis = 4; //BY_CELL only
+    };
+
+    // world space result of HydraScene::flatten
+    struct FlattenedMesh
+    {
+        uint32_t material_id = INVALID_ID; //BY_MATERIAL only
+        uint32_t cell_id = INVALID_ID;     //BY_CELL only, x + y*n + z*n*n for n = cells_per_axis
+        uint32_t instances_num = 0;        //number of instances that contributed to this mesh
+        cmesh4::SimpleMesh mesh;
+    };
+
+    class SceneLoadTask;
+
+    struct SceneLoadOptions
+    {
+        bool load_geometry = true;    //load data of all meshes after xml is parsed
+        bool map_geometry = false;    //see MeshGeometry::map_data
+        bool decode_textures = false; //decode all textures referenced from materials and lights, see Texture::get_combined_sampler
+        unsigned threads = 0;         //see HydraScene::load_all_geometry
+        size_t budget_bytes = 0;      //see HydraScene::load_all_geometry
+        std::function<void(const SceneLoadTask &)> on_progress; //called after every loaded mesh or texture from loader worker threads, one call at a time
+    };
+
+    // handle of background scene loading started with HydraScene::load_async
+    // scene must not be accessed until wait_xml() returned true; after that its structure (cameras, materials, instances, etc.)
+    // does not change, but mesh data and decoded textures can be used only after wait() returned.
+    // Scene must outlive the task; destroying the task cancels loading and waits for the loading thread.
+    class SceneLoadTask
+    {
+    public:
+        ~SceneLoadTask();
+
+        void cancel() { cancelled = true; }
+        bool is_cancelled() const { return cancelled; }
+        bool is_done() const { return done; }
+
+        bool wait_xml(); //blocks until xml is parsed, returns if it was successful
+        bool wait();     //blocks until loading is finished, returns false on error or cancel
+
+        std::atomic<size_t>   bytes_read{0};
+        std::atomic<uint32_t> meshes_done{0};
+        std::atomic<uint32_t> meshes_total{0};
+        std::atomic<uint32_t> textures_done{0};
+        std::atomic<uint32_t> textures_total{0};
+
+    private:
+        friend struct HydraScene;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> done{false};
+        std::promise<bool> xml_promise;
+        std::shared_future<bool> xml_result;
+        std::shared_future<bool> result;
+    };
+
     struct HydraScene
     {
         HydraScene() { initialize_empty_scene(); }
         ~HydraScene() { clear(); }
         //load scene from .xml file
         bool load(const std::string &filename); 
+        //loads data of all not yet loaded meshes in parallel, call after load()
+        //threads = 0 means all hardware threads; total size of files being loaded at once is kept under budget_bytes (0 means no limit)
+        std::vector<GeometryLoadInfo> load_all_geometry(unsigned threads = 0, size_t budget_bytes = 0);
+        //same as load() followed by load_all_geometry() and texture decoding, but runs on a background thread
+        std::shared_ptr<SceneLoadTask> load_async(const std::string &filename, const SceneLoadOptions &options = {});
         //saves all the geometry to  a given folder and scene to xml file
         //it changes metadata, that's why it's not const
         bool save(const std::string &filename, const std::string &geometry_folder);
@@ -305,6 +407,17 @@ namespace LiteScene
         //initializes empty scene, called in constructor
         void initialize_empty_scene();
 
+        //generates LOD chains for all loaded meshes in parallel, returns number of meshes that got at least one LOD
+        uint32_t generate_lods(const cmesh4::LODChainOptions &options = {});
+
+        //bakes all instances of scenes[sceneId] into world space meshes, remap lists are applied to material ids;
+        //meshes that are not loaded yet are loaded, mapped meshes are read through their views. Returns empty vector on error
+        std::vector<FlattenedMesh> flatten(uint32_t sceneId, const FlattenOptions &options = {});
+
+        //renumbers instances of scenes[sceneId] along the curve through their positions (translation of the matrix),
+        //the set of ids is kept, smaller ids go to instances earlier on the curve. Returns false if there is no such scene
+        bool reorder_instances(uint32_t sceneId, cmesh4::SPACE_CURVE curve = cmesh4::SPACE_CURVE::HILBERT);
+
         //adds custom geometry to the scene, returns id, takes ownership
         //geometry MUST be initialized (with specific for your geometry init function)
         uint32_t add_geometry(LiteScene::Geometry *geom);
@@ -334,7 +447,8 @@ namespace LiteScene
     std::string ws2s(const std::wstring& wstr);
 
    // bool load_gltf_mesh(const std::string &filename, std::vector<Geometry *> &meshes);
-    bool load_gltf_scene(const std::string &filename, HydraScene &scene, bool only_geometry = false);
+    //with cache, converted meshes are stored to it and taken from it on the next loads of the same files (see mesh_cache.h)
+    bool load_gltf_scene(const std::string &filename, HydraScene &scene, bool only_geometry = false, cmesh4::MeshCache *cache = nullptr);
 
 }
 
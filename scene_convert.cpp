@@ -71,7 +71,9 @@ namespace LiteScene
 
     }
 
-    static bool load_gltf_meshes(const gltf::Model model, std::map<uint32_t, Geometry *> &geometries, bool only_geometry)
+    //source_key is MeshCache::Key of the .gltf and its buffers, empty if meshes are not cached
+    static bool load_gltf_meshes(const gltf::Model model, std::map<uint32_t, Geometry *> &geometries, bool only_geometry,
+                                 cmesh4::MeshCache *cache, const std::string &source_key)
     {
         std::vector<std::unique_ptr<MeshGeometry>> meshes;
         meshes.reserve(model.meshes.size());
@@ -91,6 +93,14 @@ namespace LiteScene
             cmesh4::SimpleMesh &simpleMesh = mg->mesh; 
             mg->is_loaded = true;
 
+            const std::string key = source_key.empty() ? "" :
+                cmesh4::MeshCache::SubKey(source_key, "gltf:" + std::to_string(id) + (only_geometry ? ":geometry" : ""));
+            if(!key.empty() && cache->Load(key, simpleMesh)) {
+                geometries[id] = mg.release();
+                id += 1;
+                continue;
+            }
+
             for(const auto &prim : mesh.primitives) {
                 if(prim.mode != TINYGLTF_MODE_TRIANGLES) {
                     std::cerr << "[ERROR] Only triangle primitives are supported" << std::endl;
@@ -104,11 +114,12 @@ namespace LiteScene
                 append_float3_as_float4(model, normAccessor, simpleMesh.vNorm4f);
                 append_indices(model, indAcessor, simpleMesh.indices);
 
-                simpleMesh.vTexCoord2f.resize(simpleMesh.vPos4f.size());
-                simpleMesh.vTang4f.resize(simpleMesh.vPos4f.size());
                 simpleMesh.matIndices.push_back(only_geometry ? 0 : prim.material);
             }
 
+            if(!key.empty())
+                cache->Store(key, simpleMesh);
+
             geometries[id] = mg.release(); 
             id += 1;
         }
@@ -232,7 +243,7 @@ namespace LiteScene
         return true;
     }
 
-    bool load_gltf_scene(const std::string &filename, HydraScene &scene, bool only_geometry)
+    bool load_gltf_scene(const std::string &filename, HydraScene &scene, bool only_geometry, cmesh4::MeshCache *cache)
     {
         gltf::Model model;
         gltf::TinyGLTF loader;
@@ -251,7 +262,19 @@ namespace LiteScene
             return false;
         }
 
-        if(!load_gltf_meshes(model, scene.geometries, only_geometry)) return false;
+        std::string source_key;
+        if(cache != nullptr && cache->Enabled()) {
+            //external buffers are sources too, embedded ones are already hashed with the .gltf itself
+            std::vector<std::string> sources = {filename};
+            const fs::path folder = fs::path(filename).parent_path();
+            for(const auto &buffer : model.buffers) {
+                if(!buffer.uri.empty() && buffer.uri.compare(0, 5, "data:") != 0)
+                    sources.push_back((folder / buffer.uri).string());
+            }
+            source_key = cache->Key(sources);
+        }
+
+        if(!load_gltf_meshes(model, scene.geometries, only_geometry, cache, source_key)) return false;
         if(!load_gltf_cameras(model, scene.cameras)) return false;
         if(!load_gltf_scenes(model, scene.scenes, scene.cameras)) return false;
 
@@ -0,0 +1,381 @@
+#include "scene.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+
+namespace LiteScene
+{
+    std::vector<GeometryLoadInfo> load_meshes_parallel(const SceneMetadata &metadata, const std::vector<MeshGeometry *> &meshes,
+                                                       unsigned threads, size_t budget_bytes, const std::atomic<bool> *a_cancel,
+                                                       const std::function<void(const GeometryLoadInfo &)> &on_loaded);
+
+    namespace
+    {
+        // triangles of a mesh that go to the same output mesh
+        struct MeshPart
+        {
+            uint32_t mat_id = 0;
+            std::vector<uint32_t> vertices;  //source vertex ids, empty means all vertices in original order
+            std::vector<uint32_t> triangles; //source triangle ids, empty means all triangles in original order
+            std::vector<uint32_t> indices;   //indices into vertices, used only when vertices is not empty
+        };
+
+        struct SourceMesh
+        {
+            const cmesh4::SimpleMesh *mesh = nullptr;
+            std::unique_ptr<const cmesh4::TriangleIndices> tris; //triangles of mesh, quads are split without copying vertices
+            cmesh4::SimpleMesh copy;                              //owning copy of mapped mesh data
+            std::vector<MeshPart> parts;
+            LiteMath::Box4f box;
+        };
+
+        // one part of one instance placed into an output mesh
+        struct Piece
+        {
+            const Instance *inst = nullptr;
+            const SourceMesh *src = nullptr;
+            const MeshPart *part = nullptr;
+            const std::vector<uint32_t> *remap = nullptr; //material table of instance remap list, may be null
+            uint32_t bucket = 0;
+            size_t vert_offset = 0;
+            size_t tri_offset = 0;
+        };
+
+        inline uint32_t source_material(const SourceMesh &src, size_t tri)
+        {
+            return tri < src.tris->matIndices.size() ? src.tris->matIndices[tri] : 0;
+        }
+
+        inline uint32_t remap_material(const std::vector<uint32_t> *remap, uint32_t mat_id)
+        {
+            return (remap != nullptr && mat_id < remap->size()) ? (*remap)[mat_id] : mat_id;
+        }
+
+        //same as in SimpleMesh::ApplyMatrix: w is kept, zero vectors stay zero
+        inline LiteMath::float4 transform_direction(const LiteMath::float4x4 &m, const LiteMath::float4 &v)
+        {
+            const LiteMath::float4 res = LiteMath::mul(m, LiteMath::float4(v.x, v.y, v.z, 0.0f));
+            const float len = std::sqrt(res.x * res.x + res.y * res.y + res.z * res.z);
+            const float inv = (len > 0.0f) ? 1.0f / len : 0.0f;
+            return LiteMath::float4(res.x * inv, res.y * inv, res.z * inv, v.w);
+        }
+
+        //with by_material = false all valid triangles go to one part
+        void split_parts(SourceMesh &src, bool by_material)
+        {
+            const cmesh4::SimpleMesh &mesh = *src.mesh;
+            const std::vector<unsigned int> &indices = src.tris->indices;
+            const size_t tri_num = src.tris->TrianglesNum();
+            const size_t vert_num = mesh.VerticesNum();
+
+            //triangles with out of range indices are dropped, as in BuildBVH
+            std::map<uint32_t, MeshPart> parts;
+            size_t dropped = 0;
+            for (size_t t = 0; t < tri_num; t++)
+            {
+                const unsigned int *tri = indices.data() + t * 3;
+                if (tri[0] >= vert_num || tri[1] >= vert_num || tri[2] >= vert_num)
+                {
+                    dropped++;
+                    continue;
+                }
+                const uint32_t mat_id = by_material ? source_material(src, t) : 0;
+                MeshPart &part = parts[mat_id];
+                part.mat_id = mat_id;
+                part.triangles.push_back(uint32_t(t));
+            }
+
+            if (dropped > 0)
+                printf("[HydraScene::flatten] %zu triangles with invalid vertex index are skipped\n", dropped);
+            if (parts.size() <= 1 && dropped == 0)
+            {
+                src.parts.push_back(MeshPart());
+                src.parts.back().mat_id = parts.empty() ? 0 : parts.begin()->first;
+                return;
+            }
+
+            std::vector<uint32_t> local(vert_num, INVALID_ID);
+            for (auto &[mat_id, part] : parts)
+            {
+                part.indices.reserve(part.triangles.size() * 3);
+                for (uint32_t t : part.triangles)
+                {
+                    for (int k = 0; k < 3; k++)
+                    {
+                        const uint32_t v = indices[t * 3 + k];
+                        if (local[v] == INVALID_ID)
+                        {
+                            local[v] = uint32_t(part.vertices.size());
+                            part.vertices.push_back(v);
+                        }
+                        part.indices.push_back(local[v]);
+                    }
+                }
+                for (uint32_t v : part.vertices)
+                    local[v] = INVALID_ID;
+                src.parts.push_back(std::move(part));
+            }
+        }
+
+        LiteMath::Box4f world_box(const LiteMath::Box4f &box, const LiteMath::float4x4 &m)
+        {
+            LiteMath::Box4f res;
+            for (int i = 0; i < 8; i++)
+            {
+                const LiteMath::float4 corner((i & 1) ? box.boxMax.x : box.boxMin.x,
+                                              (i & 2) ? box.boxMax.y : box.boxMin.y,
+                                              (i & 4) ? box.boxMax.z : box.boxMin.z, 1.0f);
+                res.include(LiteMath::mul(m, corner));
+            }
+            return res;
+        }
+
+        void fill_piece(const Piece &piece, cmesh4::SimpleMesh &dst)
+        {
+            const cmesh4::SimpleMesh &src = *piece.src->mesh;
+            const MeshPart &part = *piece.part;
+
+            LiteMath::float4x4 m_rot = piece.inst->matrix;
+            m_rot.set_col(3, LiteMath::float4(0, 0, 0, 1));
+            const LiteMath::float4x4 m_norm = LiteMath::transpose(LiteMath::inverse4x4(m_rot));
+
+            //mirroring transform turns triangles inside out and flips tangent space handedness
+            const LiteMath::float3 c0 = LiteMath::to_float3(m_rot.get_col(0));
+            const LiteMath::float3 c1 = LiteMath::to_float3(m_rot.get_col(1));
+            const LiteMath::float3 c2 = LiteMath::to_float3(m_rot.get_col(2));
+            const bool mirror = LiteMath::dot(LiteMath::cross(c0, c1), c2) < 0.0f;
+
+            const uint32_t src_attribs = src.Attributes();
+            const bool has_norm = (src_attribs & cmesh4::SimpleMesh::ATTR_NORMAL) && !dst.vNorm4f.empty();
+            const bool has_tang = (src_attribs & cmesh4::SimpleMesh::ATTR_TANGENT) && !dst.vTang4f.empty();
+            const bool has_uv   = (src_attribs & cmesh4::SimpleMesh::ATTR_TEXCOORD) && !dst.vTexCoord2f.empty();
+            const bool has_uv1  = (src_attribs & cmesh4::SimpleMesh::ATTR_TEXCOORD1) && !dst.vTexCoord2f_1.empty();
+            const bool has_col  = (src_attribs & cmesh4::SimpleMesh::ATTR_COLOR) && !dst.vColor4f.empty();
+
+            const size_t vert_num = part.vertices.empty() ? src.VerticesNum() : part.vertices.size();
+            for (size_t i = 0; i < vert_num; i++)
+            {
+                const size_t v = part.vertices.empty() ? i : part.vertices[i];
+                const size_t d = piece.vert_offset + i;
+                dst.vPos4f[d] = LiteMath::mul(piece.inst->matrix, src.vPos4f[v]);
+                if (has_norm)
+                    dst.vNorm4f[d] = transform_direction(m_norm, src.vNorm4f[v]);
+                if (has_tang)
+                {
+                    dst.vTang4f[d] = transform_direction(m_rot, src.vTang4f[v]);
+                    if (mirror)
+                        dst.vTang4f[d].w = -dst.vTang4f[d].w;
+                }
+                if (has_uv)
+                    dst.vTexCoord2f[d] = src.vTexCoord2f[v];
+                if (has_uv1)
+                    dst.vTexCoord2f_1[d] = src.vTexCoord2f_1[v];
+                if (has_col)
+                    dst.vColor4f[d] = src.vColor4f[v];
+            }
+
+            const std::vector<unsigned int> &src_indices = piece.src->tris->indices;
+            const size_t tri_num = part.triangles.empty() ? piece.src->tris->TrianglesNum() : part.triangles.size();
+            const uint32_t offset = uint32_t(piece.vert_offset);
+            for (size_t i = 0; i < tri_num; i++)
+            {
+                const size_t t = part.triangles.empty() ? i : part.triangles[i];
+                const unsigned int *tri = part.vertices.empty() ? src_indices.data() + t * 3 : part.indices.data() + i * 3;
+                unsigned int *out = dst.indices.data() + (piece.tri_offset + i) * 3;
+                out[0] = offset + tri[0];
+                out[1] = offset + tri[mirror ? 2 : 1];
+                out[2] = offset + tri[mirror ? 1 : 2];
+                dst.matIndices[piece.tri_offset + i] = remap_material(piece.remap, source_material(*piece.src, t));
+            }
+        }
+    }
+
+    std::vector<FlattenedMesh> HydraScene::flatten(uint32_t sceneId, const FlattenOptions &options)
+    {
+        auto scene_it = scenes.find(sceneId);
+        if (scene_it == scenes.end())
+        {
+            printf("[HydraScene::flatten] Scene %u does not exist\n", sceneId);
+            return {};
+        }
+        const InstancedScene &scene = scene_it->second;
+
+        //(1) collect meshes used by instances, load the missing ones
+        //
+        std::map<uint32_t, SourceMesh> sources;
+        std::vector<MeshGeometry *> to_load;
+        uint32_t skipped = 0;
+        for (const auto &[inst_id, inst] : scene.instances)
+        {
+            auto geom_it = geometries.find(inst.mesh_id);
+            auto *mesh = geom_it == geometries.end() ? nullptr : dynamic_cast<MeshGeometry *>(geom_it->second);
+            if (mesh == nullptr)
+            {
+                skipped++;
+                continue;
+            }
+            if (sources.emplace(inst.mesh_id, SourceMesh()).second && !mesh->is_loaded)
+                to_load.push_back(mesh);
+        }
+        if (skipped > 0)
+            printf("[HydraScene::flatten] %u instances of non-mesh geometry are skipped\n", skipped);
+
+        for (const auto &info : load_meshes_parallel(metadata, to_load, 0, 0, nullptr, {}))
+        {
+            if (!info.ok)
+            {
+                printf("[HydraScene::flatten] Failed to load mesh %u\n", info.geom_id);
+                return {};
+            }
+        }
+
+        std::vector<SourceMesh *> source_list;
+        for (auto &[geom_id, src] : sources)
+        {
+            auto *mesh = static_cast<MeshGeometry *>(geometries[geom_id]);
+            if (mesh->mesh_view.VerticesNum() > 0)
+            {
+                src.copy = mesh->mesh_view.ToSimpleMesh();
+                src.copy.Triangulate();
+                src.mesh = &src.copy;
+            }
+            else
+                src.mesh = &mesh->mesh;
+            src.tris = std::make_unique<const cmesh4::TriangleIndices>(*src.mesh);
+            source_list.push_back(&src);
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < int(source_list.size()); i++)
+        {
+            SourceMesh &src = *source_list[i];
+            src.box = src.mesh->GetAABB();
+            split_parts(src, options.grouping == FlattenOptions::Grouping::BY_MATERIAL);
+        }
+
+        //(2) material tables of remap lists, pairs of (old id, new id)
+        //
+        uint32_t max_mat_id = 0;
+        for (const auto &[id, mat] : materials)
+            max_mat_id = std::max(max_mat_id, id);
+
+        std::map<uint32_t, std::vector<uint32_t>> remap_tables;
+        for (const auto &[id, list] : scene.remap_lists)
+        {
+            uint32_t table_size = max_mat_id + 1;
+            for (size_t i = 0; i + 1 < list.remap.size(); i += 2)
+                table_size = std::max(table_size, list.remap[i] + 1);
+
+            std::vector<uint32_t> &table = remap_tables[id];
+            table.resize(table_size);
+            for (uint32_t m = 0; m < table_size; m++)
+                table[m] = m;
+            for (size_t i = 0; i + 1 < list.remap.size(); i += 2)
+                table[list.remap[i]] = list.remap[i + 1];
+        }
+
+        //(3) assign pieces to output meshes
+        //
+        std::vector<Piece> pieces;
+        for (const auto &[inst_id, inst] : scene.instances)
+        {
+            auto src_it = sources.find(inst.mesh_id);
+            if (src_it == sources.end())
+                continue;
+            auto remap_it = remap_tables.find(inst.rmap_id);
+            for (const MeshPart &part : src_it->second.parts)
+            {
+                Piece piece;
+                piece.inst = &inst;
+                piece.src = &src_it->second;
+                piece.part = &part;
+                piece.remap = remap_it == remap_tables.end() ? nullptr : &remap_it->second;
+                pieces.push_back(piece);
+            }
+        }
+
+        std::map<uint32_t, uint32_t> bucket_of_key;
+        const uint32_t n = std::max(options.cells_per_axis, 1u);
+        std::vector<LiteMath::Box4f> inst_boxes;
+        LiteMath::Box4f scene_box;
+        if (options.grouping == FlattenOptions::Grouping::BY_CELL)
+        {
+            inst_boxes.resize(pieces.size());
+            for (size_t i = 0; i < pieces.size(); i++)
+            {
+                inst_boxes[i] = world_box(pieces[i].src->box, pieces[i].inst->matrix);
+                scene_box.include(inst_boxes[i].boxMin);
+                scene_box.include(inst_boxes[i].boxMax);
+            }
+        }
+
+        for (size_t i = 0; i < pieces.size(); i++)
+        {
+            uint32_t key = 0;
+            if (options.grouping == FlattenOptions::Grouping::BY_MATERIAL)
+                key = remap_material(pieces[i].remap, pieces[i].part->mat_id);
+            else if (options.grouping == FlattenOptions::Grouping::BY_CELL)
+            {
+                const LiteMath::float4 center = (inst_boxes[i].boxMin + inst_boxes[i].boxMax) * 0.5f;
+                uint32_t cell[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    const float size = scene_box.boxMax[k] - scene_box.boxMin[k];
+                    const float rel = size > 0.0f ? (center[k] - scene_box.boxMin[k]) / size : 0.0f;
+                    cell[k] = std::min(uint32_t(std::max(rel, 0.0f) * float(n)), n - 1);
+                }
+                key = cell[0] + cell[1] * n + cell[2] * n * n;
+            }
+            pieces[i].bucket = bucket_of_key.emplace(key, uint32_t(bucket_of_key.size())).first->second;
+        }
+
+        //(4) exact sizes of output meshes, vertex channels present in any of their sources
+        //
+        std::vector<FlattenedMesh> res(bucket_of_key.size());
+        for (const auto &[key, bucket] : bucket_of_key)
+        {
+            if (options.grouping == FlattenOptions::Grouping::BY_MATERIAL)
+                res[bucket].material_id = key;
+            else if (options.grouping == FlattenOptions::Grouping::BY_CELL)
+                res[bucket].cell_id = key;
+        }
+
+        std::vector<size_t> vert_num(res.size(), 0), tri_num(res.size(), 0);
+        std::vector<uint32_t> attribs(res.size(), 0);
+        std::vector<const Instance *> last_inst(res.size(), nullptr);
+        for (Piece &piece : pieces)
+        {
+            const cmesh4::SimpleMesh &mesh = *piece.src->mesh;
+            piece.vert_offset = vert_num[piece.bucket];
+            piece.tri_offset = tri_num[piece.bucket];
+            vert_num[piece.bucket] += piece.part->vertices.empty() ? mesh.VerticesNum() : piece.part->vertices.size();
+            tri_num[piece.bucket] += piece.part->triangles.empty() ? piece.src->tris->TrianglesNum() : piece.part->triangles.size();
+            attribs[piece.bucket] |= mesh.Attributes();
+            if (last_inst[piece.bucket] != piece.inst)
+            {
+                res[piece.bucket].instances_num++;
+                last_inst[piece.bucket] = piece.inst;
+            }
+        }
+
+        for (size_t b = 0; b < res.size(); b++)
+        {
+            if (vert_num[b] > size_t(UINT32_MAX))
+            {
+                printf("[HydraScene::flatten] Too many vertices (%zu) for 32 bit indices, use BY_CELL or BY_MATERIAL grouping\n", vert_num[b]);
+                return {};
+            }
+            res[b].mesh.Resize(vert_num[b], tri_num[b] * 3, attribs[b]);
+        }
+
+        //(5) transform and copy, every piece writes its own ranges
+        //
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < int(pieces.size()); i++)
+            fill_piece(pieces[i], res[pieces[i].bucket].mesh);
+
+        return res;
+    }
+}
@@ -0,0 +1,186 @@
+#include "scene.h"
+#include "loadutil.h"
+
+#include <cstdio>
+#include <exception>
+#include <mutex>
+
+namespace LiteScene
+{
+    bool load_texture_inst(const pugi::xml_node &texNode, TextureInstance &inst);
+    std::vector<GeometryLoadInfo> load_meshes_parallel(const SceneMetadata &metadata, const std::vector<MeshGeometry *> &meshes,
+                                                       unsigned threads, size_t budget_bytes, const std::atomic<bool> *a_cancel,
+                                                       const std::function<void(const GeometryLoadInfo &)> &on_loaded);
+
+    SceneLoadTask::~SceneLoadTask()
+    {
+        cancel();
+        if (result.valid())
+            result.wait();
+    }
+
+    bool SceneLoadTask::wait_xml()
+    {
+        return xml_result.valid() && xml_result.get();
+    }
+
+    bool SceneLoadTask::wait()
+    {
+        return result.valid() && result.get();
+    }
+
+    //finds all texture references (<texture id=... />) inside node, grouped by texture id
+    static void collect_texture_refs(const pugi::xml_node &node, std::map<uint32_t, std::vector<TextureInstance>> &refs)
+    {
+        for (pugi::xml_node child = node.first_child(); child != nullptr; child = child.next_sibling())
+        {
+            if (std::wstring(child.name()) == L"texture" && !child.attribute(L"id").empty())
+            {
+                TextureInstance inst;
+                if (load_texture_inst(child, inst))
+                    refs[inst.id].push_back(inst);
+            }
+            collect_texture_refs(child, refs);
+        }
+    }
+
+    std::shared_ptr<SceneLoadTask> HydraScene::load_async(const std::string &filename, const SceneLoadOptions &options)
+    {
+        auto task = std::make_shared<SceneLoadTask>();
+        task->xml_result = task->xml_promise.get_future().share();
+
+        SceneLoadTask *pTask = task.get(); //task waits for the loading thread in destructor, so it is safe to keep raw pointer there
+        task->result = std::async(std::launch::async, [this, pTask, filename, options]()
+        {
+            std::mutex progress_mutex;
+            auto report_progress = [&]() {
+                if (options.on_progress)
+                {
+                    std::lock_guard<std::mutex> lock(progress_mutex);
+                    options.on_progress(*pTask);
+                }
+            };
+
+            //an exception must not leave xml_result without a value or the task unfinished
+            bool xml_set = false;
+            bool ok = false;
+            try
+            {
+                const bool xml_ok = load(filename);
+                std::error_code ec;
+                const size_t xml_size = fs::file_size(filename, ec);
+                if (!ec)
+                    pTask->bytes_read += xml_size;
+                pTask->xml_promise.set_value(xml_ok);
+                xml_set = true;
+
+                ok = xml_ok;
+                if (ok && options.load_geometry)
+                {
+                    std::vector<MeshGeometry *> meshes;
+                    for (const auto &[id, geom] : geometries)
+                    {
+                        auto *mesh = dynamic_cast<MeshGeometry *>(geom);
+                        if (mesh != nullptr && !mesh->is_loaded)
+                        {
+                            mesh->map_data = options.map_geometry;
+                            meshes.push_back(mesh);
+                        }
+                    }
+                    pTask->meshes_total = uint32_t(meshes.size());
+
+                    auto infos = load_meshes_parallel(metadata, meshes, options.threads, options.budget_bytes, &pTask->cancelled,
+                        [&](const GeometryLoadInfo &info) {
+                            pTask->bytes_read += info.bytes;
+                            pTask->meshes_done++;
+                            report_progress();
+                        });
+
+                    for (const auto &info : infos)
+                        ok = ok && info.ok;
+                }
+
+                if (ok && options.decode_textures && !pTask->cancelled)
+                {
+                    std::map<uint32_t, std::vector<TextureInstance>> refs;
+                    collect_texture_refs(metadata.custom_data.child(L"materials_lib"), refs);
+                    collect_texture_refs(metadata.custom_data.child(L"lights_lib"), refs);
+
+                    std::vector<std::pair<Texture *, const std::vector<TextureInstance> *>> jobs;
+                    for (const auto &[id, insts] : refs)
+                    {
+                        auto it = textures.find(id);
+                        if (it == textures.end())
+                            continue;
+                        jobs.push_back({&it->second, &insts});
+                        pTask->textures_total += uint32_t(insts.size());
+                    }
+
+                    //one texture is decoded by one thread only, as Texture caches its samplers
+                    //exceptions can't leave omp region: a failed decode is reported, the first one thrown by on_progress is rethrown after the loop
+                    std::mutex error_mutex;
+                    std::exception_ptr progress_error;
+                    #pragma omp parallel for schedule(dynamic)
+                    for (int i = 0; i < int(jobs.size()); i++)
+                    {
+                        if (pTask->cancelled)
+                            continue;
+
+                        Texture *tex = jobs[i].first;
+                        std::error_code tex_ec;
+                        const size_t tex_size = fs::file_size(tex->get_info().path, tex_ec);
+                        if (!tex_ec)
+                            pTask->bytes_read += tex_size;
+
+                        for (const auto &inst : *jobs[i].second)
+                        {
+                            bool decoded = false;
+                            try
+                            {
+                                decoded = tex->get_combined_sampler(inst) != nullptr;
+                            }
+                            catch (...)
+                            {
+                                decoded = false; //reported as any other failed decode
+                            }
+                            if (!decoded)
+                                printf("[HydraScene::load_async] Failed to decode texture %s\n", tex->get_info().path.c_str());
+                            pTask->textures_done++;
+
+                            try
+                            {
+                                report_progress();
+                            }
+                            catch (...)
+                            {
+                                std::lock_guard<std::mutex> lock(error_mutex);
+                                if (!progress_error)
+                                    progress_error = std::current_exception();
+                            }
+                        }
+                    }
+                    if (progress_error)
+                        std::rethrow_exception(progress_error);
+                }
+
+                ok = ok && !pTask->cancelled;
+            }
+            catch (const std::exception &e)
+            {
+                printf("[HydraScene::load_async::ERROR] Loading of %s failed: %s\n", filename.c_str(), e.what());
+                ok = false;
+            }
+            catch (...)
+            {
+                printf("[HydraScene::load_async::ERROR] Loading of %s failed\n", filename.c_str());
+                ok = false;
+            }
+            if (!xml_set)
+                pTask->xml_promise.set_value(false);
+            pTask->done = true;
+            return ok;
+        }).share();
+
+        return task;
+    }
+}
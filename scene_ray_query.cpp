@@ -0,0 +1,622 @@
+#include "scene_ray_query.h"
+
+#include <cstdio>
+#include <algorithm>
+
+namespace LiteScene
+{
+    std::vector<GeometryLoadInfo> load_meshes_parallel(const SceneMetadata &metadata, const std::vector<MeshGeometry *> &meshes,
+                                                       unsigned threads, size_t budget_bytes, const std::atomic<bool> *a_cancel,
+                                                       const std::function<void(const GeometryLoadInfo &)> &on_loaded);
+
+    namespace
+    {
+        //every traversal step pops one node and pushes at most two, so depth of the trees is limited at build time
+        constexpr uint32_t STACK_SIZE = 64;
+        constexpr uint32_t N = RAY_PACKET_SIZE;
+
+        struct RayData
+        {
+            LiteMath::float3 org, dir, inv_dir;
+            float t_min;
+        };
+
+        struct RayData8
+        {
+            float org[3][N], dir[3][N], inv_dir[3][N];
+            float t_min[N];
+        };
+
+        struct StackEntry
+        {
+            uint32_t node;
+            float t_near;
+        };
+
+        inline RayData make_ray(const LiteMath::float3 &org, const LiteMath::float3 &dir, float t_min)
+        {
+            RayData res;
+            res.org = org;
+            res.dir = dir;
+            res.inv_dir = LiteMath::float3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+            res.t_min = t_min;
+            return res;
+        }
+
+        inline void transform_rays(const LiteMath::float4x4 &m, const RayData8 &src, RayData8 &dst)
+        {
+            for (uint32_t i = 0; i < N; i++)
+            {
+                const LiteMath::float4 org = LiteMath::mul(m, LiteMath::float4(src.org[0][i], src.org[1][i], src.org[2][i], 1.0f));
+                const LiteMath::float4 dir = LiteMath::mul(m, LiteMath::float4(src.dir[0][i], src.dir[1][i], src.dir[2][i], 0.0f));
+                for (int k = 0; k < 3; k++)
+                {
+                    dst.org[k][i] = org[k];
+                    dst.dir[k][i] = dir[k];
+                    dst.inv_dir[k][i] = 1.0f / dir[k];
+                }
+                dst.t_min[i] = src.t_min[i];
+            }
+        }
+
+        inline bool hit_box(const cmesh4::BVHNode &node, const RayData &ray, float t_max, float &t_near)
+        {
+            float t0 = ray.t_min, t1 = t_max;
+            for (int k = 0; k < 3; k++)
+            {
+                const float a = (node.boxMin[k] - ray.org[k]) * ray.inv_dir[k];
+                const float b = (node.boxMax[k] - ray.org[k]) * ray.inv_dir[k];
+                t0 = std::max(t0, std::min(a, b));
+                t1 = std::min(t1, std::max(a, b));
+            }
+            t_near = t0;
+            return t0 <= t1;
+        }
+
+        inline uint8_t hit_box8(const cmesh4::BVHNode &node, const RayData8 &rays, const float *t_max, uint8_t mask)
+        {
+            float t0[N], t1[N];
+            for (uint32_t i = 0; i < N; i++)
+            {
+                t0[i] = rays.t_min[i];
+                t1[i] = t_max[i];
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                for (uint32_t i = 0; i < N; i++)
+                {
+                    const float a = (node.boxMin[k] - rays.org[k][i]) * rays.inv_dir[k][i];
+                    const float b = (node.boxMax[k] - rays.org[k][i]) * rays.inv_dir[k][i];
+                    t0[i] = std::max(t0[i], std::min(a, b));
+                    t1[i] = std::min(t1[i], std::max(a, b));
+                }
+            }
+            uint8_t res = 0;
+            for (uint32_t i = 0; i < N; i++)
+                res |= uint8_t(t0[i] <= t1[i]) << i;
+            return res & mask;
+        }
+
+        //Moller-Trumbore, both sides of the triangle are hit
+        inline bool hit_triangle(const LiteMath::float4 *tri, const RayData &ray, float t_max, float &t, float &u, float &v)
+        {
+            const LiteMath::float3 v0 = LiteMath::to_float3(tri[0]), e1 = LiteMath::to_float3(tri[1]), e2 = LiteMath::to_float3(tri[2]);
+            const LiteMath::float3 p = LiteMath::cross(ray.dir, e2);
+            const float det = LiteMath::dot(e1, p);
+            if (det == 0.0f)
+                return false;
+            const float inv_det = 1.0f / det;
+            const LiteMath::float3 s = ray.org - v0;
+            const LiteMath::float3 q = LiteMath::cross(s, e1);
+            u = LiteMath::dot(s, p) * inv_det;
+            v = LiteMath::dot(ray.dir, q) * inv_det;
+            t = LiteMath::dot(e2, q) * inv_det;
+            return u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= ray.t_min && t < t_max;
+        }
+
+        //same for all lanes at once, closer hits replace data in hits, returns mask of such lanes
+        inline uint8_t hit_triangle8(const LiteMath::float4 *tri, uint32_t prim_id, const RayData8 &rays, uint8_t mask, RayHit8 &hits)
+        {
+            const float v0[3] = {tri[0].x, tri[0].y, tri[0].z};
+            const float e1[3] = {tri[1].x, tri[1].y, tri[1].z};
+            const float e2[3] = {tri[2].x, tri[2].y, tri[2].z};
+
+            uint8_t res = 0;
+            for (uint32_t i = 0; i < N; i++)
+            {
+                const float d[3] = {rays.dir[0][i], rays.dir[1][i], rays.dir[2][i]};
+                const float s[3] = {rays.org[0][i] - v0[0], rays.org[1][i] - v0[1], rays.org[2][i] - v0[2]};
+                const float p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+                const float q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+                const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+                const float inv_det = 1.0f / det;
+                const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+                const float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+                const float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+                const bool ok = ((mask >> i) & 1) && det != 0.0f && u >= 0.0f && v >= 0.0f && u + v <= 1.0f &&
+                                t >= rays.t_min[i] && t < hits.t[i];
+                hits.t[i] = ok ? t : hits.t[i];
+                hits.u[i] = ok ? u : hits.u[i];
+                hits.v[i] = ok ? v : hits.v[i];
+                hits.prim_id[i] = ok ? prim_id : hits.prim_id[i];
+                res |= uint8_t(ok) << i;
+            }
+            return res;
+        }
+
+        inline void push_children(const std::vector<cmesh4::BVHNode> &nodes, const cmesh4::BVHNode &node, const RayData &ray, float t_max,
+                                  StackEntry *stack, uint32_t &top)
+        {
+            const uint32_t left = node.leftOrFirst, right = left + 1;
+            float t_left, t_right;
+            const bool hit_left = hit_box(nodes[left], ray, t_max, t_left);
+            const bool hit_right = hit_box(nodes[right], ray, t_max, t_right);
+            if (hit_left && hit_right)
+            {
+                const bool left_first = t_left <= t_right;
+                stack[top++] = left_first ? StackEntry{right, t_right} : StackEntry{left, t_left};
+                stack[top++] = left_first ? StackEntry{left, t_left} : StackEntry{right, t_right};
+            }
+            else if (hit_left)
+                stack[top++] = {left, t_left};
+            else if (hit_right)
+                stack[top++] = {right, t_right};
+        }
+
+        //children of a packet node are ordered along the direction of the first active ray
+        inline void push_children8(const std::vector<cmesh4::BVHNode> &nodes, const cmesh4::BVHNode &node, const RayData8 &rays, uint8_t mask,
+                                   uint32_t *stack, uint32_t &top)
+        {
+            uint32_t lane = 0;
+            while (((mask >> lane) & 1) == 0)
+                lane++;
+            const cmesh4::BVHNode &left = nodes[node.leftOrFirst];
+            const cmesh4::BVHNode &right = nodes[node.leftOrFirst + 1];
+            float dist = 0.0f;
+            for (int k = 0; k < 3; k++)
+                dist += (left.boxMin[k] + left.boxMax[k] - right.boxMin[k] - right.boxMax[k]) * rays.dir[k][lane];
+            const bool left_first = dist <= 0.0f;
+            stack[top++] = left_first ? node.leftOrFirst + 1 : node.leftOrFirst;
+            stack[top++] = left_first ? node.leftOrFirst : node.leftOrFirst + 1;
+        }
+
+        template<bool ANY_HIT>
+        bool trace_blas(const cmesh4::BVHTree &bvh, const std::vector<LiteMath::float4> &tris, const RayData &ray, RayHit &hit)
+        {
+            StackEntry stack[STACK_SIZE];
+            uint32_t top = 0;
+            float t_root;
+            if (hit_box(bvh.nodes[0], ray, hit.t, t_root))
+                stack[top++] = {0, t_root};
+
+            bool found = false;
+            while (top > 0)
+            {
+                const StackEntry entry = stack[--top];
+                if (entry.t_near > hit.t)
+                    continue;
+                const cmesh4::BVHNode &node = bvh.nodes[entry.node];
+                if (!node.IsLeaf())
+                {
+                    push_children(bvh.nodes, node, ray, hit.t, stack, top);
+                    continue;
+                }
+                for (uint32_t j = node.leftOrFirst; j < node.leftOrFirst + node.primCount; j++)
+                {
+                    float t, u, v;
+                    if (!hit_triangle(tris.data() + size_t(j) * 3, ray, hit.t, t, u, v))
+                        continue;
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    hit.prim_id = bvh.primIndices[j];
+                    found = true;
+                    if (ANY_HIT)
+                        return true;
+                }
+            }
+            return found;
+        }
+
+        //returns mask of lanes with a closer hit (ANY_HIT: with any hit, traversal stops when all lanes have one)
+        template<bool ANY_HIT>
+        uint8_t trace_blas8(const cmesh4::BVHTree &bvh, const std::vector<LiteMath::float4> &tris, const RayData8 &rays, uint8_t mask, RayHit8 &hits)
+        {
+            uint32_t stack[STACK_SIZE];
+            uint32_t top = 0;
+            stack[top++] = 0;
+
+            uint8_t found = 0;
+            while (top > 0 && mask != 0)
+            {
+                const cmesh4::BVHNode &node = bvh.nodes[stack[--top]];
+                uint8_t node_mask = hit_box8(node, rays, hits.t, mask);
+                if (node_mask == 0)
+                    continue;
+                if (!node.IsLeaf())
+                {
+                    push_children8(bvh.nodes, node, rays, node_mask, stack, top);
+                    continue;
+                }
+                for (uint32_t j = node.leftOrFirst; j < node.leftOrFirst + node.primCount && node_mask != 0; j++)
+                {
+                    const uint8_t hit_mask = hit_triangle8(tris.data() + size_t(j) * 3, bvh.primIndices[j], rays, node_mask, hits);
+                    found |= hit_mask;
+                    if (ANY_HIT)
+                    {
+                        mask &= ~hit_mask;
+                        node_mask &= ~hit_mask;
+                    }
+                }
+            }
+            return found;
+        }
+
+        LiteMath::Box4f world_box(const cmesh4::BVHNode &root, const LiteMath::float4x4 &m)
+        {
+            LiteMath::Box4f res;
+            for (int i = 0; i < 8; i++)
+            {
+                const LiteMath::float4 corner((i & 1) ? root.boxMax[0] : root.boxMin[0],
+                                              (i & 2) ? root.boxMax[1] : root.boxMin[1],
+                                              (i & 4) ? root.boxMax[2] : root.boxMin[2], 1.0f);
+                res.include(LiteMath::mul(m, corner));
+            }
+            return res;
+        }
+
+        //children are always stored after their parent
+        uint32_t tree_depth(const cmesh4::BVHTree &bvh)
+        {
+            std::vector<uint32_t> depth(bvh.nodes.size(), 1);
+            uint32_t res = 0;
+            for (size_t i = 0; i < bvh.nodes.size(); i++)
+            {
+                res = std::max(res, depth[i]);
+                if (!bvh.nodes[i].IsLeaf())
+                    depth[bvh.nodes[i].leftOrFirst] = depth[bvh.nodes[i].leftOrFirst + 1] = depth[i] + 1;
+            }
+            return res;
+        }
+
+        //triangles with out of range indices are left out; quads are triangulated, so prim_id of a hit is a triangle id after triangulation
+        void build_blas(const MeshGeometry &geom, const cmesh4::BVHBuildOptions &options, cmesh4::BVHTree &bvh, std::vector<LiteMath::float4> &tris)
+        {
+            //quads are split into own index array, vertices are always read from the mesh or the mapped file
+            const bool mapped = geom.mesh_view.VerticesNum() > 0;
+            std::vector<unsigned int> quad_tris, quad_mats;
+            const unsigned int *indices = nullptr;
+            size_t tri_num = 0;
+            if (mapped && (geom.mesh_view.flags & cmesh4::Header::QUADS))
+            {
+                cmesh4::TriangulatedIndices(geom.mesh_view, quad_tris, quad_mats);
+                indices = quad_tris.data();
+                tri_num = quad_tris.size() / 3;
+            }
+            else if (mapped)
+            {
+                indices = geom.mesh_view.indices.data();
+                tri_num = geom.mesh_view.TrianglesNum();
+            }
+            else if (geom.mesh.topology != cmesh4::SimpleMesh::SIMPLE_MESH_TRIANGLES)
+            {
+                cmesh4::TriangulatedIndices(geom.mesh, quad_tris, quad_mats);
+                indices = quad_tris.data();
+                tri_num = quad_tris.size() / 3;
+            }
+            else
+            {
+                indices = geom.mesh.indices.data();
+                tri_num = geom.mesh.TrianglesNum();
+            }
+
+            const LiteMath::float4 *pos = mapped ? (const LiteMath::float4 *)geom.mesh_view.vPos4f.data() : geom.mesh.vPos4f.data();
+            const size_t vert_num = mapped ? geom.mesh_view.VerticesNum() : geom.mesh.VerticesNum();
+
+            std::vector<uint32_t> valid;
+            valid.reserve(tri_num);
+            for (size_t t = 0; t < tri_num; t++)
+                if (indices[t * 3 + 0] < vert_num && indices[t * 3 + 1] < vert_num && indices[t * 3 + 2] < vert_num)
+                    valid.push_back(uint32_t(t));
+
+            std::vector<LiteMath::Box4f> boxes(valid.size());
+            #pragma omp parallel for
+            for (int64_t i = 0; i < int64_t(valid.size()); i++)
+            {
+                const unsigned int *tri = indices + size_t(valid[i]) * 3;
+                for (int k = 0; k < 3; k++)
+                    boxes[i].include(pos[tri[k]]);
+            }
+
+            bvh = cmesh4::BuildBVH(boxes.data(), boxes.size(), options);
+            tris.resize(bvh.primIndices.size() * 3);
+
+            #pragma omp parallel for
+            for (int64_t j = 0; j < int64_t(bvh.primIndices.size()); j++)
+            {
+                const uint32_t t = valid[bvh.primIndices[j]];
+                const unsigned int *tri = indices + size_t(t) * 3;
+                const LiteMath::float4 v0 = pos[tri[0]];
+                tris[j * 3 + 0] = v0;
+                tris[j * 3 + 1] = pos[tri[1]] - v0;
+                tris[j * 3 + 2] = pos[tri[2]] - v0;
+                bvh.primIndices[j] = t;
+            }
+        }
+    }
+
+    void RayPacket8::set(uint32_t lane, const Ray &ray)
+    {
+        org_x[lane] = ray.origin.x;
+        org_y[lane] = ray.origin.y;
+        org_z[lane] = ray.origin.z;
+        dir_x[lane] = ray.direction.x;
+        dir_y[lane] = ray.direction.y;
+        dir_z[lane] = ray.direction.z;
+        t_min[lane] = ray.t_min;
+        t_max[lane] = ray.t_max;
+        active |= uint8_t(1u << lane);
+    }
+
+    RayHit RayHit8::get(uint32_t lane) const
+    {
+        RayHit res;
+        res.t = t[lane];
+        res.u = u[lane];
+        res.v = v[lane];
+        res.inst_id = inst_id[lane];
+        res.geom_id = geom_id[lane];
+        res.prim_id = prim_id[lane];
+        return res;
+    }
+
+    void SceneRayQuery::clear()
+    {
+        blases.clear();
+        instances.clear();
+        tlas = cmesh4::BVHTree();
+    }
+
+    bool SceneRayQuery::build(HydraScene &scene, uint32_t sceneId, const cmesh4::BVHBuildOptions &options)
+    {
+        clear();
+        auto scene_it = scene.scenes.find(sceneId);
+        if (scene_it == scene.scenes.end())
+        {
+            printf("[SceneRayQuery::build] Scene %u does not exist\n", sceneId);
+            return false;
+        }
+        const InstancedScene &inst_scene = scene_it->second;
+
+        //(1) meshes used by instances, load the missing ones
+        //
+        std::map<uint32_t, uint32_t> blas_of_geom;
+        std::vector<MeshGeometry *> meshes, to_load;
+        uint32_t skipped = 0;
+        for (const auto &[inst_id, inst] : inst_scene.instances)
+        {
+            auto geom_it = scene.geometries.find(inst.mesh_id);
+            auto *mesh = geom_it == scene.geometries.end() ? nullptr : dynamic_cast<MeshGeometry *>(geom_it->second);
+            if (mesh == nullptr)
+            {
+                skipped++;
+                continue;
+            }
+            if (blas_of_geom.emplace(inst.mesh_id, uint32_t(meshes.size())).second)
+            {
+                meshes.push_back(mesh);
+                if (!mesh->is_loaded)
+                    to_load.push_back(mesh);
+            }
+        }
+        if (skipped > 0)
+            printf("[SceneRayQuery::build] %u instances of non-mesh geometry are skipped\n", skipped);
+
+        for (const auto &info : load_meshes_parallel(scene.metadata, to_load, 0, 0, nullptr, {}))
+        {
+            if (!info.ok)
+            {
+                printf("[SceneRayQuery::build] Failed to load mesh %u\n", info.geom_id);
+                return false;
+            }
+        }
+
+        //(2) BLAS, one mesh at a time since the builder itself is parallel
+        //
+        blases.resize(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+            build_blas(*meshes[i], options, blases[i].bvh, blases[i].tris);
+
+        //(3) TLAS over world space boxes of instances, an instance is much more expensive than a box test so leaves hold one of them
+        //
+        std::vector<InstanceData> inst_list;
+        std::vector<LiteMath::Box4f> boxes;
+        for (const auto &[inst_id, inst] : inst_scene.instances)
+        {
+            auto blas_it = blas_of_geom.find(inst.mesh_id);
+            if (blas_it == blas_of_geom.end() || blases[blas_it->second].bvh.nodes.empty())
+                continue;
+            InstanceData data;
+            data.world_to_object = LiteMath::inverse4x4(inst.matrix);
+            data.inst_id = inst_id;
+            data.geom_id = inst.mesh_id;
+            data.blas_id = blas_it->second;
+            inst_list.push_back(data);
+            boxes.push_back(world_box(blases[data.blas_id].bvh.nodes[0], inst.matrix));
+        }
+
+        cmesh4::BVHBuildOptions top_options = options;
+        top_options.maxLeafSize = 1;
+        tlas = cmesh4::BuildBVH(boxes.data(), boxes.size(), top_options);
+        instances.resize(tlas.primIndices.size());
+        for (size_t i = 0; i < tlas.primIndices.size(); i++)
+            instances[i] = inst_list[tlas.primIndices[i]];
+
+        uint32_t max_depth = tree_depth(tlas);
+        for (const BLAS &blas : blases)
+            max_depth = std::max(max_depth, tree_depth(blas.bvh));
+        if (max_depth + 1 >= STACK_SIZE)
+        {
+            printf("[SceneRayQuery::build] BVH depth %u exceeds traversal stack size %u\n", max_depth, STACK_SIZE);
+            clear();
+            return false;
+        }
+        return true;
+    }
+
+    template<bool ANY_HIT>
+    bool SceneRayQuery::trace(const Ray &ray, RayHit &hit) const
+    {
+        hit = RayHit();
+        hit.t = ray.t_max;
+        if (tlas.nodes.empty())
+            return false;
+
+        const RayData world = make_ray(ray.origin, ray.direction, ray.t_min);
+        StackEntry stack[STACK_SIZE];
+        uint32_t top = 0;
+        float t_root;
+        if (hit_box(tlas.nodes[0], world, hit.t, t_root))
+            stack[top++] = {0, t_root};
+
+        while (top > 0)
+        {
+            const StackEntry entry = stack[--top];
+            if (entry.t_near > hit.t)
+                continue;
+            const cmesh4::BVHNode &node = tlas.nodes[entry.node];
+            if (!node.IsLeaf())
+            {
+                push_children(tlas.nodes, node, world, hit.t, stack, top);
+                continue;
+            }
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.primCount; i++)
+            {
+                //direction is not normalized after transform, so t is the same in both spaces
+                const InstanceData &inst = instances[i];
+                const LiteMath::float4 org = LiteMath::mul(inst.world_to_object, LiteMath::to_float4(ray.origin, 1.0f));
+                const LiteMath::float4 dir = LiteMath::mul(inst.world_to_object, LiteMath::to_float4(ray.direction, 0.0f));
+                const BLAS &blas = blases[inst.blas_id];
+                if (!trace_blas<ANY_HIT>(blas.bvh, blas.tris, make_ray(LiteMath::to_float3(org), LiteMath::to_float3(dir), ray.t_min), hit))
+                    continue;
+                hit.inst_id = inst.inst_id;
+                hit.geom_id = inst.geom_id;
+                if (ANY_HIT)
+                    return true;
+            }
+        }
+        return hit.hit();
+    }
+
+    template<bool ANY_HIT>
+    uint8_t SceneRayQuery::trace8(const RayPacket8 &rays, RayHit8 &hits) const
+    {
+        //inactive lanes may be left uninitialized, so they get a ray that misses everything instead
+        RayData8 world;
+        for (uint32_t i = 0; i < N; i++)
+        {
+            hits.u[i] = hits.v[i] = 0.0f;
+            hits.inst_id[i] = hits.geom_id[i] = hits.prim_id[i] = INVALID_ID;
+            if (((rays.active >> i) & 1) == 0)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    world.org[k][i] = 0.0f;
+                    world.dir[k][i] = world.inv_dir[k][i] = 1.0f;
+                }
+                world.t_min[i] = 1.0f;
+                hits.t[i] = 0.0f;
+                continue;
+            }
+            world.org[0][i] = rays.org_x[i];
+            world.org[1][i] = rays.org_y[i];
+            world.org[2][i] = rays.org_z[i];
+            world.dir[0][i] = rays.dir_x[i];
+            world.dir[1][i] = rays.dir_y[i];
+            world.dir[2][i] = rays.dir_z[i];
+            for (int k = 0; k < 3; k++)
+                world.inv_dir[k][i] = 1.0f / world.dir[k][i];
+            world.t_min[i] = rays.t_min[i];
+            hits.t[i] = rays.t_max[i];
+        }
+
+        uint8_t mask = rays.active;
+        uint8_t found = 0;
+        if (tlas.nodes.empty())
+            return found;
+
+        RayData8 local;
+        uint32_t stack[STACK_SIZE];
+        uint32_t top = 0;
+        stack[top++] = 0;
+        while (top > 0 && mask != 0)
+        {
+            const cmesh4::BVHNode &node = tlas.nodes[stack[--top]];
+            uint8_t node_mask = hit_box8(node, world, hits.t, mask);
+            if (node_mask == 0)
+                continue;
+            if (!node.IsLeaf())
+            {
+                push_children8(tlas.nodes, node, world, node_mask, stack, top);
+                continue;
+            }
+            for (uint32_t j = node.leftOrFirst; j < node.leftOrFirst + node.primCount && node_mask != 0; j++)
+            {
+                const InstanceData &inst = instances[j];
+                const BLAS &blas = blases[inst.blas_id];
+                transform_rays(inst.world_to_object, world, local);
+                const uint8_t hit_mask = trace_blas8<ANY_HIT>(blas.bvh, blas.tris, local, node_mask, hits);
+                for (uint32_t i = 0; i < N; i++)
+                {
+                    const bool hit = (hit_mask >> i) & 1;
+                    hits.inst_id[i] = hit ? inst.inst_id : hits.inst_id[i];
+                    hits.geom_id[i] = hit ? inst.geom_id : hits.geom_id[i];
+                }
+                found |= hit_mask;
+                if (ANY_HIT)
+                {
+                    mask &= ~hit_mask;
+                    node_mask &= ~hit_mask;
+                }
+            }
+        }
+        return found;
+    }
+
+    RayHit SceneRayQuery::intersect(const Ray &ray) const
+    {
+        RayHit hit;
+        trace<false>(ray, hit);
+        return hit;
+    }
+
+    bool SceneRayQuery::occluded(const Ray &ray) const
+    {
+        RayHit hit;
+        return trace<true>(ray, hit);
+    }
+
+    void SceneRayQuery::intersect8(const RayPacket8 &rays, RayHit8 &hits) const
+    {
+        RayHit8 res;
+        trace8<false>(rays, res);
+        for (uint32_t i = 0; i < N; i++)
+        {
+            if ((rays.active >> i) & 1)
+            {
+                hits.t[i] = res.t[i];
+                hits.u[i] = res.u[i];
+                hits.v[i] = res.v[i];
+                hits.inst_id[i] = res.inst_id[i];
+                hits.geom_id[i] = res.geom_id[i];
+                hits.prim_id[i] = res.prim_id[i];
+            }
+        }
+    }
+
+    uint8_t SceneRayQuery::occluded8(const RayPacket8 &rays) const
+    {
+        RayHit8 hits;
+        return trace8<true>(rays, hits) & rays.active;
+    }
+}
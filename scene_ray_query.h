@@ -0,0 +1,95 @@
+#ifndef LITESCENE_SCENE_RAY_QUERY_H_
+#define LITESCENE_SCENE_RAY_QUERY_H_
+#include "scene.h"
+#include "mesh_bvh.h"
+#include <cfloat>
+
+namespace LiteScene
+{
+    struct Ray
+    {
+        LiteMath::float3 origin;
+        LiteMath::float3 direction; //does not have to be normalized, t is measured in its lengths
+        float t_min = 0.0f;
+        float t_max = FLT_MAX;
+    };
+
+    struct RayHit
+    {
+        float t = FLT_MAX;
+        float u = 0.0f, v = 0.0f;      //barycentric coordinates of the 2nd and 3rd vertices of the triangle
+        uint32_t inst_id = INVALID_ID; //key in InstancedScene::instances, INVALID_ID if nothing was hit
+        uint32_t geom_id = INVALID_ID; //Instance::mesh_id
+        uint32_t prim_id = INVALID_ID; //triangle index in the mesh
+
+        bool hit() const { return inst_id != INVALID_ID; }
+    };
+
+    constexpr uint32_t RAY_PACKET_SIZE = 8;
+
+    // rays in SoA form, lanes with zero bit in active mask are ignored and never read; set() activates its lane
+    struct RayPacket8
+    {
+        float org_x[RAY_PACKET_SIZE], org_y[RAY_PACKET_SIZE], org_z[RAY_PACKET_SIZE];
+        float dir_x[RAY_PACKET_SIZE], dir_y[RAY_PACKET_SIZE], dir_z[RAY_PACKET_SIZE];
+        float t_min[RAY_PACKET_SIZE];
+        float t_max[RAY_PACKET_SIZE];
+        uint8_t active = 0;
+
+        void set(uint32_t lane, const Ray &ray);
+    };
+
+    struct RayHit8
+    {
+        float t[RAY_PACKET_SIZE];
+        float u[RAY_PACKET_SIZE], v[RAY_PACKET_SIZE];
+        uint32_t inst_id[RAY_PACKET_SIZE];
+        uint32_t geom_id[RAY_PACKET_SIZE];
+        uint32_t prim_id[RAY_PACKET_SIZE];
+
+        RayHit get(uint32_t lane) const;
+    };
+
+    // CPU ray queries over instances of one InstancedScene: BVH for every used mesh (BLAS) and one over instance boxes (TLAS).
+    // Triangles are copied at build time, so the scene can be changed or unloaded afterwards, but the changes are not visible
+    // until the next build. All query functions are const and can be called from any number of threads at once.
+    class SceneRayQuery
+    {
+    public:
+        //meshes that are not loaded yet are loaded, mapped meshes are read through their views; returns false on error
+        bool build(HydraScene &scene, uint32_t sceneId, const cmesh4::BVHBuildOptions &options = {});
+        void clear();
+
+        RayHit intersect(const Ray &ray) const;  //closest hit
+        bool occluded(const Ray &ray) const;     //any hit, cheaper than intersect
+
+        void intersect8(const RayPacket8 &rays, RayHit8 &hits) const; //hits of inactive lanes are not written
+        uint8_t occluded8(const RayPacket8 &rays) const;               //mask of occluded lanes
+
+        size_t instances_num() const { return instances.size(); }
+
+    private:
+        struct BLAS
+        {
+            cmesh4::BVHTree bvh;
+            std::vector<LiteMath::float4> tris; //(v0, v1 - v0, v2 - v0) per element of bvh.primIndices, in the same order
+        };
+
+        struct InstanceData
+        {
+            LiteMath::float4x4 world_to_object;
+            uint32_t inst_id = INVALID_ID;
+            uint32_t geom_id = INVALID_ID;
+            uint32_t blas_id = 0;
+        };
+
+        template<bool ANY_HIT> bool trace(const Ray &ray, RayHit &hit) const;
+        template<bool ANY_HIT> uint8_t trace8(const RayPacket8 &rays, RayHit8 &hits) const;
+
+        std::vector<BLAS> blases;
+        std::vector<InstanceData> instances; //in the order of tlas.primIndices
+        cmesh4::BVHTree tlas;
+    };
+}
+
+#endif
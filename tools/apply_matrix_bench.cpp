@@ -0,0 +1,102 @@
+// Benchmark of SimpleMesh::ApplyMatrix throughput against a plain streaming pass over the same arrays.
+//
+//   apply_matrix_bench [millionVertices = 16] [repeats = 5]
+//
+// A mesh with positions, normals and tangents is transformed by a sheared, non-uniformly scaled matrix, so every
+// channel is read and written once: 96 bytes per vertex. The same bytes are then streamed by 'scale', which multiplies
+// every float4 by a constant and does no other work; its speed is what memory allows. The best of 'repeats' runs is
+// printed in GB/s for 1, 2, 4, ... threads up to omp_get_max_threads(). If ApplyMatrix runs close to 'scale', it is
+// memory-bound and faster arithmetic (wider SIMD) would not speed it up.
+//
+#include "cmesh4.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+  cmesh4::SimpleMesh MakeMesh(size_t a_vertNum)
+  {
+    cmesh4::SimpleMesh mesh(a_vertNum, 0, cmesh4::SimpleMesh::ATTR_NORMAL | cmesh4::SimpleMesh::ATTR_TANGENT);
+    for(size_t i = 0; i < a_vertNum; i++) // deterministic, no randomness
+    {
+      const float t = float(i % 65536)*(1.0f/65536.0f);
+      mesh.vPos4f[i]  = LiteMath::float4(t, 1.0f - t, 0.5f*t, 1.0f);
+      mesh.vNorm4f[i] = LiteMath::float4(0.0f, t, 1.0f - t, 0.0f);
+      mesh.vTang4f[i] = LiteMath::float4(1.0f - t, 0.0f, t, (i % 2 == 0) ? 1.0f : -1.0f);
+    }
+    return mesh;
+  }
+
+  void ScaleStream(std::vector<LiteMath::float4>& a_arr, float a_scale)
+  {
+    LiteMath::float4* data = a_arr.data();
+    #pragma omp parallel for
+    for(int64_t i = 0; i < int64_t(a_arr.size()); i++)
+      data[i] = data[i]*a_scale;
+  }
+
+  template<typename Func>
+  double BestTimeMs(int a_repeats, Func a_func)
+  {
+    double best = 1e30;
+    for(int r = 0; r < a_repeats; r++)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      a_func();
+      const auto end = std::chrono::steady_clock::now();
+      best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+  }
+};
+
+int main(int argc, const char** argv)
+{
+  const size_t vertNum = size_t((argc > 1) ? std::max(std::atoi(argv[1]), 1) : 16)*1000000;
+  const int    repeats = (argc > 2) ? std::max(std::atoi(argv[2]), 1) : 5;
+
+  cmesh4::SimpleMesh mesh = MakeMesh(vertNum);
+
+  LiteMath::float4x4 m; // shear, non-uniform scale and translation, so normals need the full cofactor transform
+  m.set_col(0, LiteMath::float4(1.5f, 0.0f, 0.0f, 0.0f));
+  m.set_col(1, LiteMath::float4(0.3f, 0.7f, 0.0f, 0.0f));
+  m.set_col(2, LiteMath::float4(0.0f, 0.2f, 2.0f, 0.0f));
+  m.set_col(3, LiteMath::float4(10.0f, -5.0f, 3.0f, 1.0f));
+
+  const double bytes = double(vertNum)*3*sizeof(LiteMath::float4)*2; // 3 channels read and written
+  printf("vertices %zu, %.0f MB moved per pass, best of %d runs\n", vertNum, bytes*1e-6, repeats);
+
+  int maxThreads = 1;
+#ifdef _OPENMP
+  maxThreads = omp_get_max_threads();
+#endif
+
+  for(int threads = 1; ; threads = std::min(threads*2, maxThreads))
+  {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+    const double applyMs = BestTimeMs(repeats, [&]() { mesh.ApplyMatrix(m); });
+    const double scaleMs = BestTimeMs(repeats, [&]() {
+      ScaleStream(mesh.vPos4f, 1.0f);
+      ScaleStream(mesh.vNorm4f, 1.0f);
+      ScaleStream(mesh.vTang4f, 1.0f);
+    });
+
+    const double applyGBs = bytes/(applyMs*1e6);
+    const double scaleGBs = bytes/(scaleMs*1e6);
+    printf("%2d thr: ApplyMatrix %7.2f GB/s, scale %7.2f GB/s, %3.0f%% of streaming speed\n", threads, applyGBs, scaleGBs, 100.0*applyGBs/scaleGBs);
+    if(threads == maxThreads)
+      break;
+  }
+
+  return 0;
+}
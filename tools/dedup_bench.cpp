@@ -0,0 +1,207 @@
+// Benchmark of cmesh4::DedupIndexTriples against std::unordered_map that LoadMeshFromObj used before.
+//
+//   dedup_bench [gridSize = 1024 | file.obj] [repeats = 5]
+//
+// Without a file, corners are generated like an OBJ of a gridSize x gridSize quad grid with per-vertex normals and a
+// texture seam every 16 quads, so about 6 corners map to one unique vertex. Input is the same for every run (no
+// randomness). With an .obj file, LoadMeshFromObj is timed end to end first, then the corners of its faces (fan
+// triangulated, (v, vt, vn) as the loader keys them) are deduplicated the same way. The best of 'repeats' runs is
+// printed for the map and for DedupIndexTriples with 1, 2, 4, ... threads up to omp_get_max_threads(); for a file the
+// load time with the map is estimated as the measured load time with the dedup time replaced by the map time.
+// Every result is compared with the map, which also numbers keys in order of first occurrence.
+//
+#include "mesh_dedup.h"
+#include "mesh_load_obj.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+  struct IndexTripleHasher // as in the previous OBJ loader
+  {
+    size_t operator()(const cmesh4::IndexTriple& c) const
+    {
+      return ((std::hash<int>()(int(c.i0)) ^ (std::hash<int>()(int(c.i2)) << 1)) >> 1) ^ (std::hash<int>()(int(c.i1)) << 1);
+    }
+  };
+
+  std::vector<cmesh4::IndexTriple> MakeGridCorners(uint32_t a_size)
+  {
+    const uint32_t SEAM_STEP = 16;
+    const uint32_t uvRow     = a_size + 1 + a_size/SEAM_STEP; // texture coordinates are split at every seam column
+    auto corner = [&](uint32_t x, uint32_t y, uint32_t quadX) {
+      const uint32_t v  = y*(a_size + 1) + x;
+      const uint32_t vt = y*uvRow + x + quadX/SEAM_STEP;
+      return cmesh4::IndexTriple{v, vt, v};
+    };
+
+    std::vector<cmesh4::IndexTriple> res;
+    res.reserve(size_t(a_size)*a_size*6);
+    for(uint32_t y = 0; y < a_size; y++)
+    {
+      for(uint32_t x = 0; x < a_size; x++)
+      {
+        const cmesh4::IndexTriple c00 = corner(x, y, x),     c10 = corner(x + 1, y, x);
+        const cmesh4::IndexTriple c01 = corner(x, y + 1, x), c11 = corner(x + 1, y + 1, x);
+        res.insert(res.end(), {c00, c10, c11, c00, c11, c01});
+      }
+    }
+    return res;
+  }
+
+  // only what the loader keys vertices by: counts of v/vt/vn for relative and out of range indices, and face corners
+  //
+  bool ReadObjCorners(const char* a_fileName, std::vector<cmesh4::IndexTriple>& a_res)
+  {
+    std::ifstream input(a_fileName);
+    if(!input.is_open())
+      return false;
+
+    int64_t counts[3] = {0, 0, 0}; // v, vt, vn
+    std::vector<int64_t> face[3];
+    std::string line;
+    while(std::getline(input, line))
+    {
+      const char* p = line.c_str();
+      while(*p == ' ' || *p == '\t')
+        p++;
+      if(p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+        counts[0]++;
+      else if(p[0] == 'v' && p[1] == 't')
+        counts[1]++;
+      else if(p[0] == 'v' && p[1] == 'n')
+        counts[2]++;
+      if(p[0] != 'f' || (p[1] != ' ' && p[1] != '\t'))
+        continue;
+
+      for(auto& f : face)
+        f.clear();
+      std::istringstream tokens(p + 1);
+      std::string token;
+      while(tokens >> token)
+      {
+        const char* t = token.c_str();
+        for(int k = 0; k < 3; k++)
+        {
+          char* next = nullptr;
+          const int64_t raw = (*t != '/' && *t != 0) ? std::strtoll(t, &next, 10) : 0;
+          const int64_t idx = (raw > 0) ? raw - 1 : (raw < 0 ? counts[k] + raw : -1);
+          face[k].push_back((idx >= 0 && idx < counts[k]) ? idx : -1);
+          t = (next != nullptr) ? next : t;
+          if(*t != '/')
+            break;
+          t++;
+        }
+        for(int k = 0; k < 3; k++)
+          face[k].resize(face[0].size(), -1);
+      }
+
+      auto corner = [&](size_t i) {
+        auto id = [&](int k) { return face[k][i] >= 0 ? uint32_t(face[k][i]) : cmesh4::DEDUP_NO_INDEX; };
+        return cmesh4::IndexTriple{id(0), id(1), id(2)};
+      };
+      for(size_t i = 2; i < face[0].size(); i++)
+        a_res.insert(a_res.end(), {corner(0), corner(i - 1), corner(i)});
+    }
+    return true;
+  }
+
+  uint32_t DedupWithMap(const std::vector<cmesh4::IndexTriple>& a_keys, std::vector<uint32_t>& a_ids)
+  {
+    std::unordered_map<cmesh4::IndexTriple, uint32_t, IndexTripleHasher> ids;
+    a_ids.resize(a_keys.size());
+    for(size_t i = 0; i < a_keys.size(); i++)
+      a_ids[i] = ids.emplace(a_keys[i], uint32_t(ids.size())).first->second;
+    return uint32_t(ids.size());
+  }
+
+  template<typename Func>
+  double BestTimeMs(int a_repeats, Func a_func)
+  {
+    double best = 1e30;
+    for(int r = 0; r < a_repeats; r++)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      a_func();
+      const auto end = std::chrono::steady_clock::now();
+      best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+  }
+};
+
+int main(int argc, const char** argv)
+{
+  const char*    objFile  = (argc > 1 && std::strstr(argv[1], ".obj") != nullptr) ? argv[1] : nullptr;
+  const uint32_t gridSize = (argc > 1 && objFile == nullptr) ? uint32_t(std::atoi(argv[1])) : 1024;
+  const int      repeats  = (argc > 2) ? std::max(std::atoi(argv[2]), 1) : 5;
+
+  std::vector<cmesh4::IndexTriple> keys;
+  double loadMs = 0.0;
+  if(objFile != nullptr)
+  {
+    size_t vertNum = 0, indNum = 0;
+    loadMs = BestTimeMs(repeats, [&]() {
+      const cmesh4::SimpleMesh mesh = cmesh4::LoadMeshFromObj(objFile);
+      vertNum = mesh.VerticesNum();
+      indNum  = mesh.IndicesNum();
+    });
+    if(!ReadObjCorners(objFile, keys) || vertNum == 0)
+    {
+      printf("can't load %s\n", objFile);
+      return 1;
+    }
+    printf("%s: %zu vertices, %zu indices\n", objFile, vertNum, indNum);
+    printf("%-28s %10.2f ms\n", "LoadMeshFromObj", loadMs);
+  }
+  else
+    keys = MakeGridCorners(gridSize);
+
+  std::vector<uint32_t> refIds;
+  uint32_t refUnique = 0;
+  const double mapMs = BestTimeMs(repeats, [&]() { refUnique = DedupWithMap(keys, refIds); });
+  printf("keys %zu, unique %u, best of %d runs\n", keys.size(), refUnique, repeats);
+  printf("%-28s %10.2f ms\n", "std::unordered_map", mapMs);
+
+  int maxThreads = 1;
+#ifdef _OPENMP
+  maxThreads = omp_get_max_threads();
+#endif
+
+  bool allSame = true;
+  for(int threads = 1; ; threads = std::min(threads*2, maxThreads))
+  {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+    std::vector<uint32_t> ids, firsts;
+    uint32_t unique = 0;
+    const double ms = BestTimeMs(repeats, [&]() { unique = cmesh4::DedupIndexTriples(keys.data(), keys.size(), ids, firsts); });
+    const bool same = (unique == refUnique && ids == refIds);
+    allSame = allSame && same;
+
+    char name[64];
+    snprintf(name, sizeof(name), "DedupIndexTriples, %d thr", threads);
+    printf("%-28s %10.2f ms  x%.2f%s\n", name, ms, mapMs/ms, same ? "" : "  RESULT DIFFERS");
+    if(objFile != nullptr && threads == maxThreads) // the loader runs with all threads
+      printf("%-28s %10.2f ms  (estimated, loader is x%.2f faster)\n", "LoadMeshFromObj with map", loadMs - ms + mapMs, (loadMs - ms + mapMs)/loadMs);
+    if(threads == maxThreads)
+      break;
+  }
+
+  return allSame ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+#include "cmesh4.h"
+#include "mesh_quant.h"
+#include "mesh_tangents.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#ifndef DISABLE_VSGF_DEFLATE
+#include "3rd_party/tinyexr/miniz.h"
+#endif
+
+// VSGF v2 file layout:
+//
+//   Header     (24 bytes, same as v1, flags has CONTAINER_V2 bit)
+//   HeaderV2   (40 bytes)
+//   StreamDesc (32 bytes) x HeaderV2::streamsNum
+//   payloads of all streams, in the same order as their descriptions
+//
+// Every stream is encoded (see STREAM_ENCODING) and then optionally deflated; checksum is CRC-32 of the payload as it is stored in the file.
+//
+namespace cmesh4
+{
+  namespace
+  {
+    struct HeaderV2
+    {
+      uint32_t version;
+      uint32_t streamsNum;
+      float    boxMin[4]; // used for dequantization of positions
+      float    boxMax[4];
+    };
+
+    struct StreamDesc
+    {
+      uint32_t type;
+      uint32_t encoding;
+      uint64_t rawSize;    // size of encoded data before deflate
+      uint64_t packedSize; // size in file
+      uint32_t checksum;
+      uint32_t reserved;
+    };
+
+    enum STREAM_TYPE
+    {
+      STREAM_POS         = 0,
+      STREAM_NORM        = 1,
+      STREAM_TANG        = 2,
+      STREAM_TEXCOORD    = 3,
+      STREAM_INDICES     = 4,
+      STREAM_MAT_INDICES = 5,
+      STREAM_TEXCOORD1   = 6,
+      STREAM_COLOR       = 7,
+    };
+
+    enum STREAM_ENCODING
+    {
+      ENC_RAW          = 0,     // as is in SimpleMesh
+      ENC_QUANT16      = 1,     // 3 x unorm16 relative to HeaderV2 box, w = 1
+      ENC_OCT16        = 2,     // 2 x snorm16 octahedral direction, w = 0
+      ENC_OCT16_W      = 3,     // 2 x snorm16 octahedral direction + snorm16 w
+      ENC_DELTA_VARINT = 4,     // zigzag delta from previous value, LEB128
+      ENC_DEFLATE      = 0x100, // flag, payload is additionally compressed with deflate
+    };
+
+    static_assert(sizeof(Header)     == 24, "VSGF header layout changed");
+    static_assert(sizeof(HeaderV2)   == 40, "VSGF v2 header layout changed");
+    static_assert(sizeof(StreamDesc) == 32, "VSGF v2 stream description layout changed");
+
+    constexpr uint32_t VSGF_V2_VERSION = 2;
+
+    uint32_t Crc32(const uint8_t* a_data, size_t a_size)
+    {
+      static const auto table = []() {
+        std::vector<uint32_t> res(256);
+        for(uint32_t i = 0; i < 256; i++)
+        {
+          uint32_t c = i;
+          for(int k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+          res[i] = c;
+        }
+        return res;
+      }();
+
+      uint32_t crc = 0xFFFFFFFFu;
+      for(size_t i = 0; i < a_size; i++)
+        crc = table[(crc ^ a_data[i]) & 0xFF] ^ (crc >> 8);
+      return crc ^ 0xFFFFFFFFu;
+    }
+
+    template<typename T>
+    void Append(std::vector<uint8_t>& a_out, const T& a_val)
+    {
+      const size_t oldSize = a_out.size();
+      a_out.resize(oldSize + sizeof(T));
+      memcpy(a_out.data() + oldSize, &a_val, sizeof(T));
+    }
+
+    std::vector<uint8_t> EncodeRaw(const void* a_data, size_t a_size)
+    {
+      std::vector<uint8_t> res(a_size);
+      if(a_size != 0)
+        memcpy(res.data(), a_data, a_size);
+      return res;
+    }
+
+    std::vector<uint8_t> EncodePositionsQuant16(const std::vector<float4>& a_pos, const LiteMath::Box4f& a_box)
+    {
+      float invScale[3];
+      for(int i = 0; i < 3; i++)
+      {
+        const float extent = a_box.boxMax[i] - a_box.boxMin[i];
+        invScale[i] = (extent > 0.0f) ? 1.0f/extent : 0.0f;
+      }
+
+      std::vector<uint8_t> res(a_pos.size()*sizeof(uint16_t)*3);
+      uint16_t* out = (uint16_t*)res.data();
+      for(size_t i = 0; i < a_pos.size(); i++)
+        for(int j = 0; j < 3; j++)
+          out[i*3 + j] = QuantizeUnorm16(a_pos[i][j], a_box.boxMin[j], invScale[j]);
+      return res;
+    }
+
+    std::vector<uint8_t> EncodeDirectionsOct16(const std::vector<float4>& a_dirs, bool a_withW)
+    {
+      const size_t stride = a_withW ? 3 : 2;
+      std::vector<uint8_t> res(a_dirs.size()*sizeof(int16_t)*stride);
+      int16_t* out = (int16_t*)res.data();
+      for(size_t i = 0; i < a_dirs.size(); i++)
+      {
+        EncodeOct16(a_dirs[i].x, a_dirs[i].y, a_dirs[i].z, out + i*stride);
+        if(a_withW)
+          out[i*stride + 2] = PackSnorm16(a_dirs[i].w);
+      }
+      return res;
+    }
+
+    std::vector<uint8_t> EncodeDeltaVarint(const std::vector<unsigned int>& a_vals)
+    {
+      std::vector<uint8_t> res;
+      res.reserve(a_vals.size()*2);
+      int64_t prev = 0;
+      for(unsigned int val : a_vals)
+      {
+        const int64_t  delta  = int64_t(val) - prev;
+        uint64_t       zigzag = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+        prev = int64_t(val);
+        do
+        {
+          uint8_t byte = uint8_t(zigzag & 0x7F);
+          zigzag >>= 7;
+          if(zigzag != 0)
+            byte |= 0x80;
+          res.push_back(byte);
+        } while(zigzag != 0);
+      }
+      return res;
+    }
+
+    bool DecodeDeltaVarint(const uint8_t* a_data, size_t a_size, std::vector<unsigned int>& a_vals)
+    {
+      size_t  pos  = 0;
+      int64_t prev = 0;
+      for(size_t i = 0; i < a_vals.size(); i++)
+      {
+        uint64_t zigzag = 0;
+        int      shift  = 0;
+        uint8_t  byte   = 0;
+        do
+        {
+          if(pos >= a_size || shift > 63)
+            return false;
+          byte    = a_data[pos++];
+          zigzag |= uint64_t(byte & 0x7F) << shift;
+          shift  += 7;
+        } while(byte & 0x80);
+
+        const int64_t delta = int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+        prev = prev + delta;
+        a_vals[i] = (unsigned int)prev;
+      }
+      return pos == a_size;
+    }
+
+    struct EncodedStream
+    {
+      StreamDesc           desc;
+      std::vector<uint8_t> payload;
+    };
+
+    EncodedStream MakeStream(uint32_t a_type, uint32_t a_encoding, std::vector<uint8_t>&& a_data, const VSGFSaveOptions& a_options)
+    {
+      EncodedStream res;
+      res.desc.type     = a_type;
+      res.desc.encoding = a_encoding;
+      res.desc.rawSize  = a_data.size();
+      res.desc.reserved = 0;
+      res.payload       = std::move(a_data);
+
+#ifndef DISABLE_VSGF_DEFLATE
+      if(a_options.useDeflate && !res.payload.empty() && res.payload.size() <= size_t(std::numeric_limits<uint32_t>::max()))
+      {
+        mz_ulong packedSize = mz_compressBound(mz_ulong(res.payload.size()));
+        std::vector<uint8_t> packed(packedSize);
+        int status = mz_compress2(packed.data(), &packedSize, res.payload.data(), mz_ulong(res.payload.size()), a_options.deflateLevel);
+        if(status == MZ_OK && packedSize < res.payload.size()) // keep raw stream if deflate does not help
+        {
+          packed.resize(packedSize);
+          res.payload        = std::move(packed);
+          res.desc.encoding |= ENC_DEFLATE;
+        }
+      }
+#endif
+
+      res.desc.packedSize = res.payload.size();
+      res.desc.checksum   = Crc32(res.payload.data(), res.payload.size());
+      return res;
+    }
+
+    // returns pointer to decoded (inflated) data of the stream; a_storage is used if inflate is needed
+    //
+    const uint8_t* UnpackStream(const StreamDesc& a_desc, const uint8_t* a_payload, std::vector<uint8_t>& a_storage, const char* a_fileName)
+    {
+      if(Crc32(a_payload, size_t(a_desc.packedSize)) != a_desc.checksum)
+      {
+        printf("[LoadMeshFromVSGF::ERROR] Checksum mismatch for stream %u in %s\n", a_desc.type, a_fileName);
+        return nullptr;
+      }
+
+      if(!(a_desc.encoding & ENC_DEFLATE))
+        return (a_desc.rawSize == a_desc.packedSize) ? a_payload : nullptr;
+
+#ifndef DISABLE_VSGF_DEFLATE
+      if(a_desc.rawSize > uint64_t(std::numeric_limits<uint32_t>::max()))
+        return nullptr;
+      a_storage.resize(size_t(a_desc.rawSize));
+      mz_ulong rawSize = mz_ulong(a_desc.rawSize);
+      int status = mz_uncompress(a_storage.data(), &rawSize, a_payload, mz_ulong(a_desc.packedSize));
+      if(status != MZ_OK || rawSize != a_desc.rawSize)
+      {
+        printf("[LoadMeshFromVSGF::ERROR] Failed to inflate stream %u in %s\n", a_desc.type, a_fileName);
+        return nullptr;
+      }
+      return a_storage.data();
+#else
+      printf("[LoadMeshFromVSGF::ERROR] %s has deflated streams, but LiteScene is built with DISABLE_VSGF_DEFLATE\n", a_fileName);
+      return nullptr;
+#endif
+    }
+
+    bool DecodeDirections(const uint8_t* a_data, uint64_t a_size, uint32_t a_encoding, std::vector<float4>& a_dirs)
+    {
+      const uint32_t enc = a_encoding & ~uint32_t(ENC_DEFLATE);
+      if(enc == ENC_RAW)
+      {
+        if(a_size != a_dirs.size()*sizeof(float4))
+          return false;
+        memcpy((void*)a_dirs.data(), a_data, size_t(a_size));
+        return true;
+      }
+
+      if(enc != ENC_OCT16 && enc != ENC_OCT16_W)
+        return false;
+
+      const size_t stride = (enc == ENC_OCT16_W) ? 3 : 2;
+      if(a_size != a_dirs.size()*sizeof(int16_t)*stride)
+        return false;
+
+      const int16_t* in = (const int16_t*)a_data;
+      for(size_t i = 0; i < a_dirs.size(); i++)
+      {
+        const LiteMath::float3 dir = DecodeOct16(in + i*stride);
+        const float w = (stride == 3) ? UnpackSnorm16(in[i*stride + 2]) : 0.0f;
+        a_dirs[i] = float4(dir.x, dir.y, dir.z, w);
+      }
+      return true;
+    }
+  }
+
+  SimpleMesh DecodeVSGFv2(const Header& a_header, const uint8_t* a_data, size_t a_size, const char* a_fileName)
+  {
+    HeaderV2 header2;
+    if(a_size < sizeof(HeaderV2))
+    {
+      printf("[LoadMeshFromVSGF::ERROR] File %s is truncated\n", a_fileName);
+      return SimpleMesh();
+    }
+    memcpy(&header2, a_data, sizeof(HeaderV2));
+
+    if(header2.version != VSGF_V2_VERSION ||
+       size_t(header2.streamsNum)*sizeof(StreamDesc) > a_size - sizeof(HeaderV2))
+    {
+      printf("[LoadMeshFromVSGF::ERROR] Unsupported VSGF container version %u in %s\n", header2.version, a_fileName);
+      return SimpleMesh();
+    }
+
+    std::vector<StreamDesc> streams(header2.streamsNum);
+    if(!streams.empty())
+      memcpy(streams.data(), a_data + sizeof(HeaderV2), streams.size()*sizeof(StreamDesc));
+
+    SimpleMesh res(a_header.verticesNum, a_header.indicesNum, AttributesFromVSGFFlags(a_header.flags), TopologyFromVSGFFlags(a_header.flags));
+
+    size_t offset = sizeof(HeaderV2) + streams.size()*sizeof(StreamDesc);
+    std::vector<uint8_t> storage;
+    uint32_t seen = 0; // bit per STREAM_TYPE
+
+    for(const auto& desc : streams)
+    {
+      if(desc.packedSize > uint64_t(a_size - offset))
+      {
+        printf("[LoadMeshFromVSGF::ERROR] File %s is truncated\n", a_fileName);
+        return SimpleMesh();
+      }
+
+      const uint8_t* payload = a_data + offset;
+      offset += size_t(desc.packedSize);
+
+      const uint8_t* data = UnpackStream(desc, payload, storage, a_fileName);
+      if(data == nullptr)
+        return SimpleMesh();
+
+      const uint32_t enc = desc.encoding & ~uint32_t(ENC_DEFLATE);
+      bool ok = false;
+      switch(desc.type)
+      {
+      case STREAM_POS:
+        if(enc == ENC_RAW && desc.rawSize == res.vPos4f.size()*sizeof(float4))
+        {
+          memcpy((void*)res.vPos4f.data(), data, size_t(desc.rawSize));
+          ok = true;
+        }
+        else if(enc == ENC_QUANT16 && desc.rawSize == res.vPos4f.size()*sizeof(uint16_t)*3)
+        {
+          const uint16_t* in = (const uint16_t*)data;
+          for(size_t i = 0; i < res.vPos4f.size(); i++)
+          {
+            float4 p(0,0,0,1);
+            for(int j = 0; j < 3; j++)
+              p[j] = DequantizeUnorm16(in[i*3 + j], header2.boxMin[j], header2.boxMax[j] - header2.boxMin[j]);
+            res.vPos4f[i] = p;
+          }
+          ok = true;
+        }
+        break;
+      case STREAM_NORM:
+        ok = DecodeDirections(data, desc.rawSize, desc.encoding, res.vNorm4f);
+        break;
+      case STREAM_TANG:
+        ok = DecodeDirections(data, desc.rawSize, desc.encoding, res.vTang4f);
+        break;
+      case STREAM_TEXCOORD:
+        ok = (enc == ENC_RAW && desc.rawSize == res.vTexCoord2f.size()*sizeof(float2));
+        if(ok)
+          memcpy((void*)res.vTexCoord2f.data(), data, size_t(desc.rawSize));
+        break;
+      case STREAM_TEXCOORD1:
+        ok = (enc == ENC_RAW && desc.rawSize == res.vTexCoord2f_1.size()*sizeof(float2));
+        if(ok)
+          memcpy((void*)res.vTexCoord2f_1.data(), data, size_t(desc.rawSize));
+        break;
+      case STREAM_COLOR:
+        ok = (enc == ENC_RAW && desc.rawSize == res.vColor4f.size()*sizeof(float4));
+        if(ok)
+          memcpy((void*)res.vColor4f.data(), data, size_t(desc.rawSize));
+        break;
+      case STREAM_INDICES:
+        ok = (enc == ENC_DELTA_VARINT) && DecodeDeltaVarint(data, size_t(desc.rawSize), res.indices);
+        break;
+      case STREAM_MAT_INDICES:
+        ok = (enc == ENC_DELTA_VARINT) && DecodeDeltaVarint(data, size_t(desc.rawSize), res.matIndices);
+        break;
+      default:
+        ok = true; // unknown streams are skipped to allow adding new ones
+        break;
+      };
+
+      if(!ok)
+      {
+        printf("[LoadMeshFromVSGF::ERROR] Bad stream %u (encoding %u) in %s\n", desc.type, desc.encoding, a_fileName);
+        return SimpleMesh();
+      }
+      if(desc.type < 32)
+        seen |= (1u << desc.type);
+    }
+
+    // positions, indices and every channel the header declares must be present, otherwise they would silently stay zero
+    //
+    const uint32_t attribs = AttributesFromVSGFFlags(a_header.flags);
+    uint32_t required = (1u << STREAM_POS) | (1u << STREAM_INDICES);
+    if(attribs & SimpleMesh::ATTR_NORMAL)    required |= (1u << STREAM_NORM);
+    if(attribs & SimpleMesh::ATTR_TANGENT)   required |= (1u << STREAM_TANG);
+    if(attribs & SimpleMesh::ATTR_TEXCOORD)  required |= (1u << STREAM_TEXCOORD);
+    if(attribs & SimpleMesh::ATTR_TEXCOORD1) required |= (1u << STREAM_TEXCOORD1);
+    if(attribs & SimpleMesh::ATTR_COLOR)     required |= (1u << STREAM_COLOR);
+    if((seen & required) != required)
+    {
+      printf("[LoadMeshFromVSGF::ERROR] Missing streams (mask 0x%x) in %s\n", required & ~seen, a_fileName);
+      return SimpleMesh();
+    }
+
+    if(a_header.flags & Header::HAS_NO_NORMALS)
+      ComputeNormals(res, NORMALS_ANGLE_WEIGHTED);
+
+    return res;
+  }
+};
+
+bool cmesh4::SaveMeshToVSGF(const char* a_fileName, const SimpleMesh& a_mesh, const VSGFSaveOptions& a_options)
+{
+  LiteMath::Box4f box;
+  for(const auto& p : a_mesh.vPos4f)
+    box.include(p);
+  if(a_mesh.vPos4f.empty())
+    box = LiteMath::Box4f(float4(0,0,0,0), float4(0,0,0,0));
+
+  const uint32_t attribs = a_mesh.Attributes();
+
+  std::vector<EncodedStream> streams;
+  streams.reserve(8);
+
+  if(a_options.quantizePositions)
+    streams.push_back(MakeStream(STREAM_POS, ENC_QUANT16, EncodePositionsQuant16(a_mesh.vPos4f, box), a_options));
+  else
+    streams.push_back(MakeStream(STREAM_POS, ENC_RAW, EncodeRaw(a_mesh.vPos4f.data(), a_mesh.vPos4f.size()*sizeof(float4)), a_options));
+
+  if(attribs & SimpleMesh::ATTR_NORMAL)
+  {
+    if(a_options.octNormals)
+      streams.push_back(MakeStream(STREAM_NORM, ENC_OCT16, EncodeDirectionsOct16(a_mesh.vNorm4f, false), a_options));
+    else
+      streams.push_back(MakeStream(STREAM_NORM, ENC_RAW, EncodeRaw(a_mesh.vNorm4f.data(), a_mesh.vNorm4f.size()*sizeof(float4)), a_options));
+  }
+
+  if(attribs & SimpleMesh::ATTR_TANGENT)
+  {
+    if(a_options.octNormals)
+      streams.push_back(MakeStream(STREAM_TANG, ENC_OCT16_W, EncodeDirectionsOct16(a_mesh.vTang4f, true), a_options));
+    else
+      streams.push_back(MakeStream(STREAM_TANG, ENC_RAW, EncodeRaw(a_mesh.vTang4f.data(), a_mesh.vTang4f.size()*sizeof(float4)), a_options));
+  }
+
+  if(attribs & SimpleMesh::ATTR_TEXCOORD)
+    streams.push_back(MakeStream(STREAM_TEXCOORD,  ENC_RAW, EncodeRaw(a_mesh.vTexCoord2f.data(),   a_mesh.vTexCoord2f.size()*sizeof(float2)),   a_options));
+  if(attribs & SimpleMesh::ATTR_TEXCOORD1)
+    streams.push_back(MakeStream(STREAM_TEXCOORD1, ENC_RAW, EncodeRaw(a_mesh.vTexCoord2f_1.data(), a_mesh.vTexCoord2f_1.size()*sizeof(float2)), a_options));
+  if(attribs & SimpleMesh::ATTR_COLOR)
+    streams.push_back(MakeStream(STREAM_COLOR,     ENC_RAW, EncodeRaw(a_mesh.vColor4f.data(),      a_mesh.vColor4f.size()*sizeof(float4)),      a_options));
+
+  streams.push_back(MakeStream(STREAM_INDICES,     ENC_DELTA_VARINT, EncodeDeltaVarint(a_mesh.indices),    a_options));
+  streams.push_back(MakeStream(STREAM_MAT_INDICES, ENC_DELTA_VARINT, EncodeDeltaVarint(a_mesh.matIndices), a_options));
+
+  HeaderV2 header2;
+  header2.version    = VSGF_V2_VERSION;
+  header2.streamsNum = uint32_t(streams.size());
+  for(int i = 0; i < 4; i++)
+  {
+    header2.boxMin[i] = box.boxMin[i];
+    header2.boxMax[i] = box.boxMax[i];
+  }
+
+  std::vector<uint8_t> tableData;
+  Append(tableData, header2);
+  for(const auto& stream : streams)
+    Append(tableData, stream.desc);
+
+  Header header;
+  header.fileSizeInBytes = sizeof(header) + tableData.size();
+  header.verticesNum     = static_cast<uint32_t>(a_mesh.VerticesNum());
+  header.indicesNum      = static_cast<uint32_t>(a_mesh.IndicesNum());
+  header.materialsNum    = static_cast<uint32_t>(a_mesh.matIndices.size());
+  header.flags           = Header::CONTAINER_V2 | VSGFFlagsFromAttributes(attribs) | VSGFFlagsFromTopology(a_mesh.topology);
+
+  for(const auto& stream : streams)
+    header.fileSizeInBytes += stream.payload.size();
+
+  std::ofstream output(a_fileName, std::ios::binary);
+  if(!output.is_open())
+  {
+    printf("[SaveMeshToVSGF::ERROR] Can't open file %s for writing\n", a_fileName);
+    return false;
+  }
+
+  output.write((char*)&header, sizeof(Header));
+  output.write((char*)tableData.data(), tableData.size());
+  for(const auto& stream : streams)
+    output.write((char*)stream.payload.data(), stream.payload.size());
+  output.close();
+
+  return bool(output);
+}
+
+bool cmesh4::LoadVSGFSaveOptions(const char* a_fileName, VSGFSaveOptions* a_pOptions)
+{
+  std::ifstream input(a_fileName, std::ios::binary);
+  if(!input.is_open())
+    return false;
+
+  Header   header;
+  HeaderV2 header2;
+  input.read((char*)&header, sizeof(Header));
+  input.read((char*)&header2, sizeof(HeaderV2));
+  if(!input || !(header.flags & Header::CONTAINER_V2) || header2.version != VSGF_V2_VERSION || header2.streamsNum > 64)
+    return false;
+
+  std::vector<StreamDesc> streams(header2.streamsNum);
+  input.read((char*)streams.data(), streams.size()*sizeof(StreamDesc));
+  if(!input)
+    return false;
+
+  // directions follow normals if there are any, else tangents, else precision of positions
+  //
+  VSGFSaveOptions res;
+  res.useDeflate = false;
+  int posEnc = -1, normEnc = -1, tangEnc = -1;
+  for(const auto& desc : streams)
+  {
+    const int enc = int(desc.encoding & ~uint32_t(ENC_DEFLATE));
+    res.useDeflate = res.useDeflate || (desc.encoding & ENC_DEFLATE) != 0;
+    if(desc.type == STREAM_POS)  posEnc  = enc;
+    if(desc.type == STREAM_NORM) normEnc = enc;
+    if(desc.type == STREAM_TANG) tangEnc = enc;
+  }
+  res.quantizePositions = (posEnc == ENC_QUANT16);
+  if(normEnc >= 0)
+    res.octNormals = (normEnc != ENC_RAW);
+  else if(tangEnc >= 0)
+    res.octNormals = (tangEnc != ENC_RAW);
+  else
+    res.octNormals = res.quantizePositions;
+
+  if(a_pOptions != nullptr)
+    *a_pOptions = res;
+  return true;
+}